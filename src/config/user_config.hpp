@@ -527,6 +527,10 @@ namespace UserConfigParams
     /** True if fps should be printed each frame. */
     PARAM_PREFIX bool m_fps_debug PARAM_DEFAULT(false);
 
+    /** True if the physics of the next frame should be computed in a
+     *  separate thread while the current frame is rendered. */
+    PARAM_PREFIX bool m_pipelined_physics PARAM_DEFAULT(false);
+
     /** True if slipstream debugging is activated. */
     PARAM_PREFIX bool m_slipstream_debug  PARAM_DEFAULT( false );
 
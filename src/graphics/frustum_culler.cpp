@@ -0,0 +1,408 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "graphics/frustum_culler.hpp"
+
+#include "graphics/static_scene_bvh.hpp"
+#include "utils/log.hpp"
+
+#include "SViewFrustum.h"
+#include "matrix4.h"
+
+#include <assert.h>
+#include <chrono>
+#include <random>
+
+#if defined(__AVX__)
+#  include <immintrin.h>
+#  define FRUSTUM_CULLER_AVX
+#elif defined(__SSE__) || defined(_M_X64) || \
+      (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#  include <xmmintrin.h>
+#  define FRUSTUM_CULLER_SSE
+#endif
+
+namespace
+{
+    const unsigned int NUM_PLANES = scene::SViewFrustum::VF_PLANE_COUNT;
+}   // namespace
+
+// ----------------------------------------------------------------------------
+FrustumCuller::FrustumCuller()
+{
+    m_num_views = 0;
+}   // FrustumCuller
+
+// ----------------------------------------------------------------------------
+/** Sets the views to cull against. Bit i of the result mask of cull()
+ *  corresponds to frustums[i].
+ *  \param frustums The view frustums.
+ *  \param num_views Number of views (at most MAX_VIEWS).
+ */
+void FrustumCuller::setViews(const scene::SViewFrustum * const *frustums,
+                             unsigned int num_views)
+{
+    assert(num_views <= MAX_VIEWS);
+    m_num_views = num_views;
+    m_planes.resize(num_views * NUM_PLANES);
+    for (unsigned int v = 0; v < num_views; v++)
+    {
+        for (unsigned int p = 0; p < NUM_PLANES; p++)
+            m_planes[v * NUM_PLANES + p] = frustums[v]->planes[p];
+    }
+}   // setViews
+
+// ----------------------------------------------------------------------------
+/** Sets the number of boxes. The boxes must then be set with setBox(). */
+void FrustumCuller::resize(unsigned int num_boxes)
+{
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        m_min[i].resize(num_boxes);
+        m_max[i].resize(num_boxes);
+    }
+}   // resize
+
+// ----------------------------------------------------------------------------
+/** Culls a range of boxes against all views.
+ *  \param begin Index of the first box.
+ *  \param end Index after the last box.
+ *  \param culled Receives for each box in [begin, end) (at index i-begin)
+ *         a mask in which bit v is set if the box is culled for view v.
+ */
+void FrustumCuller::cull(unsigned int begin, unsigned int end,
+                         unsigned int *culled) const
+{
+    assert(end <= getNumBoxes());
+    for (unsigned int i = begin; i < end; i++)
+        culled[i - begin] = 0;
+    cullSIMD(begin, end, culled);
+}   // cull
+
+// ----------------------------------------------------------------------------
+/** Culls the boxes one at a time. The planes of a view frustum point
+ *  outwards, so a box is outside of the frustum if it is completely in
+ *  front of one plane. For each plane only the corner of the box which is
+ *  furthest behind the plane (i.e. which has the smallest distance in
+ *  direction of the plane normal) is tested: the box is completely in
+ *  front of the plane if this corner is in front of it.
+ */
+void FrustumCuller::cullScalar(unsigned int begin, unsigned int end,
+                               unsigned int *culled) const
+{
+    for (unsigned int i = begin; i < end; i++)
+    {
+        unsigned int mask = 0;
+        for (unsigned int v = 0; v < m_num_views; v++)
+        {
+            for (unsigned int p = 0; p < NUM_PLANES; p++)
+            {
+                const core::plane3df &plane = m_planes[v * NUM_PLANES + p];
+                // Same order of operations as in the SIMD kernels, so that
+                // the results are identical
+                const float d =
+                    (plane.Normal.X * (plane.Normal.X > 0 ? m_min[0][i] : m_max[0][i]) +
+                     plane.Normal.Y * (plane.Normal.Y > 0 ? m_min[1][i] : m_max[1][i])) +
+                    (plane.Normal.Z * (plane.Normal.Z > 0 ? m_min[2][i] : m_max[2][i]) +
+                     plane.D);
+                // Same test as plane3df::classifyPointRelation (ISREL3D_FRONT)
+                if (d > core::ROUNDING_ERROR_f32)
+                {
+                    mask |= 1 << v;
+                    break;
+                }
+            }
+        }
+        culled[i - begin] |= mask;
+    }
+}   // cullScalar
+
+// ----------------------------------------------------------------------------
+/** Culls the boxes using the SIMD kernel selected at compile time, which
+ *  tests 4 (SSE) or 8 (AVX) boxes at once. The remaining boxes are culled
+ *  with the scalar version.
+ */
+void FrustumCuller::cullSIMD(unsigned int begin, unsigned int end,
+                             unsigned int *culled) const
+{
+    unsigned int i = begin;
+#if defined(FRUSTUM_CULLER_AVX)
+    const __m256 eps = _mm256_set1_ps(core::ROUNDING_ERROR_f32);
+    for (; i + 8 <= end; i += 8)
+    {
+        const __m256 min_x = _mm256_loadu_ps(&m_min[0][i]);
+        const __m256 min_y = _mm256_loadu_ps(&m_min[1][i]);
+        const __m256 min_z = _mm256_loadu_ps(&m_min[2][i]);
+        const __m256 max_x = _mm256_loadu_ps(&m_max[0][i]);
+        const __m256 max_y = _mm256_loadu_ps(&m_max[1][i]);
+        const __m256 max_z = _mm256_loadu_ps(&m_max[2][i]);
+        for (unsigned int v = 0; v < m_num_views; v++)
+        {
+            __m256 outside = _mm256_setzero_ps();
+            for (unsigned int p = 0; p < NUM_PLANES; p++)
+            {
+                const core::plane3df &plane = m_planes[v * NUM_PLANES + p];
+                const __m256 x = plane.Normal.X > 0 ? min_x : max_x;
+                const __m256 y = plane.Normal.Y > 0 ? min_y : max_y;
+                const __m256 z = plane.Normal.Z > 0 ? min_z : max_z;
+                const __m256 d = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.Normal.X)),
+                                  _mm256_mul_ps(y, _mm256_set1_ps(plane.Normal.Y))),
+                    _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(plane.Normal.Z)),
+                                  _mm256_set1_ps(plane.D)));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, eps, _CMP_GT_OQ));
+            }
+            const int bits = _mm256_movemask_ps(outside);
+            for (unsigned int k = 0; k < 8; k++)
+                if (bits & (1 << k))
+                    culled[i + k - begin] |= 1 << v;
+        }
+    }
+#elif defined(FRUSTUM_CULLER_SSE)
+    const __m128 eps = _mm_set1_ps(core::ROUNDING_ERROR_f32);
+    for (; i + 4 <= end; i += 4)
+    {
+        const __m128 min_x = _mm_loadu_ps(&m_min[0][i]);
+        const __m128 min_y = _mm_loadu_ps(&m_min[1][i]);
+        const __m128 min_z = _mm_loadu_ps(&m_min[2][i]);
+        const __m128 max_x = _mm_loadu_ps(&m_max[0][i]);
+        const __m128 max_y = _mm_loadu_ps(&m_max[1][i]);
+        const __m128 max_z = _mm_loadu_ps(&m_max[2][i]);
+        for (unsigned int v = 0; v < m_num_views; v++)
+        {
+            __m128 outside = _mm_setzero_ps();
+            for (unsigned int p = 0; p < NUM_PLANES; p++)
+            {
+                const core::plane3df &plane = m_planes[v * NUM_PLANES + p];
+                const __m128 x = plane.Normal.X > 0 ? min_x : max_x;
+                const __m128 y = plane.Normal.Y > 0 ? min_y : max_y;
+                const __m128 z = plane.Normal.Z > 0 ? min_z : max_z;
+                const __m128 d = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.Normal.X)),
+                               _mm_mul_ps(y, _mm_set1_ps(plane.Normal.Y))),
+                    _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.Normal.Z)),
+                               _mm_set1_ps(plane.D)));
+                outside = _mm_or_ps(outside, _mm_cmpgt_ps(d, eps));
+            }
+            const int bits = _mm_movemask_ps(outside);
+            for (unsigned int k = 0; k < 4; k++)
+                if (bits & (1 << k))
+                    culled[i + k - begin] |= 1 << v;
+        }
+    }
+#endif
+    cullScalar(i, end, culled + (i - begin));
+}   // cullSIMD
+
+// ----------------------------------------------------------------------------
+/** Returns the name of the SIMD kernel used. */
+const char *FrustumCuller::getKernelName()
+{
+#if defined(FRUSTUM_CULLER_AVX)
+    return "AVX";
+#elif defined(FRUSTUM_CULLER_SSE)
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}   // getKernelName
+
+// ----------------------------------------------------------------------------
+/** Compares the previous culling (testing the 8 transformed corners of
+ *  each node for each plane) with the scalar and SIMD versions of the box
+ *  culling and with the StaticSceneBVH, using synthetic scenes with 10000
+ *  to 100000 randomly placed and rotated nodes and 6 views. It also checks
+ *  that the SIMD, scalar and hierarchy versions give the same results, and
+ *  that neither the box culling nor the hierarchy ever culls a node that
+ *  is visible according to the corner test. The results are printed to the log. This does not use
+ *  any graphics.
+ *  \return The exit code: 0 if all checks passed.
+ */
+int FrustumCuller::runBenchmark()
+{
+    typedef std::chrono::steady_clock Clock;
+    const unsigned int NUM_VIEWS  = 6;
+    const unsigned int ITERATIONS = 20;
+    const float        WORLD_SIZE = 2000.0f;
+    std::mt19937 random(12345);
+    std::uniform_real_distribution<float> position(-0.5f*WORLD_SIZE,
+                                                   0.5f*WORLD_SIZE);
+    std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+    std::uniform_real_distribution<float> extent(0.5f, 20.0f);
+
+    // The views: 6 cameras at random positions, looking at the center
+    scene::SViewFrustum views[NUM_VIEWS];
+    const scene::SViewFrustum *view_pointers[NUM_VIEWS];
+    for (unsigned int v = 0; v < NUM_VIEWS; v++)
+    {
+        core::matrix4 projection, view;
+        projection.buildProjectionMatrixPerspectiveFovLH(1.0f, 16.0f/9.0f,
+                                                         1.0f, 500.0f);
+        const core::vector3df eye(position(random), 50.0f, position(random));
+        view.buildCameraLookAtMatrixLH(eye, core::vector3df(0, 0, 0),
+                                       core::vector3df(0, 1, 0));
+        views[v].setFrom(projection * view);
+        view_pointers[v] = &views[v];
+    }
+
+    Log::info("FrustumCuller", "Culling benchmark, %d views, %s kernel.",
+              NUM_VIEWS, getKernelName());
+    const unsigned int sizes[] = { 10000, 30000, 100000 };
+    int result = 0;
+    for (unsigned int s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++)
+    {
+        const unsigned int n = sizes[s];
+        std::vector<core::vector3df> corners(8 * n);
+        FrustumCuller culler;
+        culler.setViews(view_pointers, NUM_VIEWS);
+        culler.resize(n);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            core::matrix4 transform;
+            transform.setRotationDegrees(core::vector3df(angle(random),
+                                                         angle(random),
+                                                         angle(random)));
+            transform.setTranslation(core::vector3df(position(random),
+                                                     position(random) * 0.05f,
+                                                     position(random)));
+            const core::vector3df half(extent(random), extent(random),
+                                       extent(random));
+            core::aabbox3df local(-half, half);
+            local.getEdges(&corners[8 * i]);
+            core::aabbox3df world;
+            for (unsigned int c = 0; c < 8; c++)
+            {
+                transform.transformVect(corners[8 * i + c]);
+                if (c == 0)
+                    world.reset(corners[8 * i]);
+                else
+                    world.addInternalPoint(corners[8 * i + c]);
+            }
+            culler.setBox(i, world);
+        }
+
+        std::vector<unsigned int> reference(n), scalar(n), simd(n);
+
+        // The previous culling: all 8 corners against each plane
+        Clock::time_point start = Clock::now();
+        for (unsigned int it = 0; it < ITERATIONS; it++)
+        {
+            for (unsigned int i = 0; i < n; i++)
+            {
+                unsigned int mask = 0;
+                for (unsigned int v = 0; v < NUM_VIEWS; v++)
+                {
+                    for (unsigned int p = 0; p < NUM_PLANES; p++)
+                    {
+                        unsigned int c = 0;
+                        for (; c < 8; c++)
+                            if (views[v].planes[p].classifyPointRelation(
+                                    corners[8 * i + c]) != core::ISREL3D_FRONT)
+                                break;
+                        if (c == 8)
+                        {
+                            mask |= 1 << v;
+                            break;
+                        }
+                    }
+                }
+                reference[i] = mask;
+            }
+        }
+        const double t_reference =
+            std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count() / ITERATIONS;
+
+        start = Clock::now();
+        for (unsigned int it = 0; it < ITERATIONS; it++)
+        {
+            for (unsigned int i = 0; i < n; i++)
+                scalar[i] = 0;
+            culler.cullScalar(0, n, &scalar[0]);
+        }
+        const double t_scalar =
+            std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count() / ITERATIONS;
+
+        start = Clock::now();
+        for (unsigned int it = 0; it < ITERATIONS; it++)
+            culler.cull(0, n, &simd[0]);
+        const double t_simd =
+            std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count() / ITERATIONS;
+
+        StaticSceneBVH bvh;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            bvh.addBox(core::aabbox3df(culler.m_min[0][i], culler.m_min[1][i],
+                                       culler.m_min[2][i], culler.m_max[0][i],
+                                       culler.m_max[1][i], culler.m_max[2][i]));
+        }
+        // The first call builds the hierarchy
+        start = Clock::now();
+        bvh.cull(view_pointers, NUM_VIEWS);
+        const double t_build =
+            std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+        start = Clock::now();
+        for (unsigned int it = 0; it < ITERATIONS; it++)
+            bvh.cull(view_pointers, NUM_VIEWS);
+        const double t_bvh =
+            std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count() / ITERATIONS;
+
+        unsigned int simd_mismatch = 0, bvh_mismatch = 0;
+        unsigned int not_conservative = 0, bvh_not_conservative = 0;
+        unsigned int culled_reference = 0, culled_boxes = 0;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            if (simd[i] != scalar[i])
+                simd_mismatch++;
+            if (bvh.getCulled(i) != scalar[i])
+                bvh_mismatch++;
+            if (scalar[i] & ~reference[i])
+                not_conservative++;
+            if (bvh.getCulled(i) & ~reference[i])
+                bvh_not_conservative++;
+            culled_reference += (reference[i] & 1);
+            culled_boxes     += (scalar[i] & 1);
+        }
+        Log::info("FrustumCuller", "%6d nodes: corners %.3f ms, scalar "
+                  "boxes %.3f ms, %s boxes %.3f ms.", n, t_reference,
+                  t_scalar, getKernelName(), t_simd);
+        Log::info("FrustumCuller", "%6d nodes: hierarchy with %d nodes "
+                  "%.3f ms (%.0f%% of %s boxes), built in %.3f ms.", n,
+                  bvh.getNumNodes(), t_bvh,
+                  t_simd > 0 ? 100.0 * t_bvh / t_simd : 0.0,
+                  getKernelName(), t_build);
+        Log::info("FrustumCuller", "%6d nodes: culled for first view: "
+                  "%d (corners), %d (boxes).", n, culled_reference,
+                  culled_boxes);
+        if (simd_mismatch > 0 || bvh_mismatch > 0 || not_conservative > 0 ||
+            bvh_not_conservative > 0)
+        {
+            Log::error("FrustumCuller", "%d SIMD and %d hierarchy results "
+                       "differ from the scalar results, %d boxes (%d in the "
+                       "hierarchy) are culled although visible.",
+                       simd_mismatch, bvh_mismatch, not_conservative,
+                       bvh_not_conservative);
+            result = 1;
+        }
+    }
+    return result;
+}   // runBenchmark
@@ -0,0 +1,102 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_FRUSTUM_CULLER_HPP
+#define HEADER_FRUSTUM_CULLER_HPP
+
+#include "utils/no_copy.hpp"
+
+#include "aabbox3d.h"
+#include "plane3d.h"
+
+#include <vector>
+
+namespace irr
+{
+    namespace scene { struct SViewFrustum; }
+}
+
+using namespace irr;
+
+/** Tests axis aligned bounding boxes (in world space) against the frustums
+ *  of several views at once. The boxes are stored as one array for each
+ *  coordinate, so that an SSE (or AVX) kernel can test 4 (or 8) boxes
+ *  against a plane with a few instructions. The kernel is selected at
+ *  compile time, a scalar version is used if neither is available.
+ *  A box is culled for a view if it is completely in front of one plane
+ *  of the view frustum (the planes point outwards, so this means outside
+ *  of the frustum, as in irrlicht's EAC_FRUSTUM_BOX test). Since only the
+ *  corner of the box that is closest to the inside of the frustum needs
+ *  to be tested, this is cheaper than testing all 8 corners of
+ *  the transformed node bounding box, but it is slightly more conservative
+ *  for rotated nodes.
+ *  Different boxes can be culled in parallel by different threads, as long
+ *  as the views and boxes are not changed at the same time.
+ * \ingroup graphics
+ */
+class FrustumCuller : public NoCopy
+{
+public:
+    /** Maximum number of views, one bit of the result mask is used for
+     *  each view. */
+    enum { MAX_VIEWS = 8 };
+
+private:
+    /** The minimum and maximum x, y and z coordinates of all boxes. */
+    std::vector<float>           m_min[3];
+    std::vector<float>           m_max[3];
+
+    /** The planes of all views, VF_PLANE_COUNT planes for each view. */
+    std::vector<core::plane3df>  m_planes;
+
+    /** Number of views. */
+    unsigned int                 m_num_views;
+
+    void cullScalar(unsigned int begin, unsigned int end,
+                    unsigned int *culled) const;
+    void cullSIMD(unsigned int begin, unsigned int end,
+                  unsigned int *culled) const;
+
+public:
+                 FrustumCuller();
+    void         setViews(const scene::SViewFrustum * const *frustums,
+                          unsigned int num_views);
+    void         resize(unsigned int num_boxes);
+    void         cull(unsigned int begin, unsigned int end,
+                      unsigned int *culled) const;
+    static int   runBenchmark();
+    static const char *getKernelName();
+    // ------------------------------------------------------------------------
+    /** Sets the world space bounding box of a node.
+     *  \param i Index of the box.
+     *  \param box The bounding box. */
+    void setBox(unsigned int i, const core::aabbox3df &box)
+    {
+        m_min[0][i] = box.MinEdge.X;
+        m_min[1][i] = box.MinEdge.Y;
+        m_min[2][i] = box.MinEdge.Z;
+        m_max[0][i] = box.MaxEdge.X;
+        m_max[1][i] = box.MaxEdge.Y;
+        m_max[2][i] = box.MaxEdge.Z;
+    }   // setBox
+    // ------------------------------------------------------------------------
+    /** Returns the number of boxes. */
+    unsigned int getNumBoxes() const { return (unsigned int)m_min[0].size(); }
+};   // FrustumCuller
+
+#endif
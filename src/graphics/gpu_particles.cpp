@@ -181,31 +181,22 @@ void ParticleSystemProxy::setFlip()
     flip = true;
 }
 
-void ParticleSystemProxy::setHeightmap(const std::vector<std::vector<float> > &hm,
+/** Sets the height map used for particle collision.
+ *  \param hm The height samples, stored row-major (see HeightMap).
+ */
+void ParticleSystemProxy::setHeightmap(const std::vector<float> &hm,
     float f1, float f2, float f3, float f4)
 {
     track_x = f1, track_z = f2, track_x_len = f3, track_z_len = f4;
 
-    unsigned width  = (unsigned)hm.size();
-    unsigned height = (unsigned)hm[0].size();
-    float *hm_array = new float[width * height];
-    for (unsigned i = 0; i < width; i++)
-    {
-        for (unsigned j = 0; j < height; j++)
-        {
-            hm_array[i * height + j] = hm[i][j];
-        }
-    }
     has_height_map = true;
     glGenBuffers(1, &heighmapbuffer);
     glBindBuffer(GL_TEXTURE_BUFFER, heighmapbuffer);
-    glBufferData(GL_TEXTURE_BUFFER, width * height * sizeof(float), hm_array, GL_STREAM_COPY);
+    glBufferData(GL_TEXTURE_BUFFER, hm.size() * sizeof(float), hm.data(), GL_STREAM_COPY);
     glGenTextures(1, &heightmaptexture);
     glBindTexture(GL_TEXTURE_BUFFER, heightmaptexture);
     glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, heighmapbuffer);
     glBindBuffer(GL_TEXTURE_BUFFER, 0);
-
-    delete[] hm_array;
 }
 
 static
@@ -104,7 +104,7 @@ public:
     void setColorTo(float r, float g, float b) { m_color_to[0] = r; m_color_to[1] = g; m_color_to[2] = b; }
     const float* getColorFrom() const { return m_color_from; }
     const float* getColorTo() const { return m_color_to; }
-    void setHeightmap(const std::vector<std::vector<float> >&, float, float, float, float);
+    void setHeightmap(const std::vector<float>&, float, float, float, float);
     void setFlip();
 };
 
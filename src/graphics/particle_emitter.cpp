@@ -27,6 +27,7 @@
 #include "graphics/shaders.hpp"
 #include "graphics/wind.hpp"
 #include "io/file_manager.hpp"
+#include "tracks/height_map.hpp"
 #include "tracks/track.hpp"
 #include "utils/constants.hpp"
 #include "utils/helpers.hpp"
@@ -106,12 +107,12 @@ public:
 
 class HeightMapCollisionAffector : public scene::IParticleAffector
 {
-    std::vector< std::vector<float> > m_height_map;
+    const HeightMap *m_height_map;
     Track* m_track;
     bool m_first_time;
 
 public:
-    HeightMapCollisionAffector(Track* t) : m_height_map(t->buildHeightMap())
+    HeightMapCollisionAffector(Track* t) : m_height_map(t->getHeightMap())
     {
         m_track = t;
         m_first_time = true;
@@ -141,7 +142,7 @@ public:
             // debug draw
             core::vector3df lp = curr.pos;
             core::vector3df lp2 = curr.pos;
-            lp2.Y = m_height_map[i][j] + 0.02f;
+            lp2.Y = height + 0.02f;
 
             irr_driver->getVideoDriver()->draw3DLine(lp, lp2, video::SColor(255,255,0,0));
             core::vector3df lp3 = lp2;
@@ -154,15 +155,15 @@ public:
             irr_driver->getVideoDriver()->draw3DBox(core::aabbox3d< f32 >(lp2, lp3), video::SColor(255,255,0,0));
             */
 
+            const float height = m_height_map->getSample(i, j);
             if (m_first_time)
             {
-                curr.pos.Y = m_height_map[i][j]
-                           + (curr.pos.Y - m_height_map[i][j])
-                                *((rand()%500)/500.0f);
+                curr.pos.Y = height
+                           + (curr.pos.Y - height)*((rand()%500)/500.0f);
             }
             else
             {
-                if (curr.pos.Y < m_height_map[i][j])
+                if (curr.pos.Y < height)
                 {
                     //curr.color = video::SColor(255,255,0,0);
                     curr.endTime = curr.startTime; // destroy particle
@@ -717,7 +718,7 @@ void ParticleEmitter::addHeightMapAffector(Track* t)
         float track_z = aabb_min->getZ();
         const float track_x_len = aabb_max->getX() - aabb_min->getX();
         const float track_z_len = aabb_max->getZ() - aabb_min->getZ();
-        static_cast<ParticleSystemProxy *>(m_node)->setHeightmap(t->buildHeightMap(),
+        static_cast<ParticleSystemProxy *>(m_node)->setHeightmap(t->getHeightMap()->getSamples(),
             track_x, track_z, track_x_len, track_z_len);
     }
     else
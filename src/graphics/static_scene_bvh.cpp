@@ -0,0 +1,350 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "graphics/static_scene_bvh.hpp"
+
+#include "graphics/stk_mesh_scene_node.hpp"
+
+#include "ISceneNode.h"
+#include "SViewFrustum.h"
+
+#include <algorithm>
+#include <assert.h>
+
+namespace
+{
+    const unsigned int NUM_PLANES = scene::SViewFrustum::VF_PLANE_COUNT;
+
+    /** Returns the signed distance of the corner of a box which is furthest
+     *  in front of the plane (if furthest is true) or furthest behind it.
+     *  A box is in front of a plane if the distance of the corner furthest
+     *  behind it is positive. The order of operations is the same as in the
+     *  FrustumCuller, so that the results are identical. */
+    inline float planeDistance(const core::plane3df &plane,
+                               const core::aabbox3df &box, bool furthest)
+    {
+        const core::vector3df &hi = furthest ? box.MaxEdge : box.MinEdge;
+        const core::vector3df &lo = furthest ? box.MinEdge : box.MaxEdge;
+        return (plane.Normal.X * (plane.Normal.X > 0 ? hi.X : lo.X) +
+                plane.Normal.Y * (plane.Normal.Y > 0 ? hi.Y : lo.Y)) +
+               (plane.Normal.Z * (plane.Normal.Z > 0 ? hi.Z : lo.Z) +
+                plane.D);
+    }   // planeDistance
+}   // namespace
+
+// ----------------------------------------------------------------------------
+StaticSceneBVH::StaticSceneBVH()
+{
+    m_num_views   = 0;
+    m_needs_build = false;
+    m_needs_refit = false;
+}   // StaticSceneBVH
+
+// ----------------------------------------------------------------------------
+/** Computes the world space bounding box of a node in the same way as the
+ *  scene manager does for nodes which are not in a hierarchy.
+ *  \param transform The absolute transformation of the node.
+ *  \param box The bounding box of the node.
+ *  \param world_box Receives the box in world coordinates.
+ */
+void StaticSceneBVH::transformBox(const core::matrix4 &transform,
+                                  const core::aabbox3df &box,
+                                  core::aabbox3df *world_box)
+{
+    core::vector3df edges[8];
+    box.getEdges(edges);
+    for (unsigned int i = 0; i < 8; i++)
+    {
+        transform.transformVect(edges[i]);
+        if (i == 0)
+            world_box->reset(edges[0]);
+        else
+            world_box->addInternalPoint(edges[i]);
+    }
+}   // transformBox
+
+// ----------------------------------------------------------------------------
+/** Adds all mesh nodes in a subtree of the scene graph which use automatic
+ *  culling. Nodes which are already part of this hierarchy are ignored.
+ *  \param node The root of the subtree.
+ */
+void StaticSceneBVH::addNodes(scene::ISceneNode *node)
+{
+    STKMeshSceneNode *mesh = dynamic_cast<STKMeshSceneNode*>(node);
+    if (mesh && !mesh->isImmediateDraw() && node->getAutomaticCulling() &&
+        getLeaf(mesh) < 0)
+    {
+        Leaf leaf;
+        leaf.m_node      = node;
+        leaf.m_mesh      = mesh;
+        leaf.m_transform = node->getAbsoluteTransformation();
+        leaf.m_local_box = node->getBoundingBox();
+        leaf.m_culled    = 0;
+        transformBox(leaf.m_transform, leaf.m_local_box, &leaf.m_box);
+        leaf.m_transform.getInverse(leaf.m_inverse);
+        mesh->setBVHLeaf((int)m_leaves.size());
+        m_leaves.push_back(leaf);
+        m_needs_build = true;
+    }
+
+    const core::list<scene::ISceneNode*> &children = node->getChildren();
+    core::list<scene::ISceneNode*>::ConstIterator i = children.begin();
+    for (; i != children.end(); ++i)
+        addNodes(*i);
+}   // addNodes
+
+// ----------------------------------------------------------------------------
+/** Adds a leaf which is not connected to a scene node (used for testing).
+ *  \param box The bounding box in world coordinates.
+ */
+void StaticSceneBVH::addBox(const core::aabbox3df &box)
+{
+    Leaf leaf;
+    leaf.m_node      = NULL;
+    leaf.m_mesh      = NULL;
+    leaf.m_box       = box;
+    leaf.m_local_box = box;
+    leaf.m_culled    = 0;
+    m_leaves.push_back(leaf);
+    m_needs_build = true;
+}   // addBox
+
+// ----------------------------------------------------------------------------
+/** Returns the index of the leaf of a mesh node, or -1 if the node is not
+ *  part of this hierarchy. */
+int StaticSceneBVH::getLeaf(const STKMeshCommon *mesh) const
+{
+    const int leaf = mesh->getBVHLeaf();
+    if (leaf < 0 || leaf >= (int)m_leaves.size() ||
+        m_leaves[leaf].m_mesh != mesh)
+        return -1;
+    return leaf;
+}   // getLeaf
+
+// ----------------------------------------------------------------------------
+/** Updates the world space box of a leaf if the absolute transformation or
+ *  the bounding box of its node has changed. This must be called after the
+ *  absolute position of the node was updated, and not in parallel with
+ *  cull().
+ *  \param leaf Index of the leaf.
+ */
+void StaticSceneBVH::updateLeaf(unsigned int leaf)
+{
+    Leaf &l = m_leaves[leaf];
+    const core::matrix4   &transform = l.m_node->getAbsoluteTransformation();
+    const core::aabbox3df &box       = l.m_node->getBoundingBox();
+    if (transform == l.m_transform && box == l.m_local_box)
+        return;
+    l.m_transform = transform;
+    l.m_local_box = box;
+    transformBox(transform, box, &l.m_box);
+    transform.getInverse(l.m_inverse);
+    m_needs_refit = true;
+}   // updateLeaf
+
+// ----------------------------------------------------------------------------
+/** Builds the subtree for the leaves m_order[first, first+count) by
+ *  splitting them at the median of the box centers along the axis in which
+ *  the centers are spread out most.
+ *  \return The index of the root node of the subtree.
+ */
+unsigned int StaticSceneBVH::buildNode(unsigned int first, unsigned int count)
+{
+    const unsigned int index = (unsigned int)m_nodes.size();
+    Node node;
+    node.m_first_leaf   = first;
+    node.m_num_leaves   = count;
+    node.m_second_child = 0;
+    node.m_box          = m_leaves[m_order[first]].m_box;
+    core::aabbox3df centers(m_leaves[m_order[first]].m_box.getCenter());
+    for (unsigned int i = first + 1; i < first + count; i++)
+    {
+        node.m_box.addInternalBox(m_leaves[m_order[i]].m_box);
+        centers.addInternalPoint(m_leaves[m_order[i]].m_box.getCenter());
+    }
+    m_nodes.push_back(node);
+    if (count <= MAX_LEAVES_PER_NODE)
+        return index;
+
+    const core::vector3df extent = centers.getExtent();
+    const int axis = extent.X >= extent.Y && extent.X >= extent.Z ? 0
+                   : extent.Y >= extent.Z                         ? 1 : 2;
+    const std::vector<Leaf> &leaves = m_leaves;
+    std::vector<unsigned int>::iterator begin = m_order.begin() + first;
+    std::nth_element(begin, begin + count / 2, begin + count,
+        [&leaves, axis](unsigned int a, unsigned int b)
+        {
+            const core::vector3df ca = leaves[a].m_box.getCenter();
+            const core::vector3df cb = leaves[b].m_box.getCenter();
+            return axis == 0 ? ca.X < cb.X : axis == 1 ? ca.Y < cb.Y
+                                                       : ca.Z < cb.Z;
+        });
+
+    buildNode(first, count / 2);
+    const unsigned int second = buildNode(first + count / 2,
+                                          count - count / 2);
+    m_nodes[index].m_second_child = second;
+    return index;
+}   // buildNode
+
+// ----------------------------------------------------------------------------
+/** Recomputes the boxes of all nodes from the leaf boxes. Since children are
+ *  always stored after their parent, one pass in reverse order is enough.
+ */
+void StaticSceneBVH::refit()
+{
+    for (unsigned int i = (unsigned int)m_nodes.size(); i-- > 0; )
+    {
+        Node &node = m_nodes[i];
+        if (node.m_second_child == 0)
+        {
+            node.m_box = m_leaves[m_order[node.m_first_leaf]].m_box;
+            for (unsigned int j = 1; j < node.m_num_leaves; j++)
+            {
+                const unsigned int leaf = m_order[node.m_first_leaf + j];
+                node.m_box.addInternalBox(m_leaves[leaf].m_box);
+            }
+        }
+        else
+        {
+            node.m_box = m_nodes[i + 1].m_box;
+            node.m_box.addInternalBox(m_nodes[node.m_second_child].m_box);
+        }
+    }
+    m_needs_refit = false;
+}   // refit
+
+// ----------------------------------------------------------------------------
+/** Tests a box against the planes of all views which are still active.
+ *  The planes point outwards, so a view is culled if the box is completely
+ *  in front of one of its planes. A plane is deactivated if no corner of
+ *  the box is in front of it, since it can then not cull any box inside of
+ *  this box. All planes of culled views are
+ *  deactivated as well.
+ *  \param box The box to test.
+ *  \param active Bit v*VF_PLANE_COUNT+p is set if plane p of view v
+ *         still needs to be tested.
+ *  \param culled Bit v is set if the box is culled for view v.
+ */
+void StaticSceneBVH::testBox(const core::aabbox3df &box, uint64_t *active,
+                             unsigned int *culled) const
+{
+    for (unsigned int v = 0; v < m_num_views; v++)
+    {
+        const uint64_t view_planes = ((uint64_t(1) << NUM_PLANES) - 1)
+                                   << (v * NUM_PLANES);
+        if (!(*active & view_planes))
+            continue;
+        for (unsigned int p = 0; p < NUM_PLANES; p++)
+        {
+            const uint64_t bit = uint64_t(1) << (v * NUM_PLANES + p);
+            if (!(*active & bit))
+                continue;
+            const core::plane3df &plane = m_planes[v * NUM_PLANES + p];
+            // Same test as plane3df::classifyPointRelation (ISREL3D_FRONT)
+            if (planeDistance(plane, box, /*furthest*/false) >
+                core::ROUNDING_ERROR_f32)
+            {
+                *culled |= 1 << v;
+                *active &= ~view_planes;
+                break;
+            }
+            if (planeDistance(plane, box, /*furthest*/true) <=
+                core::ROUNDING_ERROR_f32)
+                *active &= ~bit;
+        }
+    }
+}   // testBox
+
+// ----------------------------------------------------------------------------
+/** Sets the culling mask of all leaves of a subtree. */
+void StaticSceneBVH::setCulled(const Node &node, unsigned int culled)
+{
+    for (unsigned int i = 0; i < node.m_num_leaves; i++)
+        m_leaves[m_order[node.m_first_leaf + i]].m_culled = culled;
+}   // setCulled
+
+// ----------------------------------------------------------------------------
+/** Culls a subtree.
+ *  \param index Index of the root node of the subtree.
+ *  \param active The planes which need to be tested (see testBox()).
+ *  \param culled The views for which the parent node is culled.
+ */
+void StaticSceneBVH::cullNode(unsigned int index, uint64_t active,
+                              unsigned int culled)
+{
+    const Node &node = m_nodes[index];
+    testBox(node.m_box, &active, &culled);
+    if (active == 0)
+    {
+        setCulled(node, culled);
+        return;
+    }
+    if (node.m_second_child == 0)
+    {
+        for (unsigned int i = 0; i < node.m_num_leaves; i++)
+        {
+            Leaf &leaf = m_leaves[m_order[node.m_first_leaf + i]];
+            uint64_t leaf_active = active;
+            leaf.m_culled = culled;
+            testBox(leaf.m_box, &leaf_active, &leaf.m_culled);
+        }
+        return;
+    }
+    cullNode(index + 1, active, culled);
+    cullNode(node.m_second_child, active, culled);
+}   // cullNode
+
+// ----------------------------------------------------------------------------
+/** Culls all leaves against several views. The tree is built or refitted
+ *  first if necessary. The result for each leaf can be queried with
+ *  getCulled(), bit i corresponds to frustums[i].
+ *  \param frustums The view frustums.
+ *  \param num_views Number of views (at most MAX_VIEWS).
+ */
+void StaticSceneBVH::cull(const scene::SViewFrustum * const *frustums,
+                          unsigned int num_views)
+{
+    assert(num_views <= MAX_VIEWS);
+    if (m_leaves.empty())
+        return;
+    if (m_needs_build)
+    {
+        m_order.resize(m_leaves.size());
+        for (unsigned int i = 0; i < m_order.size(); i++)
+            m_order[i] = i;
+        m_nodes.clear();
+        buildNode(0, (unsigned int)m_order.size());
+        m_needs_build = false;
+        m_needs_refit = false;
+    }
+    else if (m_needs_refit)
+        refit();
+
+    m_num_views = num_views;
+    m_planes.resize(num_views * NUM_PLANES);
+    for (unsigned int v = 0; v < num_views; v++)
+    {
+        for (unsigned int p = 0; p < NUM_PLANES; p++)
+            m_planes[v * NUM_PLANES + p] = frustums[v]->planes[p];
+    }
+    const uint64_t all_planes = num_views * NUM_PLANES == 64
+                              ? ~uint64_t(0)
+                              : (uint64_t(1) << (num_views * NUM_PLANES)) - 1;
+    cullNode(0, all_planes, 0);
+}   // cull
@@ -0,0 +1,157 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_STATIC_SCENE_BVH_HPP
+#define HEADER_STATIC_SCENE_BVH_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+
+#include "aabbox3d.h"
+#include "matrix4.h"
+#include "plane3d.h"
+
+#include <vector>
+
+namespace irr
+{
+    namespace scene { class ISceneNode; struct SViewFrustum; }
+}
+
+using namespace irr;
+
+class STKMeshCommon;
+
+/** A bounding volume hierarchy over the mesh nodes of a track, which are
+ *  (nearly all) static. It is created when the track is loaded, and built
+ *  the first time it is used for culling (when the absolute positions of
+ *  all nodes are known). Each frame the scene manager checks the leaves of
+ *  the visible nodes: if the transformation or bounding box of a node has
+ *  changed (i.e. it is an animated track object), the world space box of
+ *  the leaf is updated and the boxes of the tree are refitted. The tree
+ *  structure itself is never changed.
+ *  The hierarchy is traversed once for all views: for each view the planes
+ *  which can still cull a box are tracked, and a subtree is decided as soon
+ *  as it is culled or completely inside for all views. The results are
+ *  exactly the same as when culling the box of each leaf with the
+ *  FrustumCuller.
+ * \ingroup graphics
+ */
+class StaticSceneBVH : public NoCopy
+{
+public:
+    /** Maximum number of views, one bit of the result mask is used for
+     *  each view. */
+    enum { MAX_VIEWS = 8 };
+
+private:
+    /** Maximum number of leaves in a leaf node of the tree. */
+    enum { MAX_LEAVES_PER_NODE = 4 };
+
+    /** A mesh node in the hierarchy. */
+    struct Leaf
+    {
+        /** The scene node, NULL for boxes added with addBox(). */
+        scene::ISceneNode *m_node;
+        /** The mesh of the scene node. */
+        STKMeshCommon     *m_mesh;
+        /** The bounding box in world coordinates. */
+        core::aabbox3df    m_box;
+        /** The bounding box of the node the world box was computed from. */
+        core::aabbox3df    m_local_box;
+        /** The absolute transformation the world box was computed from. */
+        core::matrix4      m_transform;
+        /** Inverse of m_transform. */
+        core::matrix4      m_inverse;
+        /** Bit v is set if the leaf was culled for view v. */
+        unsigned int       m_culled;
+    };   // Leaf
+
+    /** A node of the tree. The nodes are stored in depth first order, so
+     *  the first child of an inner node is always the next node, and all
+     *  leaves of a subtree are consecutive in m_order. */
+    struct Node
+    {
+        /** The bounding box of all leaves of this subtree. */
+        core::aabbox3df m_box;
+        /** Index of the first leaf of this subtree in m_order. */
+        unsigned int    m_first_leaf;
+        /** Number of leaves of this subtree. */
+        unsigned int    m_num_leaves;
+        /** Index of the second child, or 0 if this is a leaf node. */
+        unsigned int    m_second_child;
+    };   // Node
+
+    /** All leaves, in the order in which they were added. The index of a
+     *  leaf never changes, it is stored in the mesh node. */
+    std::vector<Leaf>           m_leaves;
+
+    /** The leaf indices, sorted so that each node covers a range. */
+    std::vector<unsigned int>   m_order;
+
+    /** The nodes of the tree, m_nodes[0] is the root. */
+    std::vector<Node>           m_nodes;
+
+    /** The planes of all views, VF_PLANE_COUNT planes for each view. */
+    std::vector<core::plane3df> m_planes;
+
+    /** Number of views. */
+    unsigned int                m_num_views;
+
+    /** True if leaves were added since the tree was built. */
+    bool                        m_needs_build;
+
+    /** True if a leaf box has changed since the boxes were refitted. */
+    bool                        m_needs_refit;
+
+    unsigned int buildNode(unsigned int first, unsigned int count);
+    void         refit();
+    void         cullNode(unsigned int index, uint64_t active,
+                          unsigned int culled);
+    void         testBox(const core::aabbox3df &box, uint64_t *active,
+                         unsigned int *culled) const;
+    void         setCulled(const Node &node, unsigned int culled);
+
+public:
+                 StaticSceneBVH();
+    void         addNodes(scene::ISceneNode *node);
+    void         addBox(const core::aabbox3df &box);
+    int          getLeaf(const STKMeshCommon *mesh) const;
+    void         updateLeaf(unsigned int leaf);
+    void         cull(const scene::SViewFrustum * const *frustums,
+                      unsigned int num_views);
+    static void  transformBox(const core::matrix4 &transform,
+                              const core::aabbox3df &box,
+                              core::aabbox3df *world_box);
+    // ------------------------------------------------------------------------
+    /** Returns the culling mask of a leaf computed by the last cull(). */
+    unsigned int getCulled(unsigned int leaf) const
+                                           { return m_leaves[leaf].m_culled; }
+    // ------------------------------------------------------------------------
+    /** Returns the inverse of the absolute transformation of a leaf. */
+    const core::matrix4& getInverseTransform(unsigned int leaf) const
+                                          { return m_leaves[leaf].m_inverse; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of leaves. */
+    unsigned int getNumLeaves() const { return (unsigned int)m_leaves.size(); }
+    // ------------------------------------------------------------------------
+    /** Returns the number of nodes of the tree. */
+    unsigned int getNumNodes() const { return (unsigned int)m_nodes.size(); }
+};   // StaticSceneBVH
+
+#endif
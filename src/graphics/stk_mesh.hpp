@@ -78,13 +78,19 @@ class STKMeshCommon
 protected:
     std::string m_debug_name;
 
+    /** Index of the leaf of the StaticSceneBVH containing this node, or -1. */
+    int m_bvh_leaf;
+
 public:
+    STKMeshCommon() : m_bvh_leaf(-1) {}
     PtrVector<GLMesh, REF> MeshSolidMaterial[Material::SHADERTYPE_COUNT];
     PtrVector<GLMesh, REF> TransparentMesh[TM_COUNT];
     virtual void updateNoGL() = 0;
     virtual void updateGL() = 0;
     virtual bool glow() const = 0;
     virtual bool isImmediateDraw() const { return false; }
+    int getBVHLeaf() const { return m_bvh_leaf; }
+    void setBVHLeaf(int leaf) { m_bvh_leaf = leaf; }
 };   // STKMeshCommon
 
 // ----------------------------------------------------------------------------
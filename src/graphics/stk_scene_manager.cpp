@@ -19,16 +19,19 @@
 
 #include "graphics/callbacks.hpp"
 #include "graphics/central_settings.hpp"
+#include "graphics/frustum_culler.hpp"
 #include "graphics/glwrap.hpp"
 #include "graphics/irr_driver.hpp"
 #include "graphics/lod_node.hpp"
 #include "graphics/shadow_matrices.hpp"
+#include "graphics/static_scene_bvh.hpp"
 #include "graphics/stk_animated_mesh.hpp"
 #include "graphics/stk_mesh.hpp"
 #include "graphics/stk_mesh_scene_node.hpp"
 #include "modes/world.hpp"
 #include "tracks/track.hpp"
 #include "utils/cpp2011.hpp"
+#include "utils/job_system.hpp"
 #include "utils/profiler.hpp"
 #include "utils/ptr_vector.hpp"
 #include "utils/time.hpp"
@@ -38,6 +41,7 @@
 #include <ISceneNode.h>
 #include <SViewFrustum.h>
 
+#include <algorithm>
 #include <unordered_map>
 #include <SViewFrustum.h>
 #include <functional>
@@ -175,16 +179,6 @@ static std::vector <STKMeshCommon *> DeferredUpdate;
 
 static core::vector3df windDir;
 
-// From irrlicht code
-static
-bool isBoxInFrontOfPlane(const core::plane3df &plane, const core::vector3df edges[8])
-{
-    for (u32 j = 0; j<8; ++j)
-        if (plane.classifyPointRelation(edges[j]) != core::ISREL3D_FRONT)
-            return false;
-    return true;
-}
-
 std::vector<float> BoundingBoxes;
 
 static void addEdge(const core::vector3df &P0, const core::vector3df &P1)
@@ -197,44 +191,168 @@ static void addEdge(const core::vector3df &P0, const core::vector3df &P1)
     BoundingBoxes.push_back(P1.Z);
 }
 
-static
-bool isCulledPrecise(const scene::ICameraSceneNode *cam, const scene::ISceneNode *node)
+/** Flags for the cameras a node is culled for. */
+enum CulledFor
 {
-    if (!node->getAutomaticCulling())
-        return false;
+    CULLED_CAM    = 1,
+    CULLED_RSM    = 2,
+    /** Shifted by the cascade index. */
+    CULLED_SHADOW = 4
+};
+
+/** A scene node collected by the scene graph traversal in PrepareDrawCalls.
+ *  The traversal itself is sequential, since the absolute positions and
+ *  the LOD levels depend on the parent nodes, and animated meshes must be
+ *  updated before they are culled. The mesh nodes of the track are culled
+ *  with the StaticSceneBVH of the track, all other collected nodes are
+ *  culled in parallel (using the world space bounding boxes stored in the
+ *  FrustumCuller), each entry is only modified by the thread that culls
+ *  it. Finally the draw lists are filled in traversal order.
+ */
+struct CulledNode
+{
+    enum NodeType { CN_MESH, CN_IMMEDIATE, CN_PARTICLES, CN_BILLBOARD, CN_OTHER };
+
+    scene::ISceneNode *m_node;
+    STKMeshCommon     *m_mesh;
+    NodeType           m_type;
+    /** Index of the parent node in CulledNodes, or -1. */
+    int                m_parent;
+    /** Index of the leaf in the StaticSceneBVH, or -1. */
+    int                m_leaf;
+    /** Combination of CulledFor flags, including the flags of the parents
+     *  once the culling is done. */
+    unsigned           m_culled;
+    /** Inverse of the absolute transformation (only for meshes). */
+    core::matrix4      m_inverse_model;
+    /** The bounding box in world coordinates. */
+    core::vector3df    m_edges[8];
+};
+
+static std::vector<CulledNode> CulledNodes;
+
+/** Indices (in CulledNodes) of the nodes culled with the FrustumCuller. */
+static std::vector<unsigned> FlatNodes;
+
+/** The hierarchy of the static track nodes, or NULL. */
+static StaticSceneBVH *SceneBVH;
+
+static void
+collectSceneNodes(core::list<scene::ISceneNode*> &List, int Parent)
+{
+    core::list<scene::ISceneNode*>::Iterator I = List.begin(), E = List.end();
+    for (; I != E; ++I)
+    {
+        if (LODNode *node = dynamic_cast<LODNode *>(*I))
+            node->updateVisibility();
+        (*I)->updateAbsolutePosition();
+        if (!(*I)->isVisible())
+            continue;
 
-    const core::matrix4 &trans = node->getAbsoluteTransformation();
-    const scene::SViewFrustum &frust = *cam->getViewFrustum();
+        CulledNode Culled;
+        Culled.m_node = *I;
+        Culled.m_mesh = NULL;
+        Culled.m_parent = Parent;
+        Culled.m_leaf = -1;
+        Culled.m_culled = 0;
+        if (dynamic_cast<ParticleSystemProxy *>(*I))
+        {
+            Culled.m_type = CulledNode::CN_PARTICLES;
+            FlatNodes.push_back((unsigned)CulledNodes.size());
+            CulledNodes.push_back(Culled);
+            continue;
+        }
+        if (dynamic_cast<STKBillboard *>(*I))
+        {
+            Culled.m_type = CulledNode::CN_BILLBOARD;
+            FlatNodes.push_back((unsigned)CulledNodes.size());
+            CulledNodes.push_back(Culled);
+            continue;
+        }
 
-    core::vector3df edges[8];
-    node->getBoundingBox().getEdges(edges);
-    for (unsigned i = 0; i < 8; i++)
-        trans.transformVect(edges[i]);
+        Culled.m_mesh = dynamic_cast<STKMeshCommon*>(*I);
+        if (Culled.m_mesh)
+        {
+            Culled.m_mesh->updateNoGL();
+            DeferredUpdate.push_back(Culled.m_mesh);
+            Culled.m_type = Culled.m_mesh->isImmediateDraw()
+                          ? CulledNode::CN_IMMEDIATE : CulledNode::CN_MESH;
+        }
+        else
+            Culled.m_type = CulledNode::CN_OTHER;
+        if (Culled.m_type == CulledNode::CN_MESH && SceneBVH)
+        {
+            Culled.m_leaf = SceneBVH->getLeaf(Culled.m_mesh);
+            if (Culled.m_leaf >= 0)
+                SceneBVH->updateLeaf(Culled.m_leaf);
+        }
+        const int Index = (int)CulledNodes.size();
+        if (Culled.m_type != CulledNode::CN_OTHER && Culled.m_leaf < 0)
+            FlatNodes.push_back(Index);
+        CulledNodes.push_back(Culled);
 
-    for (s32 i = 0; i < scene::SViewFrustum::VF_PLANE_COUNT; ++i)
-        if (isBoxInFrontOfPlane(frust.planes[i], edges))
-            return true;
-    return false;
+        collectSceneNodes(const_cast<core::list<scene::ISceneNode*>& >((*I)->getChildren()), Index);
+    }
 }
 
+static FrustumCuller Culler;
+
+/** Number of nodes culled together by one job. */
+static const unsigned CullChunkSize = 64;
+
+/** Culls the nodes FlatNodes[Begin, End) against all cameras (in the order
+ *  of the CulledFor flags), called in parallel for different chunks. */
 static void
-handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *ImmediateDraw,
-    const scene::ICameraSceneNode *cam, scene::ICameraSceneNode *shadowcam[4], const scene::ICameraSceneNode *rsmcam,
-    bool &culledforcam, bool culledforshadowcam[4], bool &culledforrsm, bool drawRSM)
+cullSceneNodes(unsigned Begin, unsigned End)
 {
-    STKMeshCommon *node = dynamic_cast<STKMeshCommon*>(Node);
-    if (!node)
-        return;
-    node->updateNoGL();
-    DeferredUpdate.push_back(node);
+    for (unsigned i = Begin; i < End; i++)
+    {
+        CulledNode &Culled = CulledNodes[FlatNodes[i]];
+        const core::matrix4 &trans = Culled.m_node->getAbsoluteTransformation();
+        Culled.m_node->getBoundingBox().getEdges(Culled.m_edges);
+        core::aabbox3df Box;
+        for (unsigned j = 0; j < 8; j++)
+        {
+            trans.transformVect(Culled.m_edges[j]);
+            if (j == 0)
+                Box.reset(Culled.m_edges[0]);
+            else
+                Box.addInternalPoint(Culled.m_edges[j]);
+        }
+        Culler.setBox(i, Box);
+        if (Culled.m_type == CulledNode::CN_MESH)
+            trans.getInverse(Culled.m_inverse_model);
+    }
 
+    unsigned Masks[CullChunkSize];
+    assert(End - Begin <= CullChunkSize);
+    Culler.cull(Begin, End, Masks);
 
-    const core::matrix4 &trans = Node->getAbsoluteTransformation();
+    for (unsigned i = Begin; i < End; i++)
+    {
+        CulledNode &Culled = CulledNodes[FlatNodes[i]];
+        if (!Culled.m_node->getAutomaticCulling())
+            continue;
+        switch (Culled.m_type)
+        {
+        case CulledNode::CN_MESH:
+            Culled.m_culled = Masks[i - Begin];
+            break;
+        case CulledNode::CN_PARTICLES:
+        case CulledNode::CN_BILLBOARD:
+            Culled.m_culled = Masks[i - Begin] & CULLED_CAM;
+            break;
+        default:
+            break;
+        }
+    }
+}
 
-    core::vector3df edges[8];
-    Node->getBoundingBox().getEdges(edges);
-    for (unsigned i = 0; i < 8; i++)
-        trans.transformVect(edges[i]);
+static void
+handleSTKCommon(const CulledNode &Culled, std::vector<scene::ISceneNode *> *ImmediateDraw, bool drawRSM)
+{
+    STKMeshCommon *node = Culled.m_mesh;
+    const core::vector3df *edges = Culled.m_edges;
 
     /* From irrlicht
        /3--------/7
@@ -263,16 +381,14 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
         addEdge(edges[4], edges[6]);
     }
 
-    if (node->isImmediateDraw())
+    if (Culled.m_type == CulledNode::CN_IMMEDIATE)
     {
-        ImmediateDraw->push_back(Node);
+        ImmediateDraw->push_back(Culled.m_node);
         return;
     }
 
-    culledforcam = culledforcam || isCulledPrecise(cam, Node);
-    culledforrsm = culledforrsm || isCulledPrecise(rsmcam, Node);
-    for (unsigned i = 0; i < 4; i++)
-        culledforshadowcam[i] = culledforshadowcam[i] || isCulledPrecise(shadowcam[i], Node);
+    const core::matrix4 &ModelMatrix = Culled.m_node->getAbsoluteTransformation();
+    const core::matrix4 &InvModelMatrix = Culled.m_inverse_model;
 
     // Transparent
 
@@ -293,23 +409,23 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
             tmpcol.getBlue() / 255.0f);
 
         for (GLMesh *mesh : node->TransparentMesh[TM_DEFAULT])
-            pushVector(ListBlendTransparentFog::getInstance(), mesh, Node->getAbsoluteTransformation(), mesh->TextureMatrix,
+            pushVector(ListBlendTransparentFog::getInstance(), mesh, ModelMatrix, mesh->TextureMatrix,
             fogmax, startH, endH, start, end, col);
         for (GLMesh *mesh : node->TransparentMesh[TM_ADDITIVE])
-            pushVector(ListAdditiveTransparentFog::getInstance(), mesh, Node->getAbsoluteTransformation(), mesh->TextureMatrix,
+            pushVector(ListAdditiveTransparentFog::getInstance(), mesh, ModelMatrix, mesh->TextureMatrix,
             fogmax, startH, endH, start, end, col);
     }
     else
     {
         for (GLMesh *mesh : node->TransparentMesh[TM_DEFAULT])
-            pushVector(ListBlendTransparent::getInstance(), mesh, Node->getAbsoluteTransformation(), mesh->TextureMatrix);
+            pushVector(ListBlendTransparent::getInstance(), mesh, ModelMatrix, mesh->TextureMatrix);
         for (GLMesh *mesh : node->TransparentMesh[TM_ADDITIVE])
-            pushVector(ListAdditiveTransparent::getInstance(), mesh, Node->getAbsoluteTransformation(), mesh->TextureMatrix);
+            pushVector(ListAdditiveTransparent::getInstance(), mesh, ModelMatrix, mesh->TextureMatrix);
     }
     for (GLMesh *mesh : node->TransparentMesh[TM_DISPLACEMENT])
-        pushVector(ListDisplacement::getInstance(), mesh, Node->getAbsoluteTransformation());
+        pushVector(ListDisplacement::getInstance(), mesh, ModelMatrix);
 
-    if (!culledforcam)
+    if (!(Culled.m_culled & CULLED_CAM))
     {
         for (unsigned Mat = 0; Mat < Material::SHADERTYPE_COUNT; ++Mat)
         {
@@ -318,14 +434,12 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
                 for (GLMesh *mesh : node->MeshSolidMaterial[Mat])
                 {
                     if (node->glow())
-                        MeshForGlowPass[mesh->mb].emplace_back(mesh, Node);
+                        MeshForGlowPass[mesh->mb].emplace_back(mesh, Culled.m_node);
 
                     if (Mat != Material::SHADERTYPE_SPLATTING && mesh->TextureMatrix.isIdentity())
-                        MeshForSolidPass[Mat][mesh->mb].emplace_back(mesh, Node);
+                        MeshForSolidPass[Mat][mesh->mb].emplace_back(mesh, Culled.m_node);
                     else
                     {
-                        core::matrix4 ModelMatrix = Node->getAbsoluteTransformation(), InvModelMatrix;
-                        ModelMatrix.getInverse(InvModelMatrix);
                         switch (Mat)
                         {
                         case Material::SHADERTYPE_SOLID:
@@ -346,9 +460,6 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
             }
             else
             {
-                core::matrix4 ModelMatrix = Node->getAbsoluteTransformation(), InvModelMatrix;
-                ModelMatrix.getInverse(InvModelMatrix);
-
                 for (GLMesh *mesh : node->MeshSolidMaterial[Mat])
                 {
                     switch (Mat)
@@ -386,7 +497,7 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
         return;
     for (unsigned cascade = 0; cascade < 4; ++cascade)
     {
-        if (culledforshadowcam[cascade])
+        if (Culled.m_culled & (CULLED_SHADOW << cascade))
             continue;
         for (unsigned Mat = 0; Mat < Material::SHADERTYPE_COUNT; ++Mat)
         {
@@ -395,20 +506,15 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
                 for (GLMesh *mesh : node->MeshSolidMaterial[Mat])
                 {
                     if (Mat != Material::SHADERTYPE_SPLATTING)
-                        MeshForShadowPass[Mat][cascade][mesh->mb].emplace_back(mesh, Node);
+                        MeshForShadowPass[Mat][cascade][mesh->mb].emplace_back(mesh, Culled.m_node);
                     else
                     {
-                        core::matrix4 ModelMatrix = Node->getAbsoluteTransformation(), InvModelMatrix;
-                        ModelMatrix.getInverse(InvModelMatrix);
                         ListMatSplatting::getInstance()->Shadows[cascade].emplace_back(mesh, ModelMatrix, InvModelMatrix);
                     }
                 }
             }
             else
             {
-                core::matrix4 ModelMatrix = Node->getAbsoluteTransformation(), InvModelMatrix;
-                ModelMatrix.getInverse(InvModelMatrix);
-
                 for (GLMesh *mesh : node->MeshSolidMaterial[Mat])
                 {
                     switch (Mat)
@@ -443,7 +549,7 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
     }
     if (!UserConfigParams::m_gi || !drawRSM)
         return;
-    if (!culledforrsm)
+    if (!(Culled.m_culled & CULLED_RSM))
     {
         for (unsigned Mat = 0; Mat < Material::SHADERTYPE_COUNT; ++Mat)
         {
@@ -452,22 +558,17 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
                 if (Mat == Material::SHADERTYPE_SPLATTING)
                     for (GLMesh *mesh : node->MeshSolidMaterial[Mat])
                     {
-                        core::matrix4 ModelMatrix = Node->getAbsoluteTransformation(), InvModelMatrix;
-                        ModelMatrix.getInverse(InvModelMatrix);
                        ListMatSplatting::getInstance()->RSM.emplace_back(mesh, ModelMatrix, InvModelMatrix);
                      }
                 else
                 {
                     for (GLMesh *mesh : node->MeshSolidMaterial[Mat])
-                        MeshForRSM[Mat][mesh->mb].emplace_back(mesh, Node);
+                        MeshForRSM[Mat][mesh->mb].emplace_back(mesh, Culled.m_node);
                 }
             }
             else
             {
 
-                core::matrix4 ModelMatrix = Node->getAbsoluteTransformation(), InvModelMatrix;
-                ModelMatrix.getInverse(InvModelMatrix);
-
                 for (GLMesh *mesh : node->MeshSolidMaterial[Mat])
                 {
                     switch (Mat)
@@ -506,38 +607,72 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
 static void
 parseSceneManager(core::list<scene::ISceneNode*> &List, std::vector<scene::ISceneNode *> *ImmediateDraw,
     const scene::ICameraSceneNode* cam, scene::ICameraSceneNode *shadow_cam[4], const scene::ICameraSceneNode *rsmcam,
-    bool culledforcam, bool culledforshadowcam[4], bool culledforrsm, bool drawRSM)
+    bool drawRSM)
 {
-    core::list<scene::ISceneNode*>::Iterator I = List.begin(), E = List.end();
-    for (; I != E; ++I)
-    {
-        if (LODNode *node = dynamic_cast<LODNode *>(*I))
-            node->updateVisibility();
-        (*I)->updateAbsolutePosition();
-        if (!(*I)->isVisible())
-            continue;
+    SceneBVH = World::getWorld() ? World::getWorld()->getTrack()->getStaticSceneBVH()
+                                 : NULL;
+    CulledNodes.clear();
+    FlatNodes.clear();
+    collectSceneNodes(List, -1);
 
-        if (ParticleSystemProxy *node = dynamic_cast<ParticleSystemProxy *>(*I))
+    const scene::SViewFrustum *Views[6] =
+    {
+        cam->getViewFrustum(), rsmcam->getViewFrustum(),
+        shadow_cam[0]->getViewFrustum(), shadow_cam[1]->getViewFrustum(),
+        shadow_cam[2]->getViewFrustum(), shadow_cam[3]->getViewFrustum()
+    };
+    Culler.setViews(Views, 6);
+    const unsigned NumNodes = (unsigned)FlatNodes.size();
+    Culler.resize(NumNodes);
+    // The hierarchy is traversed by one more job, at the same time as the
+    // other nodes are culled.
+    const unsigned NumChunks = (NumNodes + CullChunkSize - 1) / CullChunkSize;
+    JobSystem::get()->parallelFor(NumChunks + (SceneBVH ? 1 : 0),
+        [NumNodes, NumChunks, &Views](unsigned Chunk)
         {
-            if (!isCulledPrecise(cam, *I))
-                ParticlesList::getInstance()->push_back(node);
-            continue;
-        }
+            if (Chunk == NumChunks)
+            {
+                SceneBVH->cull(Views, 6);
+                return;
+            }
+            const unsigned Begin = Chunk * CullChunkSize;
+            cullSceneNodes(Begin, std::min(Begin + CullChunkSize, NumNodes));
+        });
 
-        if (STKBillboard *node = dynamic_cast<STKBillboard *>(*I))
+    // Children are always collected after their parent, so the culling
+    // flags of a parent are complete when its children are handled.
+    for (unsigned i = 0; i < CulledNodes.size(); i++)
+    {
+        CulledNode &Culled = CulledNodes[i];
+        switch (Culled.m_type)
         {
-            if (!isCulledPrecise(cam, *I))
-                BillBoardList::getInstance()->push_back(node);
-            continue;
+        case CulledNode::CN_PARTICLES:
+            if (!Culled.m_culled)
+                ParticlesList::getInstance()->push_back(static_cast<ParticleSystemProxy *>(Culled.m_node));
+            break;
+        case CulledNode::CN_BILLBOARD:
+            if (!Culled.m_culled)
+                BillBoardList::getInstance()->push_back(static_cast<STKBillboard *>(Culled.m_node));
+            break;
+        default:
+            if (Culled.m_leaf >= 0)
+            {
+                if (Culled.m_node->getAutomaticCulling())
+                    Culled.m_culled = SceneBVH->getCulled(Culled.m_leaf);
+                Culled.m_inverse_model = SceneBVH->getInverseTransform(Culled.m_leaf);
+                if (irr_driver->getBoundingBoxesViz())
+                {
+                    const core::matrix4 &trans = Culled.m_node->getAbsoluteTransformation();
+                    Culled.m_node->getBoundingBox().getEdges(Culled.m_edges);
+                    for (unsigned j = 0; j < 8; j++)
+                        trans.transformVect(Culled.m_edges[j]);
+                }
+            }
+            if (Culled.m_parent >= 0)
+                Culled.m_culled |= CulledNodes[Culled.m_parent].m_culled;
+            if (Culled.m_mesh)
+                handleSTKCommon(Culled, ImmediateDraw, drawRSM);
         }
-
-        bool newculledforcam = culledforcam;
-        bool newculledforrsm = culledforrsm;
-        bool newculledforshadowcam[4] = { culledforshadowcam[0], culledforshadowcam[1], culledforshadowcam[2], culledforshadowcam[3] };
-
-        handleSTKCommon(*I, ImmediateDraw, cam, shadow_cam, rsmcam, newculledforcam, newculledforshadowcam, newculledforrsm, drawRSM);
-
-        parseSceneManager(const_cast<core::list<scene::ISceneNode*>& >((*I)->getChildren()), ImmediateDraw, cam, shadow_cam, rsmcam, newculledforcam, newculledforshadowcam, newculledforrsm, drawRSM);
     }
 }
 
@@ -601,12 +736,9 @@ PROFILER_PUSH_CPU_MARKER("- culling", 0xFF, 0xFF, 0x0);
     for (scene::ISceneNode *child : List)
         FixBoundingBoxes(child);
 
-    bool cam = false, rsmcam = false;
-    bool shadowcam[4] = { false, false, false, false };
-    parseSceneManager(List, ImmediateDrawList::getInstance(), camnode, 
+    parseSceneManager(List, ImmediateDrawList::getInstance(), camnode,
                       getShadowMatrices()->getShadowCamNodes(),
-                      getShadowMatrices()->getSunCam(), cam,
-                      shadowcam, rsmcam,
+                      getShadowMatrices()->getSunCam(),
                       !getShadowMatrices()->isRSMMapAvail());
 PROFILER_POP_CPU_MARKER();
 
@@ -0,0 +1,66 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_MAPPED_FILE_HPP
+#define HEADER_MAPPED_FILE_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <stddef.h>
+#include <string>
+
+/** A read-only file that is mapped into memory, so that its content can be
+ *  accessed directly without reading (and parsing) it first. The operating
+ *  system loads the pages of the file on demand.
+ * \ingroup io
+ */
+class MappedFile : public NoCopy
+{
+private:
+    /** Start of the mapped file, or NULL if no file is mapped. */
+    const char *m_data;
+
+    /** Size of the mapped file in bytes. */
+    size_t      m_size;
+
+#ifdef WIN32
+    /** Handle of the file (a HANDLE, declared as void* to avoid including
+     *  windows.h in this header). */
+    void       *m_file;
+
+    /** Handle of the file mapping object. */
+    void       *m_mapping;
+#endif
+
+public:
+                MappedFile();
+               ~MappedFile();
+    bool        open(const std::string &filename);
+    void        close();
+    // ------------------------------------------------------------------------
+    /** Returns a pointer to the content of the file. */
+    const char *getData() const { return m_data; }
+    // ------------------------------------------------------------------------
+    /** Returns the size of the file. */
+    size_t      getSize() const { return m_size; }
+    // ------------------------------------------------------------------------
+    /** Returns true if a file is mapped. */
+    bool        isOpen() const  { return m_data != NULL; }
+};   // MappedFile
+
+#endif
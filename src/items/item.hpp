@@ -244,6 +244,9 @@ public:
     /** Returns the type of this item. */
     ItemType      getType()      const { return m_type;     }
     // ------------------------------------------------------------------------
+    /** Returns the square of the distance at which this item is hit. */
+    float         getHitDistance2() const { return m_distance_2; }
+    // ------------------------------------------------------------------------
     /** Returns true if this item is currently collected. */
     bool          wasCollected() const { return m_collected;}
     // ------------------------------------------------------------------------
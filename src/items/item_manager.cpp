@@ -45,6 +45,9 @@ std::vector<scene::IMesh *> ItemManager::m_item_lowres_mesh;
 std::vector<video::SColorf> ItemManager::m_glow_color;
 ItemManager *               ItemManager::m_item_manager = NULL;
 
+/** Size of a cell of the spatial hash of items. */
+static const float ITEM_CELL_SIZE = 4.0f;
+
 
 //-----------------------------------------------------------------------------
 /** Creates one instance of the item manager. */
@@ -199,6 +202,19 @@ ItemManager::~ItemManager()
     m_all_items.clear();
 }   // ~ItemManager
 
+//-----------------------------------------------------------------------------
+/** Returns the key in the spatial hash of items for the cell that contains
+ *  the given position, or for a cell next to it.
+ *  \param xyz The position.
+ *  \param dx, dz Offset (in cells) to the cell that contains xyz.
+ */
+uint64_t ItemManager::getCellKey(const Vec3 &xyz, int dx, int dz)
+{
+    const int32_t x = (int32_t)floorf(xyz.getX()/ITEM_CELL_SIZE) + dx;
+    const int32_t z = (int32_t)floorf(xyz.getZ()/ITEM_CELL_SIZE) + dz;
+    return ((uint64_t)(uint32_t)x << 32) | (uint64_t)(uint32_t)z;
+}   // getCellKey
+
 //-----------------------------------------------------------------------------
 /** Inserts the new item into the items management data structures, if possible
  *  reusing an existing, unused entry (e.g. due to a removed bubble gum). Then
@@ -219,6 +235,11 @@ void ItemManager::insertItem(Item *item)
         m_all_items.push_back(item);
     item->setItemId(index);
 
+    if(item->getHitDistance2() > ITEM_CELL_SIZE*ITEM_CELL_SIZE)
+        m_large_items.push_back(item);
+    else
+        m_item_cells[getCellKey(item->getXYZ())].push_back(item);
+
     // Now insert into the appropriate quad list, if there is a quad list
     // (i.e. race mode has a quad graph).
     if(m_items_in_quads)
@@ -304,22 +325,37 @@ void ItemManager::collectedItem(Item *item, AbstractKart *kart, int add_info)
  */
 void  ItemManager::checkItemHit(AbstractKart* kart)
 {
-    // We could use m_items_in_quads to to check for item hits: take the quad
-    // of the graph node of the kart, and only check items in that quad. But
-    // then we also need to check for any adjacent quads (since an item just
-    // on the order of one quad might get hit from an adjacent quad). Then
-    // it is possible that a quad is that short that we need to test adjacent
-    // of adjacent quads. And check for items outside of the track.
-    // Since at this stace item detection is by far not a bottle neck,
-    // the original, simple and stable algorithm is left in place.
+    // Only items in the cell of the kart and the surrounding cells can be
+    // hit, since all other items are at least one cell size away.
+    const Vec3 &xyz = kart->getXYZ();
+    m_close_items.clear();
+    for(int dx=-1; dx<=1; dx++)
+    {
+        for(int dz=-1; dz<=1; dz++)
+        {
+            std::unordered_map<uint64_t, AllItemTypes>::const_iterator cell =
+                m_item_cells.find(getCellKey(xyz, dx, dz));
+            if(cell!=m_item_cells.end())
+                m_close_items.insert(m_close_items.end(),
+                                     cell->second.begin(), cell->second.end());
+        }
+    }
+    m_close_items.insert(m_close_items.end(), m_large_items.begin(),
+                         m_large_items.end());
 
-    for(AllItemTypes::iterator i =m_all_items.begin();
-        i!=m_all_items.end();  i++)
+    // Test the items in the same order as in m_all_items, so that the
+    // result is identical to testing all items.
+    std::sort(m_close_items.begin(), m_close_items.end(),
+              [](const Item *a, const Item *b)
+              { return a->getItemId() < b->getItemId(); });
+
+    for(AllItemTypes::iterator i =m_close_items.begin();
+        i!=m_close_items.end();  i++)
     {
-        if((!*i) || (*i)->wasCollected()) continue;
+        if((*i)->wasCollected()) continue;
         // To allow inlining and avoid including kart.hpp in item.hpp,
         // we pass the kart and the position separately.
-        if((*i)->hitKart(kart->getXYZ(), kart))
+        if((*i)->hitKart(xyz, kart))
         {
             // if we're not playing online, pick the item.
             if (!RaceEventManager::getInstance()->isRunning())
@@ -333,7 +369,7 @@ void  ItemManager::checkItemHit(AbstractKart* kart)
                 RaceEventManager::getInstance()->collectedItem(*i, kart);
             }
         }   // if hit
-    }   // for m_all_items
+    }   // for m_close_items
 }   // checkItemHit
 
 //-----------------------------------------------------------------------------
@@ -437,6 +473,22 @@ void ItemManager::deleteItem(Item *item)
         items.erase(it);
     }   // if m_items_in_quads
 
+    if(item->getHitDistance2() > ITEM_CELL_SIZE*ITEM_CELL_SIZE)
+    {
+        m_large_items.erase(std::find(m_large_items.begin(),
+                                      m_large_items.end(), item));
+    }
+    else
+    {
+        const uint64_t key = getCellKey(item->getXYZ());
+        AllItemTypes &items = m_item_cells[key];
+        AllItemTypes::iterator it = std::find(items.begin(), items.end(),item);
+        assert(it!=items.end());
+        items.erase(it);
+        if(items.empty())
+            m_item_cells.erase(key);
+    }
+
     int index = item->getItemId();
     m_all_items[index] = NULL;
     delete item;
@@ -24,12 +24,14 @@
 #include "items/item.hpp"
 #include "utils/aligned_array.hpp"
 #include "utils/no_copy.hpp"
+#include "utils/types.hpp"
 
 #include <SColor.h>
 
 #include <assert.h>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class Kart;
@@ -85,6 +87,20 @@ private:
      *  field is undefined if no QuadGraph exist, e.g. in battle mode. */
     std::vector< AllItemTypes > *m_items_in_quads;
 
+    /** A spatial hash of all items, used in checkItemHit to only test the
+     *  items close to a kart. The key is computed from the x/z index of the
+     *  cell an item is in (see getCellKey). Items are only added and
+     *  removed in insertItem and deleteItem, since they never move. */
+    std::unordered_map<uint64_t, AllItemTypes> m_item_cells;
+
+    /** Items whose hit distance is larger than the cell size. These are
+     *  always tested. */
+    AllItemTypes m_large_items;
+
+    /** Temporary list of the items close to a kart, declared here to
+     *  avoid memory allocations in checkItemHit. */
+    AllItemTypes m_close_items;
+
     /** What item this item is switched to. */
     std::vector<Item::ItemType> m_switch_to;
 
@@ -94,6 +110,7 @@ private:
 
     void  insertItem(Item *item);
     void  deleteItem(Item *item);
+    static uint64_t getCellKey(const Vec3 &xyz, int dx=0, int dz=0);
 
     // Make those private so only create/destroy functions can call them.
                    ItemManager();
@@ -27,6 +27,8 @@
 #include "items/powerup.hpp"
 #include "items/rubber_ball.hpp"
 #include "karts/abstract_kart.hpp"
+#include "modes/proximity_grid.hpp"
+#include "modes/world.hpp"
 
 ProjectileManager *projectile_manager=0;
 
@@ -131,6 +133,9 @@ Flyable *ProjectileManager::newProjectile(AbstractKart *kart,
         default:              return NULL;
     }
     m_active_projectiles.push_back(f);
+    // Make the projectile visible to the AI immediately.
+    if(World::getWorld() && World::getWorld()->getProximityGrid())
+        World::getWorld()->getProximityGrid()->addProjectile(f->getXYZ());
     return f;
 }   // newProjectile
 
@@ -143,13 +148,19 @@ Flyable *ProjectileManager::newProjectile(AbstractKart *kart,
 bool ProjectileManager::projectileIsClose(const AbstractKart * const kart,
                                          float radius)
 {
-    float r2 = radius*radius;
+    return World::getWorld()->getProximityGrid()
+                            ->isProjectileClose(kart->getXYZ(), radius);
+}   // projectileIsClose
 
-    for(Projectiles::iterator i  = m_active_projectiles.begin();
-                              i != m_active_projectiles.end();   i++)
+// -----------------------------------------------------------------------------
+/** Adds all active projectiles to the proximity grid.
+ *  \param grid The grid to add the projectiles to.
+ */
+void ProjectileManager::addToProximityGrid(ProximityGrid *grid) const
+{
+    for(Projectiles::const_iterator i  = m_active_projectiles.begin();
+                                    i != m_active_projectiles.end();   i++)
     {
-        float dist2 = (*i)->getXYZ().distance2(kart->getXYZ());
-        if(dist2<r2) return true;
+        grid->addProjectile((*i)->getXYZ());
     }
-    return false;
-}   // projectileIsClose
+}   // addToProximityGrid
@@ -32,6 +32,7 @@ namespace irr
 class AbstractKart;
 class Flyable;
 class HitEffect;
+class ProximityGrid;
 class Track;
 class Vec3;
 
@@ -65,6 +66,7 @@ public:
     void             removeTextures   ();
     bool             projectileIsClose(const AbstractKart * const kart,
                                        float radius);
+    void             addToProximityGrid(ProximityGrid *grid) const;
     // ------------------------------------------------------------------------
     /** Adds a special hit effect to be shown.
      *  \param hit_effect The hit effect to be added. */
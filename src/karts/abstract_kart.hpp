@@ -439,6 +439,10 @@ public:
     // ------------------------------------------------------------------------
     virtual void crashed(const Material *m, const Vec3 &normal) = 0;
     // ------------------------------------------------------------------------
+    /** Does the part of the kart update that only modifies this kart. It is
+     *  called for all karts in parallel before the sequential update(). */
+    virtual void updateParallel(float dt) = 0;
+    // ------------------------------------------------------------------------
     /** Returns the height of the terrain. we're currently above */
     virtual float getHoT() const = 0;
     // ------------------------------------------------------------------------
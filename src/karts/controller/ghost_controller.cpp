@@ -20,10 +20,17 @@
 #include "karts/controller/ghost_controller.hpp"
 #include "karts/controller/kart_control.hpp"
 #include "modes/world.hpp"
+#include "race/race_manager.hpp"
+#include "replay/replay_play.hpp"
+
+#include <algorithm>
+#include <math.h>
 
 GhostController::GhostController(AbstractKart *kart)
                 : Controller(kart)
 {
+    for (unsigned int i = 0; i < PA_COUNT; i++)
+        m_action_pressed[i] = false;
 }   // GhostController
 
 //-----------------------------------------------------------------------------
@@ -36,16 +43,13 @@ void GhostController::reset()
 //-----------------------------------------------------------------------------
 void GhostController::update(float dt)
 {
-    m_current_time = World::getWorld()->getTime();
-    // Find (if necessary) the next index to use
-    if (m_current_time != 0.0f)
-    {
-        while (m_current_index + 1 < m_all_times.size() &&
-               m_current_time >= m_all_times[m_current_index + 1])
-        {
-            m_current_index++;
-        }
-    }
+    // When watching a replay the replay time can differ from the world
+    // time (seeking, fast forward, reverse), otherwise the ghost karts
+    // must stay in sync with the race.
+    m_current_time = race_manager->isWatchingReplay()
+                   ? ReplayPlay::get()->getReplayTime()
+                   : World::getWorld()->getTime();
+    findReplayIndex();
 
     // Watching replay use only
     Camera *camera = Camera::getActiveCamera();
@@ -64,6 +68,40 @@ void GhostController::update(float dt)
 
 }   // update
 
+//-----------------------------------------------------------------------------
+/** Sets m_current_index to the last event whose time is not larger than
+ *  the current time. During normal playback this is the current or the
+ *  next event, which is tested first; otherwise (after seeking, or when
+ *  playing backwards) a binary search is used.
+ */
+void GhostController::findReplayIndex()
+{
+    const unsigned int n = (unsigned int)m_all_times.size();
+    if (n < 2 || m_current_time < m_all_times[1])
+    {
+        m_current_index = 0;
+        return;
+    }
+
+    if (m_current_index + 1 < n &&
+        m_current_time >= m_all_times[m_current_index])
+    {
+        if (m_current_time < m_all_times[m_current_index + 1])
+            return;
+        if (m_current_index + 2 >= n ||
+            m_current_time < m_all_times[m_current_index + 2])
+        {
+            m_current_index++;
+            return;
+        }
+    }
+
+    m_current_index = (unsigned int)(std::upper_bound(m_all_times.begin(),
+                                                      m_all_times.end(),
+                                                      m_current_time)
+                                     - m_all_times.begin()) - 1;
+}   // findReplayIndex
+
 //-----------------------------------------------------------------------------
 void GhostController::addReplayTime(float time)
 {
@@ -77,9 +115,62 @@ void GhostController::addReplayTime(float time)
 }   // addReplayTime
 
 //-----------------------------------------------------------------------------
+/** Handles the input when watching a replay: look back, change the replay
+ *  speed (accelerate and brake step through the speeds, fire resets to
+ *  normal speed) and seek (steering skips backwards or forwards).
+ */
 void GhostController::action(PlayerAction action, int value)
 {
     // Watching replay use only
     if (action == PA_LOOK_BACK)
         m_controls->m_look_back = (value!=0);
+
+    // All other actions are only triggered once when pressing a key or
+    // moving an analog axis beyond half of its range. An axis must be
+    // moved back below a quarter of its range before it triggers again.
+    bool &pressed = m_action_pressed[action];
+    if (pressed)
+    {
+        if (value < Input::MAX_VALUE/4)
+            pressed = false;
+        return;
+    }
+    if (value < Input::MAX_VALUE/2 || !race_manager->isWatchingReplay())
+        return;
+    pressed = true;
+
+    static const float speeds[] = { -8.0f, -4.0f, -2.0f, -1.0f, -0.5f, 0.0f,
+                                     0.5f,  1.0f,  2.0f,  4.0f,  8.0f };
+    const int num_speeds = sizeof(speeds)/sizeof(speeds[0]);
+    const float seek_time = 5.0f;
+
+    ReplayPlay *replay = ReplayPlay::get();
+    int current = 0;
+    for (int i = 1; i < num_speeds; i++)
+    {
+        if (fabsf(speeds[i] - replay->getReplaySpeed()) <
+            fabsf(speeds[current] - replay->getReplaySpeed()))
+            current = i;
+    }
+
+    switch (action)
+    {
+    case PA_ACCEL:
+        replay->setReplaySpeed(speeds[std::min(current + 1, num_speeds - 1)]);
+        break;
+    case PA_BRAKE:
+        replay->setReplaySpeed(speeds[std::max(current - 1, 0)]);
+        break;
+    case PA_FIRE:
+        replay->setReplaySpeed(1.0f);
+        break;
+    case PA_STEER_LEFT:
+        replay->seek(replay->getReplayTime() - seek_time);
+        break;
+    case PA_STEER_RIGHT:
+        replay->seek(replay->getReplayTime() + seek_time);
+        break;
+    default:
+        break;
+    }
 }   // action
@@ -40,6 +40,13 @@ private:
     /** The list of the times at which the events of kart were reached. */
     std::vector<float> m_all_times;
 
+    /** True while an action is pressed when watching a replay, so that
+     *  analog input (which sends many events) triggers an action only once
+     *  per press. */
+    bool m_action_pressed[PA_COUNT];
+
+    void         findReplayIndex();
+
 public:
              GhostController(AbstractKart *kart);
     virtual ~GhostController() {};
@@ -70,6 +77,10 @@ public:
             (m_all_times[m_current_index + 1] - m_all_times[m_current_index]));
     }
     // ------------------------------------------------------------------------
+    /** Returns the time of the last event of this kart. */
+    float        getReplayEndTime() const
+                { return m_all_times.empty() ? 0.0f : m_all_times.back(); }
+    // ------------------------------------------------------------------------
     unsigned int getCurrentReplayIndex() const
                                                    { return m_current_index; }
     // ------------------------------------------------------------------------
@@ -39,9 +39,11 @@
 #include "karts/rescue_animation.hpp"
 #include "karts/skidding.hpp"
 #include "modes/linear_world.hpp"
-#include "modes/profile_world.hpp"
+#include "modes/proximity_grid.hpp"
+#include "modes/race_snapshot.hpp"
 #include "race/race_manager.hpp"
 #include "tracks/quad_graph.hpp"
+#include "tracks/racing_line.hpp"
 #include "tracks/track.hpp"
 #include "utils/constants.hpp"
 #include "utils/log.hpp"
@@ -52,12 +54,15 @@
    using namespace irr;
 #endif
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include <ctime>
 #include <cstdio>
 #include <iostream>
 
+bool SkiddingAI::m_use_racing_line = false;
+
 SkiddingAI::SkiddingAI(AbstractKart *kart)
                    : AIBaseLapController(kart)
 {
@@ -66,7 +71,8 @@ SkiddingAI::SkiddingAI(AbstractKart *kart)
     // for the final race challenge against nolok.
     m_superpower = race_manager->getAISuperPower();
 
-    m_point_selection_algorithm = PSA_DEFAULT;
+    m_point_selection_algorithm = m_use_racing_line ? PSA_RACING_LINE
+                                                    : PSA_DEFAULT;
     setControllerName("Skidding");
 
     // Use this define in order to compare the different algorithms that
@@ -78,9 +84,10 @@ SkiddingAI::SkiddingAI(AbstractKart *kart)
                                 ? PSA_DEFAULT : PSA_FIXED;
     switch(m_point_selection_algorithm)
     {
-    case PSA_FIXED   : name = "Fixed";   break;
-    case PSA_NEW     : name = "New";     break;
-    case PSA_DEFAULT : name = "Default"; break;
+    case PSA_FIXED       : name = "Fixed";       break;
+    case PSA_NEW         : name = "New";         break;
+    case PSA_DEFAULT     : name = "Default";     break;
+    case PSA_RACING_LINE : name = "RacingLine";  break;
     }
     setControllerName(name);
 #endif
@@ -429,8 +436,14 @@ void SkiddingAI::handleBraking()
     if(m_current_track_direction==GraphNode::DIR_LEFT ||
        m_current_track_direction==GraphNode::DIR_RIGHT   )
     {
-        float max_turn_speed =
-            m_kart->getSpeedForTurnRadius(m_current_curve_radius);
+        float radius = m_current_curve_radius;
+        // The racing line knows how tight the curve ahead really is.
+        if(m_point_selection_algorithm==PSA_RACING_LINE)
+        {
+            const RacingLine *line = QuadGraph::get()->getRacingLine();
+            radius = std::min(radius, line->getCurveRadiusAhead(m_track_node));
+        }
+        float max_turn_speed = m_kart->getSpeedForTurnRadius(radius);
 
         if(m_kart->getSpeed() > 1.5f*max_turn_speed  &&
             m_kart->getSpeed()>MIN_SPEED             &&
@@ -472,8 +485,9 @@ void SkiddingAI::handleSteering(float dt)
      *finite state machine.
      */
     //Reaction to being outside of the road
+    const RaceSnapshot *snapshot = m_world->getRaceSnapshot();
     float side_dist =
-        m_world->getDistanceToCenterForKart( m_kart->getWorldKartId() );
+        snapshot->getKart(m_kart->getWorldKartId()).m_distance_to_center;
 
     if( fabsf(side_dist)  >
        0.5f* QuadGraph::get()->getNode(m_track_node).getPathWidth()+0.5f )
@@ -505,8 +519,8 @@ void SkiddingAI::handleSteering(float dt)
         }
         else
         {
-            if(m_world->getDistanceToCenterForKart( m_kart->getWorldKartId() ) >
-               m_world->getDistanceToCenterForKart( m_crashes.m_kart ))
+            if(side_dist >
+               snapshot->getKart(m_crashes.m_kart).m_distance_to_center)
             {
                 steer_angle = steerToAngle(next, M_PI*0.5f );
                 m_start_kart_crash_direction = 1;
@@ -540,6 +554,10 @@ void SkiddingAI::handleSteering(float dt)
                          break;
         case PSA_DEFAULT:findNonCrashingPoint(&aim_point, &last_node);
                          break;
+        case PSA_RACING_LINE:
+                         findNonCrashingPointRacingLine(&aim_point,
+                                                        &last_node);
+                         break;
         }
 #ifdef AI_DEBUG
         m_debug_sphere[m_point_selection_algorithm]->setPosition(aim_point.toIrrVector());
@@ -1439,60 +1457,48 @@ void SkiddingAI::handleItems(const float dt)
  */
 void SkiddingAI::computeNearestKarts()
 {
-    int my_position    = m_kart->getPosition();
+    const RaceSnapshot *snapshot = m_world->getRaceSnapshot();
+    const RaceSnapshot::KartState &me =
+        snapshot->getKart(m_kart->getWorldKartId());
+    int my_position    = me.m_position;
 
     // If we are not the first, there must be another kart ahead of this kart
+    m_kart_ahead = NULL;
     if( my_position>1 )
     {
-        m_kart_ahead = m_world->getKartAtPosition(my_position-1);
-        if(m_kart_ahead &&
-              ( m_kart_ahead->isEliminated() || m_kart_ahead->hasFinishedRace()))
-              m_kart_ahead = NULL;
+        int id = snapshot->getKartIdAtPosition(my_position-1);
+        if(id>=0 && snapshot->getKart(id).isRacing())
+            m_kart_ahead = m_world->getKart(id);
     }
-    else
-        m_kart_ahead = NULL;
 
+    m_kart_behind = NULL;
     if( my_position<(int)m_world->getCurrentNumKarts())
     {
-        m_kart_behind = m_world->getKartAtPosition(my_position+1);
-        if(m_kart_behind &&
-            (m_kart_behind->isEliminated() || m_kart_behind->hasFinishedRace()))
-            m_kart_behind = NULL;
+        int id = snapshot->getKartIdAtPosition(my_position+1);
+        if(id>=0 && snapshot->getKart(id).isRacing())
+            m_kart_behind = m_world->getKart(id);
     }
-    else
-        m_kart_behind = NULL;
 
     m_distance_ahead = m_distance_behind = 9999999.9f;
-    float my_dist = m_world->getOverallDistance(m_kart->getWorldKartId());
+    float my_dist = me.m_overall_distance;
     if(m_kart_ahead)
     {
         m_distance_ahead =
-            m_world->getOverallDistance(m_kart_ahead->getWorldKartId())
+            snapshot->getKart(m_kart_ahead->getWorldKartId()).m_overall_distance
             -my_dist;
     }
     if(m_kart_behind)
     {
         m_distance_behind = my_dist
-            -m_world->getOverallDistance(m_kart_behind->getWorldKartId());
+            -snapshot->getKart(m_kart_behind->getWorldKartId()).m_overall_distance;
     }
 
     // Compute distance to nearest player kart
-    float max_overall_distance = 0.0f;
-    unsigned int n = ProfileWorld::isProfileMode()
-                   ? 0 : race_manager->getNumPlayers();
-    for(unsigned int i=0; i<n; i++)
-    {
-        unsigned int kart_id =
-            m_world->getPlayerKart(i)->getWorldKartId();
-        if(m_world->getOverallDistance(kart_id)>max_overall_distance)
-            max_overall_distance = m_world->getOverallDistance(kart_id);
-    }
+    float max_overall_distance = snapshot->getMaxPlayerDistance();
     if(max_overall_distance==0.0f)
         max_overall_distance = 999999.9f;   // force best driving
     // Now convert 'maximum overall distance' to distance to player.
-    m_distance_to_player =
-                m_world->getOverallDistance(m_kart->getWorldKartId())
-                - max_overall_distance;
+    m_distance_to_player = my_dist - max_overall_distance;
 }   // computeNearestKarts
 
 //-----------------------------------------------------------------------------
@@ -1729,8 +1735,6 @@ void SkiddingAI::checkCrashes(const Vec3& pos )
         m_crashes.m_kart = slip->getSlipstreamTarget()->getWorldKartId();
     }
 
-    const size_t NUM_KARTS = m_world->getNumKarts();
-
     //Protection against having vel_normal with nan values
     const Vec3 &VEL = m_kart->getVelocity();
     Vec3 vel_normal(VEL.getX(), 0.0, VEL.getZ());
@@ -1750,6 +1754,12 @@ void SkiddingAI::checkCrashes(const Vec3& pos )
                   steps, m_kart_length, m_kart->getVelocityLC().getZ());
         steps=1000;
     }
+
+    if(m_crashes.m_kart == -1)
+        findCrashCandidates(pos, vel_normal*speed, dt, steps);
+    else
+        m_crash_candidates.clear();
+
     for(int i = 1; steps > i; ++i)
     {
         Vec3 step_coord = pos + vel_normal* m_kart_length * float(i);
@@ -1759,15 +1769,10 @@ void SkiddingAI::checkCrashes(const Vec3& pos )
          */
         if( m_crashes.m_kart == -1 )
         {
-            for( unsigned int j = 0; j < NUM_KARTS; ++j )
+            for(unsigned int k=0; k<m_crash_candidates.size(); k++)
             {
-                const AbstractKart* kart = m_world->getKart(j);
-                // Ignore eliminated karts
-                if(kart==m_kart||kart->isEliminated()||kart->isGhostKart()) continue;
+                const unsigned int j = m_crash_candidates[k];
                 const AbstractKart *other_kart = m_world->getKart(j);
-                // Ignore karts ahead that are faster than this kart.
-                if(m_kart->getVelocityLC().getZ() < other_kart->getVelocityLC().getZ())
-                    continue;
                 Vec3 other_kart_xyz = other_kart->getXYZ()
                                     + other_kart->getVelocity()*(i*dt);
                 float kart_distance = (step_coord - other_kart_xyz).length_2d();
@@ -1791,6 +1796,66 @@ void SkiddingAI::checkCrashes(const Vec3& pos )
     }
 }   // checkCrashes
 
+//-----------------------------------------------------------------------------
+/** Determines the karts this kart could crash into while driving along the
+ *  path tested in checkCrashes(), and stores their world ids (sorted) in
+ *  m_crash_candidates. First the proximity grid is used to find all karts
+ *  close enough to the path, then for each kart the closest distance
+ *  between both karts (assuming both keep their velocity) during the time
+ *  tested is computed. Karts that never get close enough are removed, so
+ *  checkCrashes() finds the same kart as when testing all karts.
+ *  \param pos Start position of this kart.
+ *  \param velocity The velocity of this kart in the x/z plane.
+ *  \param dt Time between two tested points.
+ *  \param steps Number of tested points plus one.
+ */
+void SkiddingAI::findCrashCandidates(const Vec3 &pos, const Vec3 &velocity,
+                                     float dt, int steps)
+{
+    const float t0 = dt;
+    const float t1 = dt*(steps-1);
+    const Vec3 start = pos + velocity*t0;
+    const Vec3 end   = pos + velocity*t1;
+    const ProximityGrid *grid = m_world->getProximityGrid();
+    const float margin = m_kart_length + grid->getMaxKartSpeed()*t1 + 1.0f;
+    const Vec3 min(std::min(start.getX(), end.getX()) - margin, 0,
+                   std::min(start.getZ(), end.getZ()) - margin);
+    const Vec3 max(std::max(start.getX(), end.getX()) + margin, 0,
+                   std::max(start.getZ(), end.getZ()) + margin);
+    grid->findKarts(min, max, &m_crash_candidates);
+
+    unsigned int n = 0;
+    for(unsigned int k=0; k<m_crash_candidates.size(); k++)
+    {
+        const unsigned int j = m_crash_candidates[k];
+        const AbstractKart *other_kart = m_world->getKart(j);
+        // Ignore eliminated karts
+        if(other_kart==m_kart || other_kart->isEliminated() ||
+           other_kart->isGhostKart()                            )
+            continue;
+        // Ignore karts ahead that are faster than this kart.
+        if(m_kart->getVelocityLC().getZ() < other_kart->getVelocityLC().getZ())
+            continue;
+
+        // Closest distance (in 2d) between the two karts in [t0, t1]. A
+        // small tolerance makes sure that rounding errors can't remove a
+        // kart that checkCrashes() would detect.
+        const Vec3 &other_velocity = other_kart->getVelocity();
+        const float dx = pos.getX() - other_kart->getXYZ().getX();
+        const float dz = pos.getZ() - other_kart->getXYZ().getZ();
+        const float vx = velocity.getX() - other_velocity.getX();
+        const float vz = velocity.getZ() - other_velocity.getZ();
+        const float v2 = vx*vx + vz*vz;
+        float t = v2>0 ? -(dx*vx + dz*vz)/v2 : t0;
+        t = std::max(t0, std::min(t, t1));
+        const float cx = dx + vx*t, cz = dz + vz*t;
+        const float max_distance = m_kart_length + 0.1f;
+        if(cx*cx + cz*cz < max_distance*max_distance)
+            m_crash_candidates[n++] = j;
+    }   // for k
+    m_crash_candidates.resize(n);
+}   // findCrashCandidates
+
 //-----------------------------------------------------------------------------
 /** This is a new version of findNonCrashingPoint, which at this stage is
  *  slightly inferior (though faster and more correct) than the original
@@ -2096,6 +2161,43 @@ void SkiddingAI::findNonCrashingPointFixed(Vec3 *aim_position, int *last_node)
     *aim_position = QuadGraph::get()->getQuadOfNode(*last_node).getCenter();
 }   // findNonCrashingPoint
 
+//-----------------------------------------------------------------------------
+/** Uses the precomputed racing line to find the point to aim at: the aim
+ *  point is the point on the racing line that can be reached in a straight
+ *  line from the racing line at the current node, so no quads need to be
+ *  tested. This is only valid if the kart is close to the racing line and
+ *  takes the same path as the racing line, otherwise findNonCrashingPoint()
+ *  is used.
+ *  \param aim_position On exit contains the point the AI should aim at.
+ *  \param last_node On exit contains the graph node the AI is aiming at.
+ */
+void SkiddingAI::findNonCrashingPointRacingLine(Vec3 *aim_position,
+                                                int *last_node)
+{
+    const RacingLine *line = QuadGraph::get()->getRacingLine();
+    const GraphNode  &node = QuadGraph::get()->getNode(m_track_node);
+    const float deviation  = (m_kart->getXYZ()-line->getPoint(m_track_node))
+                             .dot(node.getRightUnitVector());
+    if(fabsf(deviation) < m_kart_width)
+    {
+        const int aim_node = line->getAimNode(m_track_node);
+        int n = m_track_node;
+        for(unsigned int i=0; i<QuadGraph::get()->getNumNodes(); i++)
+        {
+            if(n==aim_node ||
+               m_next_node_index[n]!=(int)line->getNext(n)) break;
+            n = m_next_node_index[n];
+        }
+        if(n==aim_node)
+        {
+            *last_node    = aim_node;
+            *aim_position = line->getPoint(aim_node);
+            return;
+        }
+    }
+    findNonCrashingPoint(aim_position, last_node);
+}   // findNonCrashingPointRacingLine
+
 //-----------------------------------------------------------------------------
 /** Determines the direction of the track ahead of the kart: 0 indicates
  *  straight, +1 right turn, -1 left turn.
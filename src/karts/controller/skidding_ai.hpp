@@ -214,12 +214,22 @@ private:
      *  3. findNonCrashingPointNew() A newly designed algorithm, which is
      *     faster than the standard one, but does not give as good results
      *     as the 'buggy' one.
+     *  4. findNonCrashingPointRacingLine() which looks up the aim point
+     *     on the precomputed racing line (see --ai-racing-line).
      *
      *  So far the default one has by far the best performance, even though
      *  it has bugs. */
-    enum {PSA_DEFAULT, PSA_FIXED, PSA_NEW}
+    enum {PSA_DEFAULT, PSA_FIXED, PSA_NEW, PSA_RACING_LINE}
           m_point_selection_algorithm;
 
+    /** True if the AI should use the precomputed racing line. */
+    static bool m_use_racing_line;
+
+    /** The world ids of the karts this kart could crash into, as
+     *  determined by findCrashCandidates(). Kept as member to avoid
+     *  frequent memory allocations. */
+    std::vector<unsigned int> m_crash_candidates;
+
 #ifdef AI_DEBUG
     /** For skidding debugging: shows the estimated turn shape. */
     ShowCurve **m_curve;
@@ -260,9 +270,12 @@ private:
                         std::vector<const Item *> *items_to_collect);
 
     void  checkCrashes(const Vec3& pos);
+    void  findCrashCandidates(const Vec3 &pos, const Vec3 &velocity,
+                              float dt, int steps);
     void  findNonCrashingPointFixed(Vec3 *result, int *last_node);
     void  findNonCrashingPointNew(Vec3 *result, int *last_node);
     void  findNonCrashingPoint(Vec3 *result, int *last_node);
+    void  findNonCrashingPointRacingLine(Vec3 *result, int *last_node);
 
     void  determineTrackDirection();
     void  determineTurnRadius(const Vec3 &start,
@@ -283,6 +296,9 @@ public:
     virtual void update      (float delta) ;
     virtual void reset       ();
     virtual const irr::core::stringw& getNamePostfix() const;
+    // ------------------------------------------------------------------------
+    /** Makes all AIs use the precomputed racing line. */
+    static void enableRacingLine() { m_use_racing_line = true; }
 };
 
 #endif
@@ -17,10 +17,12 @@
 //  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "karts/ghost_kart.hpp"
+#include "graphics/camera.hpp"
 #include "karts/controller/ghost_controller.hpp"
 #include "karts/kart_gfx.hpp"
 #include "karts/kart_model.hpp"
 #include "modes/world.hpp"
+#include "replay/ghost_poses.hpp"
 
 #include "LinearMath/btQuaternion.h"
 
@@ -30,14 +32,23 @@ GhostKart::GhostKart(const std::string& ident, unsigned int world_kart_id,
                  position, btTransform(btQuaternion(0, 0, 0, 1)),
                  PLAYER_DIFFICULTY_NORMAL, video::ERT_TRANSPARENT)
 {
+    m_gfx_disabled  = false;
+    m_pose_xyz      = Vec3(0, 0, 0);
+    m_pose_rotation = btQuaternion(0, 0, 0, 1);
 }   // GhostKart
 
 // ----------------------------------------------------------------------------
 void GhostKart::reset()
 {
     m_node->setVisible(true);
+    m_gfx_disabled = false;
     Kart::reset();
     // This will set the correct start position
+    GhostPoses pose;
+    pose.resize(1);
+    updateController(0, &pose, 0);
+    pose.interpolate();
+    setPose(pose.getXYZ(0), pose.getRotation(0));
     update(0);
 }   // reset
 
@@ -50,7 +61,8 @@ void GhostKart::addReplayEvent(float time,
     GhostController* gc = dynamic_cast<GhostController*>(getController());
     gc->addReplayTime(time);
 
-    m_all_transform.push_back(trans);
+    m_all_xyz.push_back(trans.getOrigin());
+    m_all_rotation.push_back(trans.getRotation());
     m_all_physic_info.push_back(pi);
     m_all_replay_events.push_back(kre);
 
@@ -67,7 +79,35 @@ void GhostKart::addReplayEvent(float time,
 }   // addReplayEvent
 
 // ----------------------------------------------------------------------------
-/** Updates the current event of the ghost kart using interpolation
+/** Updates the controller of this ghost kart, and sets the two replay
+ *  frames to interpolate between for the current time.
+ *  \param dt Time step size.
+ *  \param poses The poses of all ghost karts.
+ *  \param index The index of this kart in poses.
+ */
+void GhostKart::updateController(float dt, GhostPoses *poses,
+                                 unsigned int index)
+{
+    GhostController* gc = dynamic_cast<GhostController*>(getController());
+    if (gc != NULL)
+        gc->update(dt);
+    if (gc == NULL || gc->isReplayEnd())
+    {
+        // The kart is hidden in update(), the pose is not used.
+        poses->setFrames(index, m_pose_xyz, m_pose_rotation, m_pose_xyz,
+                         m_pose_rotation, 0.0f);
+        return;
+    }
+    const unsigned int idx = gc->getCurrentReplayIndex();
+    assert(idx + 1 < m_all_xyz.size());
+    poses->setFrames(index, m_all_xyz[idx], m_all_rotation[idx],
+                     m_all_xyz[idx + 1], m_all_rotation[idx + 1],
+                     gc->getReplayDelta());
+}   // updateController
+
+// ----------------------------------------------------------------------------
+/** Updates the current event of the ghost kart. The controller was already
+ *  updated and the pose interpolated by ReplayPlay::updateGhostPoses().
  *  \param dt Time step size.
  */
 void GhostKart::update(float dt)
@@ -75,7 +115,6 @@ void GhostKart::update(float dt)
     GhostController* gc = dynamic_cast<GhostController*>(getController());
     if (gc == NULL) return;
 
-    gc->update(dt);
     if (gc->isReplayEnd())
     {
         m_node->setVisible(false);
@@ -96,16 +135,17 @@ void GhostKart::update(float dt)
             m_node->setVisible(true);
         }
     }
+    else
+    {
+        // The kart might have been hidden at the end of the replay before
+        // rewinding.
+        m_node->setVisible(true);
+    }
 
-    const float rd         = gc->getReplayDelta();
-    assert(idx < m_all_transform.size());
-
-    setXYZ((1- rd)*m_all_transform[idx    ].getOrigin()
-           +  rd  *m_all_transform[idx + 1].getOrigin() );
+    assert(idx < m_all_xyz.size());
 
-    const btQuaternion q = m_all_transform[idx].getRotation()
-        .slerp(m_all_transform[idx + 1].getRotation(), rd);
-    setRotation(q);
+    setXYZ(m_pose_xyz);
+    setRotation(m_pose_rotation);
 
     Vec3 center_shift(0, 0, 0);
     center_shift.setY(m_graphical_y_offset);
@@ -113,15 +153,32 @@ void GhostKart::update(float dt)
 
     Moveable::updateGraphics(dt, center_shift, btQuaternion(0, 0, 0, 1));
     Moveable::updatePosition();
-    getKartModel()->update(dt, dt*(m_all_physic_info[idx].m_speed),
-        m_all_physic_info[idx].m_steer, m_all_physic_info[idx].m_speed,
-        /*lean*/0.0f, idx);
 
-    getKartGFX()->setGFXFromReplay(m_all_replay_events[idx].m_nitro_usage,
-        m_all_replay_events[idx].m_zipper_usage,
-        m_all_replay_events[idx].m_skidding_state,
-        m_all_replay_events[idx].m_red_skidding);
-    getKartGFX()->update(dt);
+    // With many ghosts the wheel animation and particle effects are the
+    // most expensive part of the update, and they can't be seen anyway if
+    // the ghost is far away from all cameras.
+    if (isFarFromCameras())
+    {
+        if (!m_gfx_disabled)
+        {
+            getKartGFX()->reset();
+            getKartGFX()->setGFXInvisible();
+            m_gfx_disabled = true;
+        }
+    }
+    else
+    {
+        m_gfx_disabled = false;
+        getKartModel()->update(dt, dt*(m_all_physic_info[idx].m_speed),
+            m_all_physic_info[idx].m_steer, m_all_physic_info[idx].m_speed,
+            /*lean*/0.0f, idx);
+
+        getKartGFX()->setGFXFromReplay(m_all_replay_events[idx].m_nitro_usage,
+            m_all_replay_events[idx].m_zipper_usage,
+            m_all_replay_events[idx].m_skidding_state,
+            m_all_replay_events[idx].m_red_skidding);
+        getKartGFX()->update(dt);
+    }
 
     Vec3 front(0, 0, getKartLength()*0.5f);
     m_xyz_front = getTrans()(front);
@@ -139,6 +196,27 @@ void GhostKart::update(float dt)
 
 }   // update
 
+// ----------------------------------------------------------------------------
+/** Returns true if this ghost is further away from all cameras than the
+ *  distance up to which particle effects and wheel animations are shown.
+ *  If there are no cameras yet (e.g. when the kart is reset before the race
+ *  starts), false is returned so that nothing gets disabled.
+ */
+bool GhostKart::isFarFromCameras() const
+{
+    if (Camera::getNumCameras() == 0)
+        return false;
+    const float max_distance2 = 50.0f*50.0f;
+    for (unsigned int i = 0; i < Camera::getNumCameras(); i++)
+    {
+        const Vec3 camera_xyz(Camera::getCamera(i)->getCameraSceneNode()
+                                                  ->getAbsolutePosition());
+        if ((camera_xyz - getXYZ()).length2() < max_distance2)
+            return false;
+    }
+    return true;
+}   // isFarFromCameras
+
 // ----------------------------------------------------------------------------
 /** Returns the speed of the kart in meters/second. */
 float GhostKart::getSpeed() const
@@ -22,33 +22,57 @@
 #include "karts/kart.hpp"
 #include "replay/replay_base.hpp"
 
+#include "LinearMath/btQuaternion.h"
 #include "LinearMath/btTransform.h"
+#include "utils/vec3.hpp"
 
 #include <vector>
 
+class GhostPoses;
+
 /** \defgroup karts */
 
 /** A ghost kart. It does not have a phsyics representation. It gets two
  *  transforms from the replay objects at two consecutive time steps,
  *  and will interpolate between those positions depending on the current
- *  time
+ *  time. The interpolation is done for all ghost karts at once by
+ *  ReplayPlay::updateGhostPoses() before the karts are updated.
  */
 class GhostKart : public Kart
 {
 private:
-    /** The transforms to assume at the corresponding time in m_all_times. */
-    std::vector<btTransform>                 m_all_transform;
+    /** The positions and rotations to assume at the corresponding time in
+     *  m_all_times of the ghost controller. They are stored separately
+     *  (instead of as btTransform) so that the interpolation in update()
+     *  does not need to convert a rotation matrix into a quaternion. */
+    std::vector<Vec3>                        m_all_xyz;
+
+    std::vector<btQuaternion>                m_all_rotation;
 
     std::vector<ReplayBase::PhysicInfo>      m_all_physic_info;
 
     std::vector<ReplayBase::KartReplayEvent> m_all_replay_events;
 
+    /** True if the particle effects were disabled because the ghost is far
+     *  away from all cameras. */
+    bool                                     m_gfx_disabled;
+
+    /** The interpolated position and rotation at the current time. */
+    Vec3                                     m_pose_xyz;
+
+    btQuaternion                             m_pose_rotation;
+
+    bool          isFarFromCameras() const;
+
 public:
                   GhostKart(const std::string& ident,
                             unsigned int world_kart_id, int position);
     virtual void  update (float dt);
     virtual void  reset();
     // ------------------------------------------------------------------------
+    /** Ghost karts don't use the terrain, so nothing to prepare. */
+    virtual void  updateParallel(float dt) {};
+    // ------------------------------------------------------------------------
     /** No physics body for ghost kart, so nothing to adjust. */
     virtual void  updateWeight() {};
     // ------------------------------------------------------------------------
@@ -66,6 +90,17 @@ public:
                                  const ReplayBase::PhysicInfo &pi,
                                  const ReplayBase::KartReplayEvent &kre);
     // ------------------------------------------------------------------------
+    void          updateController(float dt, GhostPoses *poses,
+                                   unsigned int index);
+    // ------------------------------------------------------------------------
+    /** Sets the interpolated position and rotation, which are used by the
+     *  next update(). */
+    void          setPose(const Vec3 &xyz, const btQuaternion &rotation)
+    {
+        m_pose_xyz      = xyz;
+        m_pose_rotation = rotation;
+    }   // setPose
+    // ------------------------------------------------------------------------
     /** Returns whether this kart is a ghost (replay) kart. */
     virtual bool  isGhostKart() const                         { return true; }
     // ------------------------------------------------------------------------
@@ -1319,33 +1319,7 @@ void Kart::update(float dt)
     Vec3 front(0, 0, getKartLength()*0.5f);
     m_xyz_front = getTrans()(front);
 
-    // After the physics step was done, the position of the wheels (as stored
-    // in wheelInfo) is actually outdated, since the chassis was moved
-    // according to the force acting from the wheels. So the cnter of the
-    // chassis is not at the center of the wheels anymore, it is somewhat
-    // moved forward (depending on speed and fps). In very extreme cases
-    // (see bug 2246) the center of the chassis can actually be ahead of the
-    // front wheels. So if we do a raycast to detect the terrain from the
-    // current chassis, that raycast might be ahead of the wheels - which
-    // results in incorrect rescues (the wheels are still on the ground,
-    // but the raycast happens ahead of the front wheels and are over
-    // a rescue texture).
-    // To avoid this problem, we do the raycast for terrain detection from
-    // the center of the 4 wheel positions (in world coordinates).
-
-    Vec3 from(0, 0, 0);
-    for (unsigned int i = 0; i < 4; i++)
-        from += m_vehicle->getWheelInfo(i).m_raycastInfo.m_hardPointWS;
-
-    // Add a certain epsilon (0.3) to the height of the kart. This avoids
-    // problems of the ray being cast from under the track (which happened
-    // e.g. on tux tollway when jumping down from the ramp, when the chassis
-    // partly tunnels through the track). While tunneling should not be
-    // happening (since Z velocity is clamped), the epsilon is left in place
-    // just to be on the safe side (it will not hit the chassis itself).
-    from = from/4 + Vec3(0,0.3f,0);
-
-    m_terrain_info->update(getTrans().getBasis(), from);
+    m_terrain_info->update(getTrans().getBasis(), getTerrainRayOrigin());
 
     if(m_body->getBroadphaseHandle())
     {
@@ -1491,6 +1465,53 @@ void Kart::update(float dt)
 
 }   // update
 
+//-----------------------------------------------------------------------------
+/** Does the part of the update that only reads shared data and only modifies
+ *  this kart, so it is called for all karts in parallel (from World::update)
+ *  before the sequential update(). At this stage this is the terrain raycast:
+ *  the result is used in update() if the kart was not moved in between
+ *  (e.g. by a kart animation), otherwise the raycast is done again there.
+ *  AI decisions and slipstream tests depend on the order in which the karts
+ *  are updated, so they are still done in update().
+ *  \param dt Time step size.
+ */
+void Kart::updateParallel(float dt)
+{
+    m_terrain_info->precompute(getPhysicsTrans().getBasis(),
+                               getTerrainRayOrigin());
+}   // updateParallel
+
+//-----------------------------------------------------------------------------
+/** Returns the point from which the terrain raycast is done.
+ *  After the physics step was done, the position of the wheels (as stored
+ *  in wheelInfo) is actually outdated, since the chassis was moved
+ *  according to the force acting from the wheels. So the cnter of the
+ *  chassis is not at the center of the wheels anymore, it is somewhat
+ *  moved forward (depending on speed and fps). In very extreme cases
+ *  (see bug 2246) the center of the chassis can actually be ahead of the
+ *  front wheels. So if we do a raycast to detect the terrain from the
+ *  current chassis, that raycast might be ahead of the wheels - which
+ *  results in incorrect rescues (the wheels are still on the ground,
+ *  but the raycast happens ahead of the front wheels and are over
+ *  a rescue texture).
+ *  To avoid this problem, we do the raycast for terrain detection from
+ *  the center of the 4 wheel positions (in world coordinates).
+ */
+Vec3 Kart::getTerrainRayOrigin() const
+{
+    Vec3 from(0, 0, 0);
+    for (unsigned int i = 0; i < 4; i++)
+        from += m_vehicle->getWheelInfo(i).m_raycastInfo.m_hardPointWS;
+
+    // Add a certain epsilon (0.3) to the height of the kart. This avoids
+    // problems of the ray being cast from under the track (which happened
+    // e.g. on tux tollway when jumping down from the ramp, when the chassis
+    // partly tunnels through the track). While tunneling should not be
+    // happening (since Z velocity is clamped), the epsilon is left in place
+    // just to be on the safe side (it will not hit the chassis itself).
+    return from/4 + Vec3(0,0.3f,0);
+}   // getTerrainRayOrigin
+
 //-----------------------------------------------------------------------------
 /** Show fire to go with a zipper.
  */
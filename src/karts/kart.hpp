@@ -224,6 +224,7 @@ private:
     void          updateEnginePowerAndBrakes(float dt);
     void          updateEngineSFX();
     void          updateNitro(float dt);
+    Vec3          getTerrainRayOrigin() const;
     float         getActualWheelForce();
     void          playCrashSFX(const Material* m, AbstractKart *k);
     void          loadData(RaceManager::KartType type, bool animatedModel);
@@ -273,6 +274,7 @@ public:
     virtual void   crashed          (const Material *m, const Vec3 &normal);
     virtual float  getHoT           () const;
     virtual void   update           (float dt);
+    virtual void   updateParallel   (float dt);
     virtual void   finishedRace     (float time, bool from_server=false);
     virtual void   setPosition      (int p);
     virtual void   beep             ();
@@ -22,6 +22,7 @@
 #include "karts/rescue_animation.hpp"
 #include "items/item.hpp"
 #include "modes/linear_world.hpp"
+#include "race/race_manager.hpp"
 
 KartWithStats::KartWithStats(const std::string& ident,
                              unsigned int world_kart_id,
@@ -50,6 +51,13 @@ void KartWithStats::reset()
     m_bubblegum_count   = 0;
     m_brake_count       = 0;
     m_off_track_count   = 0;
+    m_kart_crash_count  = 0;
+    m_track_crash_count = 0;
+    m_crash_flags          = 0;
+    m_previous_crash_flags = 0;
+    m_current_lap       = -1;
+    m_lap_start_time    = 0.0f;
+    m_lap_times.clear();
     Kart::reset();
 }   // reset
 
@@ -66,11 +74,50 @@ void KartWithStats::update(float dt)
         m_skidding_time += dt;
     if(getControls().m_brake)
         m_brake_count ++;
+    // The physics (which reports crashes) is updated before the karts.
+    m_previous_crash_flags = m_crash_flags;
+    m_crash_flags          = 0;
     LinearWorld *world = dynamic_cast<LinearWorld*>(World::getWorld());
-    if(world && !world->isOnRoad(getWorldKartId()))
+    if(!world) return;
+    if(!world->isOnRoad(getWorldKartId()))
         m_off_track_count ++;
+    const int lap = world->getKartLaps(getWorldKartId());
+    if(lap>m_current_lap)
+    {
+        // Lap -1 is the way from the start position to the start line.
+        if(m_current_lap>=0)
+            m_lap_times.push_back(world->getTime()-m_lap_start_time);
+        m_current_lap    = lap;
+        m_lap_start_time = world->getTime();
+    }
 }   // update
 
+// ----------------------------------------------------------------------------
+/** Records the time of the last lap when the kart finishes the race. The
+ *  lap counter is increased in LinearWorld::newLap after this kart was
+ *  updated, and the race can be over (e.g. for the last kart) before the
+ *  kart is updated again, so update() would never see the final lap.
+ *  \param time The finishing time of the kart.
+ *  \param from_server True if the finishing time was sent by a server.
+ */
+void KartWithStats::finishedRace(float time, bool from_server)
+{
+    // Ignore a second call, and estimated finishing times (which are
+    // used when the race is over before the kart has done all laps).
+    LinearWorld *world = dynamic_cast<LinearWorld*>(World::getWorld());
+    if(!hasFinishedRace() && world && m_current_lap>=0)
+    {
+        const int lap = world->getKartLaps(getWorldKartId());
+        if(lap>m_current_lap && lap>=race_manager->getNumLaps())
+        {
+            m_lap_times.push_back(time-m_lap_start_time);
+            m_current_lap    = lap;
+            m_lap_start_time = time;
+        }
+    }
+    Kart::finishedRace(time, from_server);
+}   // finishedRace
+
 // ----------------------------------------------------------------------------
 /** Overloading setKartAnimation with a kind of listener function in order
  *  to gather statistics about rescues and explosions.
@@ -98,6 +145,43 @@ void KartWithStats::setKartAnimation(AbstractKartAnimation *ka)
     }
 }   // setKartAnimation
 
+// ----------------------------------------------------------------------------
+/** Increases a crash counter, unless the kart already had a crash of the
+ *  same type in this or the previous time step (since a crash is usually
+ *  reported in several consecutive time steps).
+ *  \param counter The counter to increase.
+ *  \param flag The type of the crash.
+ */
+void KartWithStats::countCrash(unsigned int *counter, unsigned int flag)
+{
+    if(!((m_crash_flags | m_previous_crash_flags) & flag))
+        (*counter)++;
+    m_crash_flags |= flag;
+}   // countCrash
+
+// ----------------------------------------------------------------------------
+/** Counts crashes with other karts.
+ *  \param k The kart that was hit.
+ *  \param update_attachments If true the attachment of this kart and the
+ *          other kart hit will be updated.
+ */
+void KartWithStats::crashed(AbstractKart *k, bool update_attachments)
+{
+    Kart::crashed(k, update_attachments);
+    countCrash(&m_kart_crash_count, CRASH_KART);
+}   // crashed(AbstractKart)
+
+// ----------------------------------------------------------------------------
+/** Counts crashes with the track.
+ *  \param m Material hit, can be NULL if no specific material exists.
+ *  \param normal The normal of the hit.
+ */
+void KartWithStats::crashed(const Material *m, const Vec3 &normal)
+{
+    Kart::crashed(m, normal);
+    countCrash(&m_track_crash_count, CRASH_TRACK);
+}   // crashed(Material)
+
 // ----------------------------------------------------------------------------
 /** Called when an item is collected. It will increment private variables that
  *  represent counters for each type of item hit.
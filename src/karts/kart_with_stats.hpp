@@ -70,6 +70,30 @@ private:
     /** How much time this kart was skidding. */
     float        m_skidding_time;
 
+    /** How often this kart crashed into another kart. */
+    unsigned int m_kart_crash_count;
+
+    /** How often this kart crashed into the track. */
+    unsigned int m_track_crash_count;
+
+    /** Types of crashes, used as bit flags. */
+    enum { CRASH_KART = 1, CRASH_TRACK = 2 };
+
+    /** The types of crashes in this and in the previous time step. This is
+     *  used to count a crash lasting several time steps only once. */
+    unsigned int m_crash_flags, m_previous_crash_flags;
+
+    /** The time of each completed lap. */
+    std::vector<float> m_lap_times;
+
+    /** The lap this kart is in, used to detect the start of a new lap. */
+    int          m_current_lap;
+
+    /** The time at which the current lap started. */
+    float        m_lap_start_time;
+
+    void         countCrash(unsigned int *counter, unsigned int flag);
+
 public:
                  KartWithStats(const std::string& ident,
                                unsigned int world_kart_id,
@@ -78,8 +102,11 @@ public:
                                PerPlayerDifficulty difficulty);
     virtual void update(float dt);
     virtual void reset();
+    virtual void finishedRace(float time, bool from_server=false);
     virtual void collectedItem(Item *item, int add_info);
     virtual void setKartAnimation(AbstractKartAnimation *ka);
+    virtual void crashed(AbstractKart *k, bool update_attachments);
+    virtual void crashed(const Material *m, const Vec3 &normal);
 
     /** Returns the top speed of this kart. */
     float getTopSpeed() const { return m_top_speed; }
@@ -120,6 +147,15 @@ public:
     /** Returns how often the kart was off track. */
     unsigned int getOffTrackCount() const { return m_off_track_count; }
     // ------------------------------------------------------------------------
+    /** Returns how often this kart crashed into another kart. */
+    unsigned int getKartCrashCount() const { return m_kart_crash_count; }
+    // ------------------------------------------------------------------------
+    /** Returns how often this kart crashed into the track. */
+    unsigned int getTrackCrashCount() const { return m_track_crash_count; }
+    // ------------------------------------------------------------------------
+    /** Returns the times of all completed laps. */
+    const std::vector<float>& getLapTimes() const { return m_lap_times; }
+    // ------------------------------------------------------------------------
 
 };   // KartWithStats
 #endif
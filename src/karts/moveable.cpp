@@ -122,6 +122,9 @@ void Moveable::stopFlying()
 //-----------------------------------------------------------------------------
 /** Updates the current position and rotation from the corresponding physics
  *  body, and then calls updateGraphics to position the model correctly.
+ *  m_transform is the copy of the physics transform used by all graphics:
+ *  with pipelined physics the motion state is modified by the physics
+ *  thread while the frame is rendered.
  *  \param float dt Time step size.
  */
 void Moveable::update(float dt)
@@ -134,6 +137,18 @@ void Moveable::update(float dt)
     updateGraphics(dt, Vec3(0,0,0), btQuaternion(0, 0, 0, 1));
 }   // update
 
+//-----------------------------------------------------------------------------
+/** Returns the transform of the physics body, i.e. the transform that will
+ *  be used by the next call to update().
+ */
+btTransform Moveable::getPhysicsTrans() const
+{
+    btTransform t = m_transform;
+    if(m_body->getInvMass()!=0)
+        m_motion_state->getWorldTransform(t);
+    return t;
+}   // getPhysicsTrans
+
 //-----------------------------------------------------------------------------
 /** Updates the current position and rotation. This function is also called
  *  by ghost karts for getHeading() to work.
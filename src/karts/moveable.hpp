@@ -110,6 +110,7 @@ public:
     const btTransform
                  &getTrans() const {return m_transform;}
     void          setTrans(const btTransform& t);
+    btTransform   getPhysicsTrans() const;
     void          updatePosition();
 }
 ;   // class Moveable
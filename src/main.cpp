@@ -152,6 +152,7 @@
 #include "config/user_config.hpp"
 #include "graphics/camera.hpp"
 #include "graphics/central_settings.hpp"
+#include "graphics/frustum_culler.hpp"
 #include "graphics/graphics_restrictions.hpp"
 #include "graphics/irr_driver.hpp"
 #include "graphics/material_manager.hpp"
@@ -169,6 +170,7 @@
 #include "items/item_manager.hpp"
 #include "items/projectile_manager.hpp"
 #include "karts/controller/ai_base_lap_controller.hpp"
+#include "karts/controller/skidding_ai.hpp"
 #include "karts/kart_properties.hpp"
 #include "karts/kart_properties_manager.hpp"
 #include "modes/cutscene_world.hpp"
@@ -180,22 +182,28 @@
 #include "network/stk_host.hpp"
 #include "online/profile_manager.hpp"
 #include "online/request_manager.hpp"
+#include "physics/physics_benchmark.hpp"
+#include "race/ai_tournament.hpp"
 #include "race/grand_prix_manager.hpp"
 #include "race/highscore_manager.hpp"
 #include "race/history.hpp"
 #include "race/race_manager.hpp"
+#include "replay/ghost_poses.hpp"
 #include "replay/replay_play.hpp"
 #include "replay/replay_recorder.hpp"
+#include "replay/replay_stats.hpp"
 #include "states_screens/main_menu_screen.hpp"
 #include "states_screens/register_screen.hpp"
 #include "states_screens/state_manager.hpp"
 #include "states_screens/user_screen.hpp"
 #include "states_screens/dialogs/message_dialog.hpp"
+#include "tracks/quad_graph.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
 #include "utils/command_line.hpp"
 #include "utils/constants.hpp"
 #include "utils/crash_reporting.hpp"
+#include "utils/job_system.hpp"
 #include "utils/leak_check.hpp"
 #include "utils/log.hpp"
 #include "utils/translation.hpp"
@@ -523,6 +531,38 @@ void cmdLineHelp()
     "       --profile-time=n   Enable automatic driven profile mode for n "
                               "seconds.\n"
     "       --no-graphics      Do not display the actual race.\n"
+    "       --ai-racing-line   Let the AI drive along the precomputed racing\n"
+    "                          line of the track.\n"
+    "       --physics-benchmark=file Append the time spent in each physics\n"
+    "                          phase to file (use with --profile-laps,\n"
+    "                          --profile-time or --history).\n"
+    "       --culling-benchmark Compare the frustum culling kernels using\n"
+    "                          synthetic scenes and exit.\n"
+    "       --ghost-benchmark  Compare the interpolation of 50 ghost karts\n"
+    "                          one by one and batched, and exit.\n"
+    "       --pipelined-physics Compute the physics of the next frame while\n"
+    "                          the current frame is rendered.\n"
+    "       --seed=n           Seed for the random number generator.\n"
+    "       --ai-tournament    Run an AI race for each combination of the\n"
+    "                          following options (using --no-graphics and\n"
+    "                          --profile-laps) and write the results to a\n"
+    "                          JSON and a CSV file:\n"
+    "       --tournament-tracks=t1,t2 Tracks to use.\n"
+    "       --tournament-karts=n1,n2  Number of karts (default 4).\n"
+    "       --tournament-difficulties=d1,d2 Difficulties (default 2).\n"
+    "       --tournament-seeds=s1,s2  Random seeds, a range like 1-10 can be\n"
+    "                          used (default 1).\n"
+    "       --tournament-laps=n       Number of laps (default 3).\n"
+    "       --tournament-jobs=n       Number of races run in parallel\n"
+    "                          (default: number of processors).\n"
+    "       --tournament-report=name  Name of the report files without\n"
+    "                          extension (default 'tournament').\n"
+    "       --replay-stats=name Validate all replay files and write lap\n"
+    "                          times, speed profiles and skid/nitro usage\n"
+    "                          to name.csv, name-laps.csv and\n"
+    "                          name-speed.csv (use with --no-graphics).\n"
+    "       --replay-stats-dir=dir Directory of the replay files to use\n"
+    "                          (default: stock and recorded replays).\n"
     "       --demo-mode=t      Enables demo mode after t seconds idle time in "
                                "main menu.\n"
     "       --demo-tracks=t1,t2 List of tracks to be used in demo mode. No\n"
@@ -533,6 +573,9 @@ void cmdLineHelp()
     // "       --history=n        Replay history file 'history.dat' using:\n"
     // "                            n=1: recorded positions\n"
     // "                            n=2: recorded key strokes\n"
+    // "                            n=4: recorded key strokes, and report\n"
+    // "                                 differences to the recorded race\n"
+    // "                                 in history_verify.csv\n"
     // "       --test-ai=n        Use the test-ai for every n-th AI kart.\n"
     // "                          (so n=1 means all Ais will be the test ai)\n"
     // "                             
@@ -770,10 +813,17 @@ int handleCmdLine()
         UserConfigParams::m_rendering_debug=true;
     if(CommandLine::has("--ai-debug"))
         AIBaseController::enableDebug();
+    if(CommandLine::has("--ai-racing-line"))
+    {
+        SkiddingAI::enableRacingLine();
+        QuadGraph::enableRacingLine();
+    }
     if(CommandLine::has("--test-ai", &n))
         AIBaseController::setTestAI(n);
     if (CommandLine::has("--fps-debug"))
         UserConfigParams::m_fps_debug = true;
+    if (CommandLine::has("--pipelined-physics"))
+        UserConfigParams::m_pipelined_physics = true;
 
     if(UserConfigParams::m_artist_debug_mode)
     {
@@ -1022,6 +1072,27 @@ int handleCmdLine()
         race_manager->setNumLaps(999999); // profile end depends on time
     }   // --profile-time
 
+    if(CommandLine::has("--physics-benchmark", &s))
+    {
+        Log::verbose("main", "Physics timings will be written to '%s'.",
+                     s.c_str());
+        PhysicsBenchmark::enable(s);
+    }   // --physics-benchmark
+
+    if(CommandLine::has("--replay-stats", &s))
+        ReplayStats::enable(s);
+    if(CommandLine::has("--replay-stats-dir", &s))
+        ReplayStats::setReplayDirectory(s);
+
+    if(CommandLine::has("--ai-tournament-result", &s))
+        ProfileWorld::setResultFile(s);
+
+    if(CommandLine::has("--seed", &n))
+    {
+        Log::verbose("main", "Using random seed %d.", n);
+        srand(n);
+    }   // --seed
+
     if(CommandLine::has("--history",  &n))
     {
         history->doReplayHistory( (History::HistoryReplayMode)n);
@@ -1169,6 +1240,7 @@ void initRest()
 
     music_manager = new MusicManager();
     SFXManager::create();
+    JobSystem::create();
     // The order here can be important, e.g. KartPropertiesManager needs
     // defaultKartProperties, which are defined in stk_config.
     history                 = new History              ();
@@ -1298,6 +1370,21 @@ int main(int argc, char *argv[] )
 
         handleCmdLineOutputModifier();//if comand has some word do something, such as for "--help" show the help content
 
+        // A tournament only starts other STK processes to run the races,
+        // so it does not need any of the managers. All options not used
+        // by the tournament (e.g. --root) are passed on to these processes.
+        if(CommandLine::has("--ai-tournament"))
+        {
+            AITournament tournament;
+            return tournament.run();
+        }
+
+        // The culling and ghost benchmarks only use synthetic data.
+        if(CommandLine::has("--culling-benchmark"))
+            return FrustumCuller::runBenchmark();
+        if(CommandLine::has("--ghost-benchmark"))
+            return GhostPoses::runBenchmark();
+
         if(CommandLine::has("--root", &s))
             FileManager::addRootDirs(s);
         if (CommandLine::has("--stdout", &s))
@@ -1376,6 +1463,14 @@ int main(int argc, char *argv[] )
         //handleCmdLine() needs InitTuxkart() so it can't be called first
         if(!handleCmdLine()) exit(0);
 
+        // The replay statistics only need the tracks and the replay
+        // parsing code, no race is started.
+        if(ReplayStats::isEnabled())
+        {
+            ReplayStats stats;
+            exit(stats.run());
+        }
+
         addons_manager->checkInstalledAddons();
 
         // Load addons.xml to get info about addons even when not
@@ -1496,6 +1591,10 @@ int main(int argc, char *argv[] )
             race_manager->setupPlayerKartInfo();
             race_manager->startNew(false);
             main_loop->run();
+            // In verification mode the main loop is left after one replay,
+            // and the exit code indicates if the race was reproduced.
+            if(history->isVerifying())
+                exit(history->hasDiverged() ? 1 : 0);
             // well, actually run() will never return, since
             // it exits after replaying history (see history::GetNextDT()).
             // So the next line is just to make this obvious here!
@@ -1641,6 +1740,7 @@ static void cleanSuperTuxKart()
         Log::info("Thread", "SFXManager not stopping, exiting anyway.");
     }
     SFXManager::destroy();
+    JobSystem::destroy();
 
     // Music manager can not be deleted before the sfx thread is stopped
     // (since sfx commands can contain music information, which are
@@ -35,6 +35,8 @@
 #include "network/race_event_manager.hpp"
 #include "network/stk_host.hpp"
 #include "online/request_manager.hpp"
+#include "physics/physics.hpp"
+#include "race/history.hpp"
 #include "race/race_manager.hpp"
 #include "states_screens/state_manager.hpp"
 #include "utils/profiler.hpp"
@@ -171,6 +173,19 @@ void MainLoop::run()
             GUIEngine::update(dt);
             PROFILER_POP_CPU_MARKER();
 
+            // In pipelined mode the physics of the next frame are computed
+            // in a separate thread while this frame is rendered. This is not
+            // done when replaying a history, since the time step of the next
+            // frame is then taken from the history file.
+            World *world = World::getWorld();
+            if (UserConfigParams::m_pipelined_physics && world &&
+                world->getPhysics() && !history->dontDoPhysics() &&
+                !history->replayHistory() &&
+                !RaceEventManager::getInstance<RaceEventManager>()->isRunning())
+            {
+                world->getPhysics()->startPipelinedStep(dt);
+            }
+
             PROFILER_PUSH_CPU_MARKER("IrrDriver update", 0x00, 0x00, 0x7F);
             irr_driver->update(dt);
             PROFILER_POP_CPU_MARKER();
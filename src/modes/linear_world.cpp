@@ -94,6 +94,7 @@ void LinearWorld::reset()
         m_kart_info[i].getTrackSector()->update(m_karts[i]->getXYZ());
         m_karts[i]->setWrongwayCounter(0);
     }   // next kart
+    m_race_order.clear();
 
     // At the moment the last kart would be the one that is furthest away
     // from the start line, i.e. it would determine the amount by which
@@ -653,9 +654,27 @@ btTransform LinearWorld::getRescueTransform(unsigned int index) const
 }   // getRescueTransform
 
 //-----------------------------------------------------------------------------
-/** Find the position (rank) of every kart. ATM it uses a stable O(n^2)
- *  algorithm by counting for each kart how many other karts are ahead of
- *  it.
+/** Returns true if kart a is ahead of kart b, assuming that neither of them
+ *  has finished the race or is eliminated: a kart is ahead if it has covered
+ *  a larger overall distance, or the same distance (very unlikely) but
+ *  started earlier.
+ */
+bool LinearWorld::isAheadOf(unsigned int a, unsigned int b) const
+{
+    const float distance_a = m_kart_info[a].m_overall_distance;
+    const float distance_b = m_kart_info[b].m_overall_distance;
+    return distance_a > distance_b ||
+           (distance_a == distance_b &&
+            m_karts[a]->getInitialPosition() < m_karts[b]->getInitialPosition());
+}   // isAheadOf
+
+//-----------------------------------------------------------------------------
+/** Find the position (rank) of every kart. All karts that have finished the
+ *  race (and are not eliminated) are ahead of all karts still racing, and
+ *  the karts still racing are ordered by isAheadOf(). The order of the
+ *  karts still racing is kept from the previous frame and updated with an
+ *  insertion sort, which is O(n) if only a few karts overtook each other,
+ *  and O(n^2) only in the worst case.
  */
 void LinearWorld::updateRacePosition()
 {
@@ -663,13 +682,57 @@ void LinearWorld::updateRacePosition()
     beginSetKartPositions();
     const unsigned int kart_amount = (unsigned int) m_karts.size();
 
-#ifdef DEBUG
-    bool rank_changed = false;
-#endif
+    // Count the karts that have finished the race, and the karts that
+    // are still racing.
+    unsigned int num_finished = 0, num_racing = 0;
+    for (unsigned int i=0; i<kart_amount; i++)
+    {
+        if(m_karts[i]->isEliminated()) continue;
+        if(m_karts[i]->hasFinishedRace())
+            num_finished++;
+        else
+            num_racing++;
+    }
+
+    // Remove karts that are not racing anymore from the order of the
+    // previous frame. If a kart is missing (e.g. after a reset), the
+    // order is rebuilt from scratch.
+    unsigned int n = 0;
+    for (unsigned int k=0; k<m_race_order.size(); k++)
+    {
+        const AbstractKart *kart = m_karts[m_race_order[k]];
+        if(!kart->isEliminated() && !kart->hasFinishedRace())
+            m_race_order[n++] = m_race_order[k];
+    }
+    m_race_order.resize(n);
+    if(n!=num_racing)
+    {
+        m_race_order.clear();
+        for (unsigned int i=0; i<kart_amount; i++)
+        {
+            if(!m_karts[i]->isEliminated() && !m_karts[i]->hasFinishedRace())
+                m_race_order.push_back(i);
+        }
+    }
+
+    // Insertion sort, the order of the last frame is usually still
+    // correct or very nearly so.
+    for (unsigned int k=1; k<m_race_order.size(); k++)
+    {
+        const unsigned int kart_id = m_race_order[k];
+        unsigned int j = k;
+        while(j>0 && isAheadOf(kart_id, m_race_order[j-1]))
+        {
+            m_race_order[j] = m_race_order[j-1];
+            j--;
+        }
+        m_race_order[j] = kart_id;
+    }
+
+    m_race_position.resize(kart_amount);
+    for (unsigned int k=0; k<m_race_order.size(); k++)
+        m_race_position[m_race_order[k]] = num_finished + k + 1;
 
-    // NOTE: if you do any changes to this loop, the next loop (see
-    // DEBUG_KART_RANK below) needs to have the same changes applied
-    // so that debug output is still correct!!!!!!!!!!!
     for (unsigned int i=0; i<kart_amount; i++)
     {
         AbstractKart* kart = m_karts[i];
@@ -686,39 +749,28 @@ void LinearWorld::updateRacePosition()
             continue;
         }
         KartInfo& kart_info = m_kart_info[i];
+        const int p = m_race_position[i];
 
-        int p = 1 ;
-
-        const unsigned int my_id = kart->getWorldKartId();
-        const float my_distance  = m_kart_info[my_id].m_overall_distance;
-
-        // Count karts ahead of the current kart, i.e. kart that are
-        // already finished or have covered a larger overall distance.
-        for (unsigned int j = 0 ; j < kart_amount ; j++)
+#ifdef DEBUG_KART_RANK
+        // Compare with the definition of the rank: the number of karts
+        // that have finished the race or are ahead of this kart, plus one.
+        int expected = 1;
+        for (unsigned int j=0; j<kart_amount; j++)
         {
-            // don't compare a kart with itself and ignore eliminated karts
-            if(j == my_id || m_karts[j]->isEliminated())
-                continue;
-
-            // If the other kart has:
-            // - finished the race (but this kart hasn't)
-            // - or is ahead
-            // - or has the same distance (very unlikely) but started earlier
-            // it is ahead --> increase position
-            if((!kart->hasFinishedRace() && m_karts[j]->hasFinishedRace()) ||
-                m_kart_info[j].m_overall_distance > my_distance            ||
-               (m_kart_info[j].m_overall_distance == my_distance &&
-                m_karts[j]->getInitialPosition()<kart->getInitialPosition() ) )
-            {
-                p++;
-            }
-
-        } //next kart
+            if(j==i || m_karts[j]->isEliminated()) continue;
+            if(m_karts[j]->hasFinishedRace() || isAheadOf(j, i))
+                expected++;
+        }
+        if(expected!=p)
+        {
+            Log::error("[LinearWorld]", "Kart %s has rank %d instead of %d.",
+                       kart->getIdent().c_str(), p, expected);
+        }
+#endif
 
 #ifndef DEBUG
         setKartPosition(i, p);
 #else
-        rank_changed |= kart->getPosition()!=p;
         if (!setKartPosition(i,p))
         {
             Log::error("[LinearWorld]", "Same rank used twice!!");
@@ -761,75 +813,6 @@ void LinearWorld::updateRacePosition()
         }
     }   // for i<kart_amount
 
-    // Define this to get a detailled analyses each time a race position
-    // changes.
-#ifdef DEBUG
-#undef DEBUG_KART_RANK
-#ifdef DEBUG_KART_RANK
-    if(rank_changed)
-    {
-        Log::debug("[LinearWorld]", "Counting laps at %u seconds.", getTime());
-        for (unsigned int i=0; i<kart_amount; i++)
-        {
-            AbstractKart* kart = m_karts[i];
-            Log::debug("[LinearWorld]", "counting karts ahead of %s (laps %u,"
-                        " progress %u, finished %d, eliminated %d, initial position %u.",
-                        kart->getIdent().c_str(),
-                        m_kart_info[i].m_race_lap,
-                        m_kart_info[i].m_overall_distance,
-                        kart->hasFinishedRace(),
-                        kart->isEliminated(),
-                        kart->getInitialPosition());
-            // Karts that are either eliminated or have finished the
-            // race already have their (final) position assigned. If
-            // these karts would get their rank updated, it could happen
-            // that a kart that finished first will be overtaken after
-            // crossing the finishing line and become second!
-            if(kart->isEliminated() || kart->hasFinishedRace()) continue;
-            KartInfo& kart_info = m_kart_info[i];
-            int p = 1 ;
-            const int my_id         = kart->getWorldKartId();
-            const float my_distance = m_kart_info[my_id].m_overall_distance;
-
-            for (unsigned int j = 0 ; j < kart_amount ; j++)
-            {
-                if(j == my_id) continue;
-                if(m_karts[j]->isEliminated())
-                {
-                    Log::debug("[LinearWorld]", " %u: %s because it is eliminated.",
-                                p, m_karts[j]->getIdent().c_str());
-                    continue;
-                }
-                if(!kart->hasFinishedRace() && m_karts[j]->hasFinishedRace())
-                {
-                    p++;
-                    Log::debug("[LinearWorld]", " %u: %s because it has finished the race.",
-                                p, m_karts[j]->getIdent().c_str());
-                    continue;
-                }
-                if(m_kart_info[j].m_overall_distance > my_distance)
-                {
-                    p++;
-                    Log::debug("[LinearWorld]", " %u: %s because it is ahead %u.",
-                                p, m_karts[j]->getIdent().c_str(),
-                                m_kart_info[j].m_overall_distance);
-                    continue;
-                }
-                if(m_kart_info[j].m_overall_distance == my_distance &&
-                   m_karts[j]->getInitialPosition()<kart->getInitialPosition())
-                {
-                    p++;
-                    Log::debug("[LinearWorld]"," %u: %s has same distance, but started ahead %d",
-                                p, m_karts[j]->getIdent().c_str(),
-                                m_karts[j]->getInitialPosition());
-                }
-            }   // next kart j
-        }   // for i<kart_amount
-        Log::debug("LinearWorld]", "-------------------------------------------");
-    }   // if rank_changed
-#endif
-#endif
-
     endSetKartPositions();
 }   // updateRacePosition
 
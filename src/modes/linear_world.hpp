@@ -55,6 +55,15 @@ private:
      *  get valid finish times estimates. */
     float       m_distance_increase;
 
+    /** The world ids of all karts that are still racing (i.e. neither
+     *  finished nor eliminated), sorted by their rank. It is kept from one
+     *  frame to the next, so it is usually already (nearly) sorted. */
+    std::vector<unsigned int> m_race_order;
+
+    /** The position of each kart still racing as computed in the last
+     *  call to updateRacePosition(), indexed by world kart id. */
+    std::vector<unsigned int> m_race_position;
+
     // ------------------------------------------------------------------------
     /** Some additional info that needs to be kept for each kart
      * in this kind of race.
@@ -113,6 +122,7 @@ protected:
 
     virtual void  checkForWrongDirection(unsigned int i, float dt);
     void          updateRacePosition();
+    bool          isAheadOf(unsigned int a, unsigned int b) const;
     virtual float estimateFinishTimeForKart(AbstractKart* kart) OVERRIDE;
 
 public:
@@ -23,17 +23,20 @@
 #include "graphics/irr_driver.hpp"
 #include "karts/kart_with_stats.hpp"
 #include "karts/controller/controller.hpp"
+#include "physics/physics_benchmark.hpp"
 #include "tracks/track.hpp"
 
 #include <ISceneManager.h>
 
 #include <iomanip>
 #include <iostream>
+#include <sstream>
 
 ProfileWorld::ProfileType ProfileWorld::m_profile_mode=PROFILE_NONE;
 int   ProfileWorld::m_num_laps    = 0;
 float ProfileWorld::m_time        = 0.0f;
 bool  ProfileWorld::m_no_graphics = false;
+std::string ProfileWorld::m_result_filename;
 
 //-----------------------------------------------------------------------------
 /** The constructor sets the number of (local) players to 0, since only AI
@@ -56,6 +59,7 @@ ProfileWorld::ProfileWorld()
     m_num_transparent  = 0;
     m_num_trans_effect = 0;
     m_num_calls        = 0;
+    m_start_cpu_time   = 0;
 }   // ProfileWorld
 
 //-----------------------------------------------------------------------------
@@ -128,6 +132,50 @@ AbstractKart *ProfileWorld::createKart(const std::string &kart_ident, int index,
     return new_kart;
 }   // createKart
 
+//-----------------------------------------------------------------------------
+/** Writes the results of the race as CSV to the result file, one line per
+ *  kart with the columns kart,controller,start_position,end_position,
+ *  finish_time,best_lap,lap_times,kart_crashes,track_crashes,rescues,
+ *  explosions,cpu_time,real_time. The lap times are separated by ';'.
+ *  \param cpu_time CPU time used for the race.
+ *  \param real_time Real time used for the race.
+ */
+void ProfileWorld::writeResultFile(float cpu_time, float real_time)
+{
+    FILE *fd = fopen(m_result_filename.c_str(), "w");
+    if(!fd)
+    {
+        Log::error("profile", "Can't open '%s' for writing.",
+                   m_result_filename.c_str());
+        return;
+    }
+    fprintf(fd, "kart,controller,start_position,end_position,finish_time,"
+                "best_lap,lap_times,kart_crashes,track_crashes,rescues,"
+                "explosions,cpu_time,real_time\n");
+    for(unsigned int i=0; i<m_karts.size(); i++)
+    {
+        KartWithStats* kart = dynamic_cast<KartWithStats*>(m_karts[i]);
+        const std::vector<float> &laps = kart->getLapTimes();
+        std::ostringstream lap_times;
+        float best_lap = 0.0f;
+        for(unsigned int j=0; j<laps.size(); j++)
+        {
+            if(j>0) lap_times << ";";
+            lap_times << laps[j];
+            if(j==0 || laps[j]<best_lap)
+                best_lap = laps[j];
+        }
+        fprintf(fd, "%s,%s,%u,%d,%f,%f,%s,%u,%u,%u,%u,%f,%f\n",
+                kart->getIdent().c_str(),
+                kart->getController()->getControllerName().c_str(),
+                i+1, kart->getPosition(), kart->getFinishTime(), best_lap,
+                lap_times.str().c_str(), kart->getKartCrashCount(),
+                kart->getTrackCrashCount(), kart->getRescueCount(),
+                kart->getExplosionCount(), cpu_time, real_time);
+    }
+    fclose(fd);
+}   // writeResultFile
+
 //-----------------------------------------------------------------------------
 /** The race is over if either the requested number of laps have been done
  *  or the requested time is over.
@@ -152,6 +200,9 @@ bool ProfileWorld::isRaceOver()
  */
 void ProfileWorld::update(float dt)
 {
+    // Only measure the race itself, not loading the track.
+    if(m_frame_count==0)
+        m_start_cpu_time = clock();
     StandardRace::update(dt);
 
     m_frame_count++;
@@ -203,6 +254,12 @@ void ProfileWorld::enterRaceOverState()
     float runtime = (irr_driver->getRealTime()-m_start_time)*0.001f;
     Log::verbose("profile", "Number of frames: %d time %f, Average FPS: %f",
                  m_frame_count, runtime, (float)m_frame_count/runtime);
+    PhysicsBenchmark::writeResults();
+    if(!m_result_filename.empty())
+    {
+        writeResultFile((float)(clock()-m_start_cpu_time)/CLOCKS_PER_SEC,
+                        runtime);
+    }
 
     // Print geometry statistics if we're not in no-graphics mode
     if(!m_no_graphics)
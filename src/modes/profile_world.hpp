@@ -21,6 +21,9 @@
 
 #include "modes/standard_race.hpp"
 
+#include <string>
+#include <time.h>
+
 class Kart;
 
 /**
@@ -43,6 +46,13 @@ private:
     /** In time based profiling only: time to run. */
     static float m_time;
 
+    /** If not empty, the results of the race are written to this file
+     *  (used by the AI tournament). */
+    static std::string m_result_filename;
+
+    /** CPU time used by this process at the start of the race. */
+    clock_t      m_start_cpu_time;
+
     /** Return value of real time at start of race. */
     unsigned int m_start_time;
 
@@ -72,6 +82,8 @@ protected:
      *  used by DemoWorld. */
     static int   m_num_laps;
 
+    void         writeResultFile(float cpu_time, float real_time);
+
     virtual AbstractKart *createKart(const std::string &kart_ident, int index,
                                      int local_player_id, int global_player_id,
                                      RaceManager::KartType type,
@@ -89,6 +101,12 @@ public:
     static   void setProfileModeTime(float time);
     static   void setProfileModeLaps(int laps);
     // ------------------------------------------------------------------------
+    /** Sets the name of a file the results of the race are written to. */
+    static   void setResultFile(const std::string &filename)
+    {
+        m_result_filename = filename;
+    }   // setResultFile
+    // ------------------------------------------------------------------------
     /** Returns true if profile mode was selected. */
     static   bool isProfileMode() {return m_profile_mode!=PROFILE_NONE; }
     // ------------------------------------------------------------------------
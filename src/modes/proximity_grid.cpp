@@ -0,0 +1,160 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "modes/proximity_grid.hpp"
+
+#include "karts/abstract_kart.hpp"
+
+#include <algorithm>
+#include <math.h>
+
+/** The preferred size of a cell. It is increased for very large tracks to
+ *  limit the number of cells. */
+static const float PROXIMITY_CELL_SIZE = 16.0f;
+
+/** Maximum number of cells in each direction. */
+static const int   PROXIMITY_MAX_CELLS = 256;
+
+// ----------------------------------------------------------------------------
+/** Creates an empty grid covering the given bounding box.
+ *  \param aabb_min, aabb_max The bounding box of the track.
+ */
+ProximityGrid::ProximityGrid(const Vec3 &aabb_min, const Vec3 &aabb_max)
+{
+    m_min_x     = aabb_min.getX();
+    m_min_z     = aabb_min.getZ();
+    const float size = std::max(aabb_max.getX()-m_min_x,
+                                aabb_max.getZ()-m_min_z);
+    m_cell_size = std::max(PROXIMITY_CELL_SIZE, size/PROXIMITY_MAX_CELLS);
+    m_num_x     = (int)ceilf((aabb_max.getX()-m_min_x)/m_cell_size);
+    m_num_z     = (int)ceilf((aabb_max.getZ()-m_min_z)/m_cell_size);
+    m_num_x     = std::max(1, std::min(m_num_x, PROXIMITY_MAX_CELLS));
+    m_num_z     = std::max(1, std::min(m_num_z, PROXIMITY_MAX_CELLS));
+    m_kart_cells.resize(m_num_x*m_num_z);
+    m_projectile_cells.resize(m_num_x*m_num_z);
+    m_max_kart_speed  = 0;
+    m_num_projectiles = 0;
+}   // ProximityGrid
+
+// ----------------------------------------------------------------------------
+/** Returns the (clamped) index of the cell column containing x. */
+int ProximityGrid::getCellX(float x) const
+{
+    const int i = (int)floorf((x-m_min_x)/m_cell_size);
+    return std::max(0, std::min(i, m_num_x-1));
+}   // getCellX
+
+// ----------------------------------------------------------------------------
+/** Returns the (clamped) index of the cell row containing z. */
+int ProximityGrid::getCellZ(float z) const
+{
+    const int j = (int)floorf((z-m_min_z)/m_cell_size);
+    return std::max(0, std::min(j, m_num_z-1));
+}   // getCellZ
+
+// ----------------------------------------------------------------------------
+/** Rebuilds the grid with the current positions of all karts, and removes
+ *  all projectiles (they are added again by the projectile manager).
+ *  Eliminated and ghost karts are not added.
+ *  \param karts All karts of the world.
+ */
+void ProximityGrid::update(const std::vector<AbstractKart*> &karts)
+{
+    for(unsigned int i=0; i<m_kart_cells.size(); i++)
+        m_kart_cells[i].clear();
+    if(m_num_projectiles>0)
+    {
+        for(unsigned int i=0; i<m_projectile_cells.size(); i++)
+            m_projectile_cells[i].clear();
+        m_num_projectiles = 0;
+    }
+
+    m_max_kart_speed = 0;
+    for(unsigned int k=0; k<karts.size(); k++)
+    {
+        const AbstractKart *kart = karts[k];
+        if(kart->isEliminated() || kart->isGhostKart()) continue;
+        const Vec3 &xyz = kart->getXYZ();
+        m_kart_cells[getCellZ(xyz.getZ())*m_num_x + getCellX(xyz.getX())]
+            .push_back(k);
+        m_max_kart_speed = std::max(m_max_kart_speed,
+                                    kart->getVelocity().length_2d());
+    }
+}   // update
+
+// ----------------------------------------------------------------------------
+/** Adds a projectile at the given position.
+ *  \param xyz Position of the projectile.
+ */
+void ProximityGrid::addProjectile(const Vec3 &xyz)
+{
+    m_projectile_cells[getCellZ(xyz.getZ())*m_num_x + getCellX(xyz.getX())]
+        .push_back(xyz);
+    m_num_projectiles++;
+}   // addProjectile
+
+// ----------------------------------------------------------------------------
+/** Returns the world ids of all karts in the cells overlapping the given
+ *  box (in the x/z plane), sorted by world id.
+ *  \param min, max The box to test.
+ *  \param karts On return the ids of the karts found.
+ */
+void ProximityGrid::findKarts(const Vec3 &min, const Vec3 &max,
+                              std::vector<unsigned int> *karts) const
+{
+    karts->clear();
+    const int x0 = getCellX(min.getX()), x1 = getCellX(max.getX());
+    const int z0 = getCellZ(min.getZ()), z1 = getCellZ(max.getZ());
+    for(int j=z0; j<=z1; j++)
+    {
+        for(int i=x0; i<=x1; i++)
+        {
+            const std::vector<unsigned int> &cell = m_kart_cells[j*m_num_x+i];
+            karts->insert(karts->end(), cell.begin(), cell.end());
+        }
+    }
+    std::sort(karts->begin(), karts->end());
+}   // findKarts
+
+// ----------------------------------------------------------------------------
+/** Returns true if a projectile is within the given distance of a point.
+ *  \param xyz The point.
+ *  \param radius Distance within which the projectile must be.
+ */
+bool ProximityGrid::isProjectileClose(const Vec3 &xyz, float radius) const
+{
+    if(m_num_projectiles==0) return false;
+
+    const float r2 = radius*radius;
+    const int x0 = getCellX(xyz.getX()-radius);
+    const int x1 = getCellX(xyz.getX()+radius);
+    const int z0 = getCellZ(xyz.getZ()-radius);
+    const int z1 = getCellZ(xyz.getZ()+radius);
+    for(int j=z0; j<=z1; j++)
+    {
+        for(int i=x0; i<=x1; i++)
+        {
+            const std::vector<Vec3> &cell = m_projectile_cells[j*m_num_x+i];
+            for(unsigned int p=0; p<cell.size(); p++)
+            {
+                if(cell[p].distance2(xyz)<r2) return true;
+            }
+        }
+    }
+    return false;
+}   // isProjectileClose
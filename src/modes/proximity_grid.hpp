@@ -0,0 +1,86 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_PROXIMITY_GRID_HPP
+#define HEADER_PROXIMITY_GRID_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/vec3.hpp"
+
+#include <vector>
+
+class AbstractKart;
+
+/** A uniform 2d grid (in the x/z plane) over the track that stores which
+ *  karts and projectiles are in which cell. It is rebuilt once per frame in
+ *  World::update() before the karts are updated, and allows the AI to find
+ *  karts close to its predicted path and close projectiles without testing
+ *  all of them. Points outside of the track's bounding box are stored in
+ *  the closest border cell, so queries are always conservative.
+ *  Note that the positions in the grid lag behind by up to one frame: it
+ *  is filled with the positions after the physics step, but before
+ *  Kart::update() is called for any kart. A kart that is moved during the
+ *  kart updates (e.g. by a rescue) is still found in its old cell till the
+ *  next frame. A new projectile is added immediately when it is created
+ *  (see ProjectileManager::newProjectile()), but with its start position,
+ *  and it also stays in that cell till the next frame. The grid only
+ *  stores the world ids of the karts, so the actual crash tests use the
+ *  current data of the karts.
+ * \ingroup modes
+ */
+class ProximityGrid : public NoCopy
+{
+private:
+    /** World ids of all karts in each cell. */
+    std::vector<std::vector<unsigned int> > m_kart_cells;
+
+    /** Positions of all projectiles in each cell. */
+    std::vector<std::vector<Vec3> > m_projectile_cells;
+
+    /** Minimum x and z coordinate covered by the grid. */
+    float m_min_x, m_min_z;
+
+    /** Size of a (square) cell. */
+    float m_cell_size;
+
+    /** Number of cells in x and z direction. */
+    int   m_num_x, m_num_z;
+
+    /** The largest speed (in the x/z plane) of any kart at the time the
+     *  grid was built. */
+    float m_max_kart_speed;
+
+    /** Number of projectiles in the grid. */
+    unsigned int m_num_projectiles;
+
+    int   getCellX(float x) const;
+    int   getCellZ(float z) const;
+
+public:
+          ProximityGrid(const Vec3 &aabb_min, const Vec3 &aabb_max);
+    void  update(const std::vector<AbstractKart*> &karts);
+    void  addProjectile(const Vec3 &xyz);
+    void  findKarts(const Vec3 &min, const Vec3 &max,
+                    std::vector<unsigned int> *karts) const;
+    bool  isProjectileClose(const Vec3 &xyz, float radius) const;
+    // ------------------------------------------------------------------------
+    /** Returns the largest speed (in the x/z plane) of all karts. */
+    float getMaxKartSpeed() const { return m_max_kart_speed; }
+};   // ProximityGrid
+
+#endif
@@ -0,0 +1,87 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "modes/race_snapshot.hpp"
+
+#include "karts/abstract_kart.hpp"
+#include "modes/linear_world.hpp"
+#include "modes/profile_world.hpp"
+#include "modes/world_with_rank.hpp"
+#include "race/race_manager.hpp"
+#include "tracks/quad_graph.hpp"
+
+RaceSnapshot::RaceSnapshot()
+{
+    m_max_player_distance = 0.0f;
+}   // RaceSnapshot
+
+// ----------------------------------------------------------------------------
+/** Takes a new snapshot of all karts.
+ *  \param world The world.
+ */
+void RaceSnapshot::update(const World *world)
+{
+    const LinearWorld   *linear_world = dynamic_cast<const LinearWorld*>(world);
+    const WorldWithRank *rank_world   =
+                                     dynamic_cast<const WorldWithRank*>(world);
+    const unsigned int num_karts = world->getNumKarts();
+
+    m_karts.resize(num_karts);
+    for(unsigned int i=0; i<num_karts; i++)
+    {
+        const AbstractKart *kart = world->getKart(i);
+        KartState &state         = m_karts[i];
+        state.m_xyz              = kart->getXYZ();
+        state.m_velocity         = kart->getVelocity();
+        state.m_position         = kart->getPosition();
+        state.m_is_eliminated    = kart->isEliminated();
+        state.m_has_finished     = kart->hasFinishedRace();
+        if(linear_world)
+        {
+            state.m_overall_distance   = linear_world->getOverallDistance(i);
+            state.m_distance_to_center =
+                linear_world->getDistanceToCenterForKart(i);
+            state.m_sector             = linear_world->getSectorForKart(kart);
+        }
+        else
+        {
+            state.m_overall_distance   = 0.0f;
+            state.m_distance_to_center = 0.0f;
+            state.m_sector             = QuadGraph::UNKNOWN_SECTOR;
+        }
+    }   // for i<num_karts
+
+    m_kart_at_position.resize(rank_world ? num_karts : 0);
+    for(unsigned int p=0; p<m_kart_at_position.size(); p++)
+    {
+        const AbstractKart *kart = rank_world->getKartAtPosition(p+1);
+        m_kart_at_position[p] = kart ? (int)kart->getWorldKartId() : -1;
+    }
+
+    m_max_player_distance = 0.0f;
+    if(!linear_world) return;
+    const unsigned int num_players = ProfileWorld::isProfileMode()
+                                   ? 0 : race_manager->getNumPlayers();
+    for(unsigned int i=0; i<num_players; i++)
+    {
+        const unsigned int kart_id =
+            world->getPlayerKart(i)->getWorldKartId();
+        if(m_karts[kart_id].m_overall_distance>m_max_player_distance)
+            m_max_player_distance = m_karts[kart_id].m_overall_distance;
+    }
+}   // update
@@ -0,0 +1,107 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_RACE_SNAPSHOT_HPP
+#define HEADER_RACE_SNAPSHOT_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/vec3.hpp"
+
+#include <assert.h>
+#include <vector>
+
+class World;
+
+/** A snapshot of the state of all karts that the AI controllers need, taken
+ *  once per frame in World::update() after the physics, before the karts
+ *  (and therefore their controllers) are updated. Ranks, distances along
+ *  the track and sectors are only changed after all karts are updated, so
+ *  they are identical to the values in the world during the kart updates.
+ *  Using the snapshot avoids repeating the same world queries in each
+ *  controller, and since the snapshot is not modified during the kart
+ *  updates it can safely be read by controllers updated in parallel.
+ *  Positions and velocities are the values after the physics step, i.e.
+ *  they do not include changes done by the kart updates.
+ * \ingroup modes
+ */
+class RaceSnapshot : public NoCopy
+{
+public:
+    /** The state of one kart. */
+    struct KartState
+    {
+        /** Position of the kart. */
+        Vec3  m_xyz;
+        /** Velocity of the kart. */
+        Vec3  m_velocity;
+        /** Distance along the track including all laps (0 if the world is
+         *  not a linear world). */
+        float m_overall_distance;
+        /** Distance of the kart from the center line of the track. */
+        float m_distance_to_center;
+        /** The graph node the kart is on, or QuadGraph::UNKNOWN_SECTOR. */
+        int   m_sector;
+        /** The rank of the kart. */
+        int   m_position;
+        /** True if the kart is eliminated. */
+        bool  m_is_eliminated;
+        /** True if the kart has finished the race. */
+        bool  m_has_finished;
+        // --------------------------------------------------------------------
+        /** Returns true if the kart is neither eliminated nor finished. */
+        bool isRacing() const { return !m_is_eliminated && !m_has_finished; }
+    };   // KartState
+
+private:
+    /** The state of each kart, indexed by world kart id. */
+    std::vector<KartState> m_karts;
+
+    /** The world kart id of the kart at each position (index 0 is
+     *  position 1), or -1 if no kart is at this position. */
+    std::vector<int>       m_kart_at_position;
+
+    /** The largest overall distance of all player karts (0 in profile
+     *  mode or if there are no player karts). */
+    float                  m_max_player_distance;
+
+public:
+                 RaceSnapshot();
+    void         update(const World *world);
+    // ------------------------------------------------------------------------
+    /** Returns the state of a kart.
+     *  \param kart_id World kart id of the kart. */
+    const KartState& getKart(unsigned int kart_id) const
+    {
+        assert(kart_id < m_karts.size());
+        return m_karts[kart_id];
+    }   // getKart
+    // ------------------------------------------------------------------------
+    /** Returns the world kart id of the kart at the given position, or -1
+     *  if there is no kart at that position. */
+    int getKartIdAtPosition(int position) const
+    {
+        if(position<1 || position>(int)m_kart_at_position.size())
+            return -1;
+        return m_kart_at_position[position-1];
+    }   // getKartIdAtPosition
+    // ------------------------------------------------------------------------
+    /** Returns the largest overall distance of all player karts. */
+    float getMaxPlayerDistance() const { return m_max_player_distance; }
+};   // RaceSnapshot
+
+#endif
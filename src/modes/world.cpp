@@ -42,6 +42,8 @@
 #include "karts/kart_properties_manager.hpp"
 #include "modes/overworld.hpp"
 #include "modes/profile_world.hpp"
+#include "modes/proximity_grid.hpp"
+#include "modes/race_snapshot.hpp"
 #include "modes/soccer_world.hpp"
 #include "network/network_config.hpp"
 #include "physics/btKart.hpp"
@@ -62,6 +64,7 @@
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
 #include "utils/constants.hpp"
+#include "utils/job_system.hpp"
 #include "utils/profiler.hpp"
 #include "utils/translation.hpp"
 #include "utils/string_utils.hpp"
@@ -117,6 +120,8 @@ World::World() : WorldStatus(), m_clear_color(255,100,101,140)
 #endif
 
     m_physics            = NULL;
+    m_proximity_grid     = NULL;
+    m_race_snapshot      = new RaceSnapshot();
     m_race_gui           = NULL;
     m_saved_race_gui     = NULL;
     m_use_highscores     = true;
@@ -185,6 +190,10 @@ void World::init()
     // karts can be positioned properly on (and not in) the tracks.
     m_track->loadTrackModel(race_manager->getReverseTrack());
 
+    const Vec3 *aabb_min, *aabb_max;
+    m_track->getAABB(&aabb_min, &aabb_max);
+    m_proximity_grid = new ProximityGrid(*aabb_min, *aabb_max);
+
     if (gk > 0)
     {
         ReplayPlay::get()->load();
@@ -249,6 +258,11 @@ void World::reset()
     m_schedule_pause = false;
     m_schedule_unpause = false;
 
+    // The karts will be moved, so a physics step that was started in the
+    // physics thread is not valid anymore.
+    if(m_physics)
+        m_physics->discardPipelinedStep();
+
     WorldStatus::reset();
     m_faster_music_active = false;
     m_eliminated_karts    = 0;
@@ -471,6 +485,8 @@ World::~World()
     // In case that the track is not found, m_physics is still undefined.
     if(m_physics)
         delete m_physics;
+    delete m_proximity_grid;
+    delete m_race_snapshot;
 
     m_world = NULL;
 
@@ -994,11 +1010,17 @@ void World::update(float dt)
     }
 #endif
 
+    // A pipelined physics step started by the main loop must be finished
+    // before anything (history, replay recorder, scripts, race start)
+    // accesses the karts' physics state.
+    m_physics->waitForPipelinedStep();
+
     PROFILER_PUSH_CPU_MARKER("World::update (sub-updates)", 0x20, 0x7F, 0x00);
     history->update(dt);
     if(race_manager->isRecordingRace()) ReplayRecorder::get()->update(dt);
     if(history->replayHistory()) dt=history->getNextDelta();
     WorldStatus::update(dt);
+    if(race_manager->isWatchingReplay()) ReplayPlay::get()->update();
     if (m_script_engine) m_script_engine->update(dt);
     PROFILER_POP_CPU_MARKER();
 
@@ -1007,7 +1029,23 @@ void World::update(float dt)
         m_physics->update(dt);
     }
 
+    PROFILER_PUSH_CPU_MARKER("World::update (Kart::updateParallel)", 0x30, 0x7F, 0x00);
+    JobSystem::get()->parallelFor((unsigned int)m_karts.size(),
+        [this, dt](unsigned int i)
+        {
+            if(!m_karts[i]->isEliminated()) m_karts[i]->updateParallel(dt);
+        });
+    PROFILER_POP_CPU_MARKER();
+
+    // The AI uses this to find karts and projectiles close to it.
+    m_proximity_grid->update(m_karts);
+    projectile_manager->addToProximityGrid(m_proximity_grid);
+    m_race_snapshot->update(this);
+
     PROFILER_PUSH_CPU_MARKER("World::update (Kart::upate)", 0x40, 0x7F, 0x00);
+    // The poses of all ghost karts are interpolated at once.
+    if(race_manager->hasGhostKarts() && ReplayPlay::get())
+        ReplayPlay::get()->updateGhostPoses(dt);
     const int kart_amount = (int)m_karts.size();
     for (int i = 0 ; i < kart_amount; ++i)
     {
@@ -42,6 +42,8 @@ class btRigidBody;
 class Controller;
 class PhysicalObject;
 class Physics;
+class ProximityGrid;
+class RaceSnapshot;
 class Track;
 
 namespace Scripting
@@ -97,6 +99,12 @@ protected:
     RandomGenerator           m_random;
 
     Physics*      m_physics;
+    /** Stores which karts and projectiles are close to each other. It is
+     *  rebuilt once per frame before the karts are updated, so positions
+     *  changed during the kart updates are only seen in the next frame. */
+    ProximityGrid* m_proximity_grid;
+    /** The state of all karts as seen by the AI, taken once per frame. */
+    RaceSnapshot* m_race_snapshot;
     bool          m_force_disable_fog;
     AbstractKart* m_fastest_kart;
     /** Number of eliminated karts. */
@@ -319,6 +327,12 @@ public:
     /** Returns a pointer to the physics. */
     Physics        *getPhysics() const { return m_physics; }
     // ------------------------------------------------------------------------
+    /** Returns the grid to find karts and projectiles close to a point. */
+    ProximityGrid  *getProximityGrid() const { return m_proximity_grid; }
+    // ------------------------------------------------------------------------
+    /** Returns the snapshot of all karts taken before updating the karts. */
+    const RaceSnapshot *getRaceSnapshot() const { return m_race_snapshot; }
+    // ------------------------------------------------------------------------
     /** Returns a pointer to the track. */
     Track          *getTrack() const { return m_track; }
     // ------------------------------------------------------------------------
@@ -35,12 +35,14 @@
 #include "physics/btKart.hpp"
 #include "physics/irr_debug_drawer.hpp"
 #include "physics/physical_object.hpp"
+#include "physics/physics_benchmark.hpp"
 #include "physics/stk_dynamics_world.hpp"
 #include "physics/triangle_mesh.hpp"
 #include "race/race_manager.hpp"
 #include "scriptengine/script_engine.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_object.hpp"
+#include "utils/log.hpp"
 #include "utils/profiler.hpp"
 
 // ----------------------------------------------------------------------------
@@ -51,6 +53,12 @@ Physics::Physics() : btSequentialImpulseConstraintSolver()
 {
     m_collision_conf      = new btDefaultCollisionConfiguration();
     m_dispatcher          = new btCollisionDispatcher(m_collision_conf);
+    m_step_thread         = NULL;
+    m_step_state          = STEP_IDLE;
+    m_step_dt             = 0.0f;
+    m_defer_crashes       = false;
+    pthread_mutex_init(&m_step_mutex, NULL);
+    pthread_cond_init(&m_step_cond, NULL);
 }   // Physics
 
 //-----------------------------------------------------------------------------
@@ -78,6 +86,19 @@ void Physics::init(const Vec3 &world_min, const Vec3 &world_max)
 //-----------------------------------------------------------------------------
 Physics::~Physics()
 {
+    if(m_step_thread)
+    {
+        discardPipelinedStep();
+        pthread_mutex_lock(&m_step_mutex);
+        m_step_state = STEP_QUIT;
+        pthread_cond_signal(&m_step_cond);
+        pthread_mutex_unlock(&m_step_mutex);
+        pthread_join(*m_step_thread, NULL);
+        delete m_step_thread;
+    }
+    pthread_cond_destroy(&m_step_cond);
+    pthread_mutex_destroy(&m_step_mutex);
+
     delete m_debug_drawer;
     delete m_dynamics_world;
     delete m_axis_sweep;
@@ -94,6 +115,7 @@ Physics::~Physics()
  */
 void Physics::addKart(const AbstractKart *kart)
 {
+    waitForPipelinedStep();
     const btCollisionObjectArray &all_objs =
         m_dynamics_world->getCollisionObjectArray();
     for(unsigned int i=0; i<(unsigned int)all_objs.size(); i++)
@@ -128,6 +150,7 @@ void Physics::removeKart(const AbstractKart *kart)
     }
     else
     {
+        waitForPipelinedStep();
         m_dynamics_world->removeRigidBody(kart->getBody());
         m_dynamics_world->removeVehicle(kart->getVehicle());
     }
@@ -142,22 +165,44 @@ void Physics::update(float dt)
     PROFILER_PUSH_CPU_MARKER("Physics", 0, 0, 0);
 
     m_physics_loop_active = true;
-    // Bullet can report the same collision more than once (up to 4
-    // contact points per collision). Additionally, more than one internal
-    // substep might be taken, resulting in potentially even more
-    // duplicates. To handle this, all collisions (i.e. pair of objects)
-    // are stored in a vector, but only one entry per collision pair
-    // of objects.
-    m_all_collisions.clear();
-
-    // Maximum of three substeps. This will work for framerate down to
-    // 20 FPS (bullet default frequency is 60 HZ).
-    m_dynamics_world->stepSimulation(dt, 3);
+    if(consumePipelinedStep())
+    {
+        // The time step was already done in the physics thread while the
+        // previous frame was rendered (using the previous dt). Only the
+        // crashes with the track detected there still need to be handled.
+        for(unsigned int i=0; i<m_deferred_crashes.size(); i++)
+        {
+            const TrackCrash &c = m_deferred_crashes[i];
+            if(c.m_kart)
+                c.m_kart->crashed(c.m_material, c.m_normal);
+            else
+                c.m_object->hit(c.m_material, c.m_normal);
+        }
+        m_deferred_crashes.clear();
+    }
+    else
+    {
+        // Bullet can report the same collision more than once (up to 4
+        // contact points per collision). Additionally, more than one
+        // internal substep might be taken, resulting in potentially even
+        // more duplicates. To handle this, all collisions (i.e. pair of
+        // objects) are stored in a vector, but only one entry per
+        // collision pair of objects.
+        m_all_collisions.clear();
+
+        // Maximum of three substeps. This will work for framerate down to
+        // 20 FPS (bullet default frequency is 60 HZ).
+        PhysicsBenchmark::ScopedTimer timer(PhysicsBenchmark::PHASE_STEP);
+        m_dynamics_world->stepSimulation(dt, 3);
+    }
 
     // Now handle the actual collision. Note: flyables can not be removed
     // inside of this loop, since the same flyables might hit more than one
     // other object. So only a flag is set in the flyables, the actual
     // clean up is then done later in the projectile manager.
+    // The benchmark time for this phase includes removing the karts below.
+    PhysicsBenchmark::ScopedTimer collision_timer(
+                                       PhysicsBenchmark::PHASE_COLLISIONS);
     std::vector<CollisionPair>::iterator p;
     for(p=m_all_collisions.begin(); p!=m_all_collisions.end(); ++p)
     {
@@ -350,6 +395,175 @@ void Physics::update(float dt)
     PROFILER_POP_CPU_MARKER();
 }   // update
 
+//-----------------------------------------------------------------------------
+/** Starts the bullet time step for the next frame in a separate thread. This
+ *  is called by the main loop just before rendering, so the physics of the
+ *  next frame are computed while the current frame is rendered (which only
+ *  uses the scene nodes, i.e. the copy of all transforms that was made in
+ *  Moveable::update). The next call to update() waits for this step to
+ *  finish and then handles the collisions as usual. Since the dt of the
+ *  next frame is not known yet, the dt of the current frame is used.
+ *  Any function that modifies the physics world from the main thread must
+ *  call waitForPipelinedStep() first.
+ *  \param dt Time step size.
+ */
+void Physics::startPipelinedStep(float dt)
+{
+    // The debug drawer accesses the physics world while rendering.
+    if(m_debug_drawer->debugEnabled()) return;
+
+    if(!m_step_thread)
+    {
+        m_step_thread = new pthread_t();
+        int error = pthread_create(m_step_thread, NULL, &Physics::stepThread,
+                                   this);
+        if(error)
+        {
+            Log::error("Physics", "Could not create thread, error=%d.",
+                       error);
+            delete m_step_thread;
+            m_step_thread = NULL;
+            return;
+        }
+    }
+
+    pthread_mutex_lock(&m_step_mutex);
+    // If the last step was not consumed yet (e.g. the race is paused),
+    // there is nothing to do.
+    if(m_step_state==STEP_IDLE)
+    {
+        m_all_collisions.clear();
+        m_deferred_crashes.clear();
+        m_defer_crashes = true;
+        m_step_dt       = dt;
+        m_step_state    = STEP_REQUESTED;
+        pthread_cond_signal(&m_step_cond);
+    }
+    pthread_mutex_unlock(&m_step_mutex);
+}   // startPipelinedStep
+
+//-----------------------------------------------------------------------------
+/** Waits till a time step done in the physics thread is finished. The
+ *  results of the step are kept and will be used in the next update().
+ */
+void Physics::waitForPipelinedStep()
+{
+    if(!m_step_thread) return;
+    pthread_mutex_lock(&m_step_mutex);
+    while(m_step_state==STEP_REQUESTED)
+        pthread_cond_wait(&m_step_cond, &m_step_mutex);
+    pthread_mutex_unlock(&m_step_mutex);
+}   // waitForPipelinedStep
+
+//-----------------------------------------------------------------------------
+/** Waits till a time step done in the physics thread is finished, and
+ *  discards its collisions. This is used when the world is reset, since the
+ *  collisions might not be valid anymore.
+ */
+void Physics::discardPipelinedStep()
+{
+    if(consumePipelinedStep())
+    {
+        m_all_collisions.clear();
+        m_deferred_crashes.clear();
+    }
+}   // discardPipelinedStep
+
+//-----------------------------------------------------------------------------
+/** Waits till a time step done in the physics thread is finished, and marks
+ *  it as consumed.
+ *  \return True if a step was done in the physics thread.
+ */
+bool Physics::consumePipelinedStep()
+{
+    if(!m_step_thread) return false;
+    waitForPipelinedStep();
+    pthread_mutex_lock(&m_step_mutex);
+    bool done       = m_step_state==STEP_DONE;
+    m_step_state    = STEP_IDLE;
+    m_defer_crashes = false;
+    pthread_mutex_unlock(&m_step_mutex);
+    return done;
+}   // consumePipelinedStep
+
+//-----------------------------------------------------------------------------
+/** The main loop of the physics thread: waits for a step to be requested,
+ *  and then does the bullet time step.
+ *  \param obj Pointer to the physics object.
+ */
+void *Physics::stepThread(void *obj)
+{
+    Physics *me = (Physics*)obj;
+    pthread_mutex_lock(&me->m_step_mutex);
+    while(true)
+    {
+        while(me->m_step_state!=STEP_REQUESTED &&
+              me->m_step_state!=STEP_QUIT          )
+            pthread_cond_wait(&me->m_step_cond, &me->m_step_mutex);
+        if(me->m_step_state==STEP_QUIT)
+            break;
+
+        float dt = me->m_step_dt;
+        pthread_mutex_unlock(&me->m_step_mutex);
+        {
+            PhysicsBenchmark::ScopedTimer timer(PhysicsBenchmark::PHASE_STEP);
+            me->m_dynamics_world->stepSimulation(dt, 3);
+        }
+        pthread_mutex_lock(&me->m_step_mutex);
+
+        me->m_step_state = STEP_DONE;
+        pthread_cond_broadcast(&me->m_step_cond);
+    }   // while true
+    pthread_mutex_unlock(&me->m_step_mutex);
+    return NULL;
+}   // stepThread
+
+//-----------------------------------------------------------------------------
+/** Handles a kart hitting the track. If the physics is stepped in the
+ *  physics thread, the crash is stored and handled in the next update().
+ *  \param kart The kart that crashed.
+ *  \param m The material that was hit (or NULL).
+ *  \param normal The normal of the hit surface.
+ */
+void Physics::kartHitTrack(AbstractKart *kart, const Material *m,
+                           const Vec3 &normal)
+{
+    if(!m_defer_crashes)
+    {
+        kart->crashed(m, normal);
+        return;
+    }
+    TrackCrash c;
+    c.m_kart     = kart;
+    c.m_object   = NULL;
+    c.m_material = m;
+    c.m_normal   = normal;
+    m_deferred_crashes.push_back(c);
+}   // kartHitTrack
+
+//-----------------------------------------------------------------------------
+/** Handles a physical object hitting the track. If the physics is stepped in
+ *  the physics thread, the hit is stored and handled in the next update().
+ *  \param obj The physical object.
+ *  \param m The material that was hit (or NULL).
+ *  \param normal The normal of the hit surface.
+ */
+void Physics::objectHitTrack(PhysicalObject *obj, const Material *m,
+                             const Vec3 &normal)
+{
+    if(!m_defer_crashes)
+    {
+        obj->hit(m, normal);
+        return;
+    }
+    TrackCrash c;
+    c.m_kart     = NULL;
+    c.m_object   = obj;
+    c.m_material = m;
+    c.m_normal   = normal;
+    m_deferred_crashes.push_back(c);
+}   // objectHitTrack
+
 //-----------------------------------------------------------------------------
 /** Handles the special case of two karts colliding with each other, which
  *  means that bombs must be passed on. If both karts have a bomb, they'll
@@ -504,6 +718,7 @@ btScalar Physics::solveGroup(btCollisionObject** bodies, int numBodies,
                              btStackAlloc* stackAlloc,
                              btDispatcher* dispatcher)
 {
+    PhysicsBenchmark::ScopedTimer timer(PhysicsBenchmark::PHASE_SOLVE_GROUP);
     btScalar returnValue=
         btSequentialImpulseConstraintSolver::solveGroup(bodies, numBodies,
                                                         manifold, numManifolds,
@@ -555,7 +770,7 @@ btScalar Physics::solveGroup(btCollisionObject** bodies, int numBodies,
                 // always has the kart as object A, not B.
                 const btVector3 &normal = -contact_manifold->getContactPoint(0)
                                                             .m_normalWorldOnB;
-                kart->crashed(m, normal);
+                kartHitTrack(kart, m, normal);
             }
             else if(upB->is(UserPointer::UP_PHYSICAL_OBJECT))
             {
@@ -573,7 +788,8 @@ btScalar Physics::solveGroup(btCollisionObject** bodies, int numBodies,
                         : NULL;
                     const btVector3 &normal = contact_manifold->getContactPoint(i)
                         .m_normalWorldOnB;
-                    upA->getPointerPhysicalObject()->hit(m, normal);
+                    objectHitTrack(upA->getPointerPhysicalObject(), m,
+                                   normal);
                 }   // for i in getNumContacts()
             }   // upB is physical object
         }   // upA is track
@@ -590,7 +806,7 @@ btScalar Physics::solveGroup(btCollisionObject** bodies, int numBodies,
                            : NULL;
                 const btVector3 &normal = contact_manifold->getContactPoint(0)
                                                            .m_normalWorldOnB;
-                kart->crashed(m, normal);   // Kart hit track
+                kartHitTrack(kart, m, normal);   // Kart hit track
             }
             else if(upB->is(UserPointer::UP_FLYABLE))
                 // 2.1 projectile hits kart
@@ -615,7 +831,7 @@ btScalar Physics::solveGroup(btCollisionObject** bodies, int numBodies,
                     AbstractKart *kart = upA->getPointerKart();
                     const btVector3 &normal = contact_manifold->getContactPoint(0)
                         .m_normalWorldOnB;
-                    kart->crashed((Material*)NULL, normal);
+                    kartHitTrack(kart, NULL, normal);
                 }   // isStatiObject
             }
             else if(upB->is(UserPointer::UP_ANIMATION))
@@ -669,7 +885,8 @@ btScalar Physics::solveGroup(btCollisionObject** bodies, int numBodies,
                         : NULL;
                     const btVector3 &normal = contact_manifold->getContactPoint(i)
                                              .m_normalWorldOnB;
-                    upA->getPointerPhysicalObject()->hit(m, normal);
+                    objectHitTrack(upA->getPointerPhysicalObject(), m,
+                                   normal);
                 }   // for i in getNumContacts()
             }   // upB is track
         }   // upA is physical object
@@ -692,6 +909,7 @@ btScalar Physics::solveGroup(btCollisionObject** bodies, int numBodies,
  */
 void Physics::draw()
 {
+    waitForPipelinedStep();
     if(!m_debug_drawer->debugEnabled() ||
         !World::getWorld()->isRacePhase()) return;
 
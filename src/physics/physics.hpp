@@ -24,6 +24,7 @@
   * Contains various physics utilities.
   */
 
+#include <pthread.h>
 #include <set>
 #include <vector>
 
@@ -34,6 +35,8 @@
 #include "physics/user_pointer.hpp"
 
 class AbstractKart;
+class Material;
+class PhysicalObject;
 class STKDynamicsWorld;
 class Vec3;
 
@@ -48,11 +51,9 @@ private:
      *  substep might be taken, resulting in potentially even more
      *  duplicates. To handle this, all collisions (i.e. pair of objects)
      *  are stored in a vector, but only one entry per collision pair
-     *  of objects.
-     *  While this is a natural application of std::set, the set has some
-     *  overhead (since it will likely use a tree to sort the entries).
-     *  Considering that the number of collisions is usually rather small
-     *  a simple list and linear search is faster is is being used here. */
+     *  of objects. A small open addressing hash table (see CollisionList)
+     *  is used to find existing entries, since a linear search becomes
+     *  quadratic when many objects pile up at the same spot. */
     class CollisionPair {
     private:
         /** The user pointer of the objects involved in this collision. */
@@ -80,11 +81,21 @@ private:
         /** Tests if two collision pairs involve the same objects. This test
          *  is simplified (i.e. no test if p.b==a and p.a==b) since the
          *  elements are sorted. */
-        bool operator==(const CollisionPair &p)
+        bool operator==(const CollisionPair &p) const
         {
             return (p.m_up[0]==m_up[0] && p.m_up[1]==m_up[1]);
         }   // operator==
         // --------------------------------------------------------------------
+        /** Returns a hash value for the (ordered) pair of objects involved
+         *  in this collision. */
+        size_t getHash() const
+        {
+            size_t h = (size_t)m_up[0];
+            h ^= (size_t)m_up[1] + 0x9e3779b9 + (h<<6) + (h>>2);
+            // User pointers are aligned, so mix in the higher bits
+            return h ^ (h>>7) ^ (h>>15);
+        }   // getHash
+        // --------------------------------------------------------------------
         const UserPointer *getUserPointer(unsigned int n) const
         {
             assert(n<=1);
@@ -102,18 +113,89 @@ private:
 
     // ========================================================================
     // This class is the list of collision objects, where each collision
-    // pair is stored as most once.
+    // pair is stored as most once. The pairs are kept in the order in which
+    // they were reported (so collision handling stays deterministic), and
+    // an open addressing hash table with linear probing maps each pair to
+    // its index in the vector. Each slot is tagged with a generation
+    // counter, so clearing the table only requires incrementing the
+    // generation instead of touching all slots.
     class CollisionList : public std::vector<CollisionPair>
     {
     private:
-        void push_back(CollisionPair p) {
+        /** One slot of the hash table: the index of the pair in the
+         *  vector, and the generation in which this slot was written. */
+        struct Slot
+        {
+            unsigned int m_generation;
+            unsigned int m_index;
+        };
+        /** The hash table, its size is always a power of 2. */
+        std::vector<Slot> m_slots;
+
+        /** The current generation, slots with a different generation
+         *  are considered to be empty. */
+        unsigned int      m_generation;
+        // --------------------------------------------------------------------
+        /** Inserts the index of the pair at position n of the vector into
+         *  the hash table. The pair must not already be in the table. */
+        void insertIndex(unsigned int n)
+        {
+            size_t mask = m_slots.size()-1;
+            size_t i    = (*this)[n].getHash() & mask;
+            while(m_slots[i].m_generation==m_generation)
+                i = (i+1) & mask;
+            m_slots[i].m_generation = m_generation;
+            m_slots[i].m_index      = n;
+        }   // insertIndex
+        // --------------------------------------------------------------------
+        /** Doubles the size of the hash table and re-inserts all pairs. */
+        void grow()
+        {
+            size_t new_size = m_slots.size() < 8 ? 16 : 2*m_slots.size();
+            m_slots.clear();
+            // Value initialisation sets all generations to 0 (i.e. empty)
+            m_slots.resize(new_size);
+            m_generation = 1;
+            for(unsigned int i=0; i<size(); i++)
+                insertIndex(i);
+        }   // grow
+        // --------------------------------------------------------------------
+        void push_back(const CollisionPair &p)
+        {
+            // Keep the load factor below 1/2, so probe sequences stay short
+            if(2*(size()+1) > m_slots.size())
+                grow();
+
             // only add a pair if it's not already in there
-            for(iterator i=begin(); i!=end(); i++) {
-                if((*i)==p) return;
+            size_t mask = m_slots.size()-1;
+            size_t i    = p.getHash() & mask;
+            while(m_slots[i].m_generation==m_generation)
+            {
+                if((*this)[m_slots[i].m_index]==p) return;
+                i = (i+1) & mask;
             }
+            m_slots[i].m_generation = m_generation;
+            m_slots[i].m_index      = (unsigned int)size();
             std::vector<CollisionPair>::push_back(p);
         };  // push_back
     public:
+        CollisionList() : m_generation(1) {}
+        // --------------------------------------------------------------------
+        /** Removes all collision pairs. The hash table is invalidated by
+         *  starting a new generation, it is only wiped when the generation
+         *  counter wraps around. */
+        void clear()
+        {
+            std::vector<CollisionPair>::clear();
+            m_generation++;
+            if(m_generation==0)
+            {
+                for(unsigned int i=0; i<m_slots.size(); i++)
+                    m_slots[i].m_generation = 0;
+                m_generation = 1;
+            }
+        }   // clear
+        // --------------------------------------------------------------------
         /** Adds information about a collision to this vector. */
         void push_back(const UserPointer *a, const btVector3 &contact_point_a,
                        const UserPointer *b, const btVector3 &contact_point_b)
@@ -123,6 +205,51 @@ private:
     };  // CollisionList
     // ========================================================================
 
+    /** A collision of a kart or physical object with the track (or a
+     *  static object). In pipelined mode these are detected in the physics
+     *  thread, but can only be handled in the main thread, so they are
+     *  stored and handled at the beginning of the next update. */
+    struct TrackCrash
+    {
+        AbstractKart   *m_kart;
+        PhysicalObject *m_object;
+        const Material *m_material;
+        Vec3            m_normal;
+    };   // TrackCrash
+
+    // ========================================================================
+    /** The states of the pipelined physics step. */
+    enum PipelinedStepState
+    {
+        STEP_IDLE,         // No step is pending.
+        STEP_REQUESTED,    // The thread is (about to be) stepping.
+        STEP_DONE,         // A step is done, but not yet consumed.
+        STEP_QUIT          // The thread is requested to exit.
+    };
+
+    /** The thread that runs the bullet time step in pipelined mode,
+     *  or NULL if it was not (yet) created. */
+    pthread_t                       *m_step_thread;
+
+    /** Protects m_step_state and m_step_dt. */
+    pthread_mutex_t                  m_step_mutex;
+
+    /** Signals a change of m_step_state. */
+    pthread_cond_t                   m_step_cond;
+
+    /** The state of the pipelined physics step. */
+    PipelinedStepState               m_step_state;
+
+    /** The time step size for the step done in the thread. */
+    float                            m_step_dt;
+
+    /** True while the time step is done in the physics thread, which
+     *  means that crashes must be stored in m_deferred_crashes. */
+    bool                             m_defer_crashes;
+
+    /** Crashes with the track detected in the physics thread. */
+    std::vector<TrackCrash>          m_deferred_crashes;
+
     /** This flag is set while bullets time step processing is taking
     *  place. It is used to avoid altering data structures that might
     *  be used (e.g. removing a kart while a loop over all karts is
@@ -145,17 +272,35 @@ private:
     btDefaultCollisionConfiguration *m_collision_conf;
     CollisionList                    m_all_collisions;
 
+    static void *stepThread(void *obj);
+    bool  consumePipelinedStep();
+    void  kartHitTrack     (AbstractKart *kart, const Material *m,
+                            const Vec3 &normal);
+    void  objectHitTrack   (PhysicalObject *obj, const Material *m,
+                            const Vec3 &normal);
+
 public:
           Physics          ();
          ~Physics          ();
     void  init             (const Vec3 &min_world, const Vec3 &max_world);
     void  addKart          (const AbstractKart *k);
-    void  addBody          (btRigidBody* b) {m_dynamics_world->addRigidBody(b);}
+    void  addBody          (btRigidBody* b)
+    {
+        waitForPipelinedStep();
+        m_dynamics_world->addRigidBody(b);
+    }   // addBody
     void  removeKart       (const AbstractKart *k);
-    void  removeBody       (btRigidBody* b) {m_dynamics_world->removeRigidBody(b);}
+    void  removeBody       (btRigidBody* b)
+    {
+        waitForPipelinedStep();
+        m_dynamics_world->removeRigidBody(b);
+    }   // removeBody
     void  KartKartCollision(AbstractKart *ka, const Vec3 &contact_point_a,
                             AbstractKart *kb, const Vec3 &contact_point_b);
     void  update           (float dt);
+    void  startPipelinedStep(float dt);
+    void  waitForPipelinedStep();
+    void  discardPipelinedStep();
     void  draw             ();
     STKDynamicsWorld*
           getPhysicsWorld  () const {return m_dynamics_world;}
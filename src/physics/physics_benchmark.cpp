@@ -0,0 +1,108 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "physics/physics_benchmark.hpp"
+
+#include "modes/world.hpp"
+#include "tracks/track.hpp"
+#include "utils/log.hpp"
+
+#include <stdio.h>
+
+bool        PhysicsBenchmark::m_enabled = false;
+std::string PhysicsBenchmark::m_filename;
+double      PhysicsBenchmark::m_total[PHASE_COUNT];
+double      PhysicsBenchmark::m_max[PHASE_COUNT];
+int         PhysicsBenchmark::m_count[PHASE_COUNT];
+
+/** Names of the phases as used in the result file. */
+static const char *PHASE_NAMES[PhysicsBenchmark::PHASE_COUNT] =
+    { "broadphase", "narrowphase", "solve_group", "vehicles",
+      "collisions", "step" };
+
+// ----------------------------------------------------------------------------
+/** Enables the collection of physics timings.
+ *  \param filename Name of the file the results are appended to.
+ */
+void PhysicsBenchmark::enable(const std::string &filename)
+{
+    m_enabled  = true;
+    m_filename = filename;
+    reset();
+}   // enable
+
+// ----------------------------------------------------------------------------
+/** Discards all timings collected so far.
+ */
+void PhysicsBenchmark::reset()
+{
+    for(unsigned int i=0; i<PHASE_COUNT; i++)
+    {
+        m_total[i] = 0;
+        m_max[i]   = 0;
+        m_count[i] = 0;
+    }
+}   // reset
+
+// ----------------------------------------------------------------------------
+/** Adds one measurement to a phase.
+ *  \param phase The phase.
+ *  \param ms The time spent in this phase in ms.
+ */
+void PhysicsBenchmark::addTime(Phase phase, double ms)
+{
+    m_total[phase] += ms;
+    m_count[phase] ++;
+    if(ms>m_max[phase])
+        m_max[phase] = ms;
+}   // addTime
+
+// ----------------------------------------------------------------------------
+/** Appends the results to the benchmark file as CSV with the columns
+ *  track,karts,phase,calls,total_ms,average_ms,max_ms. A header line is
+ *  written if the file is empty. The collected timings are then reset.
+ */
+void PhysicsBenchmark::writeResults()
+{
+    if(!m_enabled) return;
+
+    FILE *fd = fopen(m_filename.c_str(), "a");
+    if(!fd)
+    {
+        Log::error("PhysicsBenchmark", "Can't open '%s' for writing.",
+                   m_filename.c_str());
+        return;
+    }
+    fseek(fd, 0, SEEK_END);
+    if(ftell(fd)==0)
+        fprintf(fd, "track,karts,phase,calls,total_ms,average_ms,max_ms\n");
+
+    World *world = World::getWorld();
+    const std::string track = world ? world->getTrack()->getIdent() : "";
+    const int num_karts     = world ? (int)world->getNumKarts() : 0;
+    for(unsigned int i=0; i<PHASE_COUNT; i++)
+    {
+        fprintf(fd, "%s,%d,%s,%d,%f,%f,%f\n", track.c_str(), num_karts,
+                PHASE_NAMES[i], m_count[i], m_total[i],
+                m_count[i]>0 ? m_total[i]/m_count[i] : 0.0, m_max[i]);
+    }
+    fclose(fd);
+    Log::info("PhysicsBenchmark", "Physics timings appended to '%s'.",
+              m_filename.c_str());
+    reset();
+}   // writeResults
@@ -0,0 +1,94 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_PHYSICS_BENCHMARK_HPP
+#define HEADER_PHYSICS_BENCHMARK_HPP
+
+#include <chrono>
+#include <string>
+
+/** Collects the time spent in the different phases of the physics
+ *  simulation. It is enabled with --physics-benchmark=file, typically
+ *  together with --no-graphics and either --history (karts driven by
+ *  recorded inputs) or --profile-laps/--profile-time (AI karts). At the
+ *  end of the run one CSV line per phase is appended to the file, so that
+ *  results of different runs and versions can be compared.
+ *  All functions must be called from the thread doing the physics step.
+ * \ingroup physics
+ */
+class PhysicsBenchmark
+{
+public:
+    /** The measured phases. */
+    enum Phase { PHASE_BROADPHASE,  PHASE_NARROWPHASE, PHASE_SOLVE_GROUP,
+                 PHASE_VEHICLES,    PHASE_COLLISIONS,  PHASE_STEP,
+                 PHASE_COUNT };
+
+    /** Measures the time from construction to destruction of an object
+     *  and adds it to the given phase (if benchmarking is enabled). */
+    class ScopedTimer
+    {
+    private:
+        Phase m_phase;
+        std::chrono::steady_clock::time_point m_start;
+    public:
+        ScopedTimer(Phase phase) : m_phase(phase)
+        {
+            if(m_enabled)
+                m_start = std::chrono::steady_clock::now();
+        }   // ScopedTimer
+        // --------------------------------------------------------------------
+        ~ScopedTimer()
+        {
+            if(!m_enabled) return;
+            std::chrono::duration<double, std::milli> t =
+                std::chrono::steady_clock::now() - m_start;
+            addTime(m_phase, t.count());
+        }   // ~ScopedTimer
+    };   // ScopedTimer
+
+private:
+    /** True if physics timings are collected. */
+    static bool        m_enabled;
+
+    /** Name of the file the results are appended to. */
+    static std::string m_filename;
+
+    /** Accumulated time for each phase in ms. */
+    static double      m_total[PHASE_COUNT];
+
+    /** Longest single measurement for each phase in ms. */
+    static double      m_max[PHASE_COUNT];
+
+    /** Number of measurements for each phase. */
+    static int         m_count[PHASE_COUNT];
+
+public:
+    static void enable(const std::string &filename);
+    static void reset();
+    static void addTime(Phase phase, double ms);
+    static void writeResults();
+    // ------------------------------------------------------------------------
+    /** Returns true if physics timings are collected. */
+    static bool isEnabled() { return m_enabled; }
+    // ------------------------------------------------------------------------
+    /** Returns the accumulated time of a phase in ms. */
+    static double getTotal(Phase phase) { return m_total[phase]; }
+};   // PhysicsBenchmark
+
+#endif
@@ -21,6 +21,8 @@
 
 #include "btBulletDynamicsCommon.h"
 
+#include "physics/physics_benchmark.hpp"
+
 class STKDynamicsWorld : public btDiscreteDynamicsWorld
 {
 public:
@@ -40,6 +42,46 @@ public:
      *  physics, which is important for replaying histories. */
     virtual void resetLocalTime() { m_localTime = 0; }
 
+    /** Broadphase: computes the overlapping pairs of bounding boxes. Only
+     *  overwritten to measure the time for the physics benchmark. */
+    virtual void computeOverlappingPairs()
+    {
+        PhysicsBenchmark::ScopedTimer timer(PhysicsBenchmark::PHASE_BROADPHASE);
+        btDiscreteDynamicsWorld::computeOverlappingPairs();
+    }   // computeOverlappingPairs
+
+    /** Updates the bounding boxes, then does the broadphase and the
+     *  narrowphase. The time of the broadphase is measured separately, so
+     *  it is subtracted here to get the narrowphase time. */
+    virtual void performDiscreteCollisionDetection()
+    {
+        if(!PhysicsBenchmark::isEnabled())
+        {
+            btDiscreteDynamicsWorld::performDiscreteCollisionDetection();
+            return;
+        }
+        const double broadphase =
+            PhysicsBenchmark::getTotal(PhysicsBenchmark::PHASE_BROADPHASE);
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+        btDiscreteDynamicsWorld::performDiscreteCollisionDetection();
+        std::chrono::duration<double, std::milli> t =
+            std::chrono::steady_clock::now() - start;
+        PhysicsBenchmark::addTime(PhysicsBenchmark::PHASE_NARROWPHASE,
+              t.count() - (PhysicsBenchmark::getTotal(
+                               PhysicsBenchmark::PHASE_BROADPHASE) - broadphase));
+    }   // performDiscreteCollisionDetection
+
+protected:
+    /** Updates all actions, i.e. the karts (including the raycasts of their
+     *  wheels). Only overwritten to measure the time for the physics
+     *  benchmark. */
+    virtual void updateActions(btScalar time_step)
+    {
+        PhysicsBenchmark::ScopedTimer timer(PhysicsBenchmark::PHASE_VEHICLES);
+        btDiscreteDynamicsWorld::updateActions(time_step);
+    }   // updateActions
+
 };   // STKDynamicsWorld
 #endif
 /* EOF */
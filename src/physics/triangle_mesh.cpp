@@ -375,3 +375,28 @@ bool TriangleMesh::castRay(const btVector3 &from, const btVector3 &to,
     return ray_callback.hasHit();
 
 }   // castRay
+
+// ----------------------------------------------------------------------------
+/** Returns a hash value (FNV-1a) of the coordinates of all triangles of this
+ *  mesh. This is used to detect if data cached for a track is still valid.
+ */
+uint32_t TriangleMesh::getHash() const
+{
+    uint32_t hash = 2166136261u;
+    for(unsigned int i=0; i<getNumTriangles(); i++)
+    {
+        btVector3 *p[3];
+        getTriangle(i, &p[0], &p[1], &p[2]);
+        for(unsigned int j=0; j<3; j++)
+        {
+            const unsigned char *c = (const unsigned char*)p[j]->m_floats;
+            for(unsigned int k=0; k<3*sizeof(btScalar); k++)
+            {
+                hash ^= c[k];
+                hash *= 16777619u;
+            }
+        }   // for j<3
+    }   // for i<getNumTriangles
+    return hash;
+}   // getHash
+
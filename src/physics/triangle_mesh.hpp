@@ -24,6 +24,7 @@
 
 #include "physics/user_pointer.hpp"
 #include "utils/aligned_array.hpp"
+#include "utils/types.hpp"
 
 class Material;
 
@@ -64,6 +65,13 @@ public:
     void removeCollisionObject();
     btVector3 getInterpolatedNormal(unsigned int index,
                                     const btVector3 &position) const;
+    uint32_t  getHash() const;
+    // ------------------------------------------------------------------------
+    /** Returns the number of triangles in this mesh. */
+    unsigned int getNumTriangles() const
+    {
+        return (unsigned int)m_triangleIndex2Material.size();
+    }   // getNumTriangles
     // ------------------------------------------------------------------------
     /** In case of physical objects of shape 'exact', the physical body is
      *  created outside of the mesh. Since raycasts need the body's world
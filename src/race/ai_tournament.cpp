@@ -0,0 +1,430 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "race/ai_tournament.hpp"
+
+#include "config/hardware_stats.hpp"
+#include "utils/command_line.hpp"
+#include "utils/job_system.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+
+// ----------------------------------------------------------------------------
+/** Parses a comma separated list of integers. Each entry can also be a
+ *  range 'a-b', which adds all numbers from a to b.
+ *  \param s The string to parse.
+ *  \param list The list to which the numbers are added.
+ *  \return False if the string contains an invalid entry.
+ */
+static bool parseIntList(const std::string &s, std::vector<int> *list)
+{
+    const std::vector<std::string> entries = StringUtils::split(s, ',');
+    for(unsigned int i=0; i<entries.size(); i++)
+    {
+        int from, to;
+        if(sscanf(entries[i].c_str(), "%d-%d", &from, &to)==2)
+        {
+            if(to<from) return false;
+            for(int n=from; n<=to; n++)
+                list->push_back(n);
+        }
+        else if(sscanf(entries[i].c_str(), "%d", &from)==1)
+            list->push_back(from);
+        else
+            return false;
+    }
+    return !list->empty();
+}   // parseIntList
+
+// ----------------------------------------------------------------------------
+/** Quotes a command line argument for system(), escaping the characters
+ *  that are special inside of double quotes.
+ */
+static std::string quote(const std::string &s)
+{
+    std::string result = "\"";
+#ifdef WIN32
+    // Backslashes are only special in front of a quote: they are doubled
+    // there, and the quote itself is escaped with a backslash.
+    unsigned int backslashes = 0;
+    for(unsigned int i=0; i<s.size(); i++)
+    {
+        if(s[i]=='\\')
+        {
+            backslashes++;
+            continue;
+        }
+        if(s[i]=='"')
+            result.append(2*backslashes+1, '\\');
+        else
+            result.append(backslashes, '\\');
+        backslashes = 0;
+        result += s[i];
+    }
+    // Backslashes in front of the closing quote must be doubled as well.
+    result.append(2*backslashes, '\\');
+#else
+    for(unsigned int i=0; i<s.size(); i++)
+    {
+        if(s[i]=='"' || s[i]=='\\' || s[i]=='$' || s[i]=='`')
+            result += '\\';
+        result += s[i];
+    }
+#endif
+    return result + "\"";
+}   // quote
+
+// ----------------------------------------------------------------------------
+/** Escapes a string for use in a JSON file.
+ */
+static std::string escapeJSON(const std::string &s)
+{
+    std::string result;
+    for(unsigned int i=0; i<s.size(); i++)
+    {
+        if(s[i]=='"' || s[i]=='\\')
+            result += '\\';
+        result += s[i];
+    }
+    return result;
+}   // escapeJSON
+
+// ============================================================================
+AITournament::AITournament()
+{
+    m_num_laps = 3;
+    m_num_jobs = -1;
+    m_report   = "tournament";
+}   // AITournament
+
+// ----------------------------------------------------------------------------
+/** Reads all tournament options from the command line and creates the list
+ *  of races. All remaining command line options are passed on to the race
+ *  processes.
+ *  \return False if an option was invalid.
+ */
+bool AITournament::parseCommandLine()
+{
+    std::string s;
+    std::vector<std::string> tracks;
+    if(CommandLine::has("--tournament-tracks", &s))
+        tracks = StringUtils::split(s, ',');
+    if(tracks.empty())
+    {
+        Log::error("AITournament",
+                   "No tracks specified, use --tournament-tracks=a,b,...");
+        return false;
+    }
+
+    std::vector<int> karts, difficulties, seeds;
+    if(!CommandLine::has("--tournament-karts", &s))
+        s = "4";
+    if(!parseIntList(s, &karts))
+    {
+        Log::error("AITournament", "Invalid number of karts '%s'.",
+                   s.c_str());
+        return false;
+    }
+    if(!CommandLine::has("--tournament-difficulties", &s))
+        s = "2";
+    if(!parseIntList(s, &difficulties))
+    {
+        Log::error("AITournament", "Invalid difficulties '%s'.", s.c_str());
+        return false;
+    }
+    if(!CommandLine::has("--tournament-seeds", &s))
+        s = "1";
+    if(!parseIntList(s, &seeds))
+    {
+        Log::error("AITournament", "Invalid seeds '%s'.", s.c_str());
+        return false;
+    }
+
+    CommandLine::has("--tournament-laps", &m_num_laps);
+    if(m_num_laps<1)
+    {
+        Log::error("AITournament", "Invalid number of laps %d.", m_num_laps);
+        return false;
+    }
+    if(!CommandLine::has("--tournament-jobs", &m_num_jobs))
+        m_num_jobs = HardwareStats::getNumProcessors();
+    if(m_num_jobs<1)
+        m_num_jobs = 1;
+    CommandLine::has("--tournament-report", &m_report);
+
+    m_arguments = CommandLine::getArgv();
+
+    for(unsigned int t=0; t<tracks.size(); t++)
+    {
+        for(unsigned int k=0; k<karts.size(); k++)
+        {
+            for(unsigned int d=0; d<difficulties.size(); d++)
+            {
+                for(unsigned int i=0; i<seeds.size(); i++)
+                {
+                    Race race;
+                    race.m_track        = tracks[t];
+                    race.m_num_karts    = karts[k];
+                    race.m_difficulty   = difficulties[d];
+                    race.m_seed         = seeds[i];
+                    race.m_process_time = 0;
+                    m_races.push_back(race);
+                }   // for i<seeds.size()
+            }   // for d<difficulties.size()
+        }   // for k<karts.size()
+    }   // for t<tracks.size()
+    return true;
+}   // parseCommandLine
+
+// ----------------------------------------------------------------------------
+/** Returns the name of a temporary file used by a race.
+ *  \param index Index of the race.
+ *  \param extension Extension of the file.
+ */
+std::string AITournament::getRaceFilename(unsigned int index,
+                                          const std::string &extension) const
+{
+    std::ostringstream name;
+    name << m_report << "-race" << index << "." << extension;
+    return name.str();
+}   // getRaceFilename
+
+// ----------------------------------------------------------------------------
+/** Runs one race in a separate process and reads its results. The output
+ *  of the race process is written to a log file, which is kept if the race
+ *  failed. This is called from the job system, so several races are run
+ *  at the same time.
+ *  \param index Index of the race to run.
+ */
+void AITournament::runRace(unsigned int index)
+{
+    Race &race = m_races[index];
+    const std::string result_file = getRaceFilename(index, "csv");
+    const std::string log_file    = getRaceFilename(index, "log");
+    remove(result_file.c_str());
+
+    std::ostringstream cmd;
+    cmd << quote(CommandLine::getExecName());
+    for(unsigned int i=0; i<m_arguments.size(); i++)
+        cmd << " " << quote(m_arguments[i]);
+    cmd << " --no-graphics --profile-laps=" << m_num_laps
+        << " " << quote("--track="+race.m_track)
+        << " --numkarts="  << race.m_num_karts
+        << " --difficulty=" << race.m_difficulty
+        << " --seed="      << race.m_seed
+        << " " << quote("--ai-tournament-result="+result_file)
+        << " > " << quote(log_file) << " 2>&1";
+    std::string command = cmd.str();
+#ifdef WIN32
+    // cmd.exe removes the first and last quote of the command line.
+    command = "\"" + command + "\"";
+#endif
+
+    StkTime::TimeType start = StkTime::getTimeSinceEpoch();
+    int status = system(command.c_str());
+    race.m_process_time = (int)(StkTime::getTimeSinceEpoch() - start);
+
+    readResults(index, result_file);
+    if(race.m_results.empty())
+    {
+        Log::warn("AITournament",
+                  "Race %d (%s, %d karts, difficulty %d, seed %d) failed "
+                  "with status %d, see '%s'.", index, race.m_track.c_str(),
+                  race.m_num_karts, race.m_difficulty, race.m_seed, status,
+                  log_file.c_str());
+        return;
+    }
+    remove(result_file.c_str());
+    remove(log_file.c_str());
+    Log::info("AITournament",
+              "Race %d (%s, %d karts, difficulty %d, seed %d) done in %ds.",
+              index, race.m_track.c_str(), race.m_num_karts,
+              race.m_difficulty, race.m_seed, race.m_process_time);
+}   // runRace
+
+// ----------------------------------------------------------------------------
+/** Reads the result file written by a race process. The first line of the
+ *  file contains the column names; it is kept as first result line, and
+ *  removed in run() once all races are done (since races are run in
+ *  parallel, m_columns can't be set here).
+ *  \param index Index of the race.
+ *  \param filename Name of the result file.
+ */
+void AITournament::readResults(unsigned int index,
+                               const std::string &filename)
+{
+    std::ifstream in(filename.c_str());
+    if(!in.good()) return;
+
+    std::string header;
+    if(!std::getline(in, header)) return;
+    std::string line;
+    while(std::getline(in, line))
+    {
+        if(!line.empty())
+            m_races[index].m_results.push_back(line);
+    }
+    if(m_races[index].m_results.empty()) return;
+    m_races[index].m_results.insert(m_races[index].m_results.begin(),
+                                    header);
+}   // readResults
+
+// ----------------------------------------------------------------------------
+/** Writes all results to <report>.json. For each race the parameters of the
+ *  race and the results of each kart are written. The lap times are written
+ *  as an array, all other numerical values as numbers.
+ */
+void AITournament::writeJSON() const
+{
+    const std::string filename = m_report+".json";
+    FILE *fd = fopen(filename.c_str(), "w");
+    if(!fd)
+    {
+        Log::error("AITournament", "Can't open '%s' for writing.",
+                   filename.c_str());
+        return;
+    }
+    fprintf(fd, "{\n  \"laps\": %d,\n  \"races\": [", m_num_laps);
+    for(unsigned int r=0; r<m_races.size(); r++)
+    {
+        const Race &race = m_races[r];
+        fprintf(fd, "%s\n    {\n", r>0 ? "," : "");
+        fprintf(fd, "      \"track\": \"%s\",\n",
+                escapeJSON(race.m_track).c_str());
+        fprintf(fd, "      \"karts\": %d,\n", race.m_num_karts);
+        fprintf(fd, "      \"difficulty\": %d,\n", race.m_difficulty);
+        fprintf(fd, "      \"seed\": %d,\n", race.m_seed);
+        fprintf(fd, "      \"status\": \"%s\",\n",
+                race.m_results.empty() ? "failed" : "ok");
+        fprintf(fd, "      \"process_time\": %d,\n", race.m_process_time);
+        fprintf(fd, "      \"results\": [");
+        for(unsigned int k=0; k<race.m_results.size(); k++)
+        {
+            const std::vector<std::string> values =
+                StringUtils::split(race.m_results[k], ',');
+            fprintf(fd, "%s\n        {", k>0 ? "," : "");
+            for(unsigned int c=0; c<m_columns.size(); c++)
+            {
+                const std::string value = c<values.size() ? values[c] : "";
+                fprintf(fd, "%s\"%s\": ", c>0 ? ", " : "",
+                        m_columns[c].c_str());
+                if(m_columns[c]=="lap_times")
+                {
+                    const std::vector<std::string> laps =
+                        StringUtils::split(value, ';');
+                    fprintf(fd, "[");
+                    for(unsigned int l=0; l<laps.size(); l++)
+                        fprintf(fd, "%s%s", l>0 ? ", " : "", laps[l].c_str());
+                    fprintf(fd, "]");
+                    continue;
+                }
+                char *end;
+                strtod(value.c_str(), &end);
+                if(!value.empty() && *end==0)
+                    fprintf(fd, "%s", value.c_str());
+                else
+                    fprintf(fd, "\"%s\"", escapeJSON(value).c_str());
+            }   // for c<m_columns.size()
+            fprintf(fd, "}");
+        }   // for k<race.m_results.size()
+        fprintf(fd, "%s]\n    }", race.m_results.empty() ? "" : "\n      ");
+    }   // for r<m_races.size()
+    fprintf(fd, "\n  ]\n}\n");
+    fclose(fd);
+    Log::info("AITournament", "Results written to '%s'.", filename.c_str());
+}   // writeJSON
+
+// ----------------------------------------------------------------------------
+/** Writes all results to <report>.csv, one line for each kart of each race,
+ *  starting with the columns track,karts,difficulty,seed,process_time
+ *  followed by the kart results. Failed races are not included.
+ */
+void AITournament::writeCSV() const
+{
+    const std::string filename = m_report+".csv";
+    FILE *fd = fopen(filename.c_str(), "w");
+    if(!fd)
+    {
+        Log::error("AITournament", "Can't open '%s' for writing.",
+                   filename.c_str());
+        return;
+    }
+    fprintf(fd, "track,karts,difficulty,seed,process_time");
+    for(unsigned int c=0; c<m_columns.size(); c++)
+        fprintf(fd, ",%s", m_columns[c].c_str());
+    fprintf(fd, "\n");
+    for(unsigned int r=0; r<m_races.size(); r++)
+    {
+        const Race &race = m_races[r];
+        for(unsigned int k=0; k<race.m_results.size(); k++)
+        {
+            fprintf(fd, "%s,%d,%d,%d,%d,%s\n", race.m_track.c_str(),
+                    race.m_num_karts, race.m_difficulty, race.m_seed,
+                    race.m_process_time, race.m_results[k].c_str());
+        }
+    }
+    fclose(fd);
+    Log::info("AITournament", "Results written to '%s'.", filename.c_str());
+}   // writeCSV
+
+// ----------------------------------------------------------------------------
+/** Runs all races of the tournament and writes the report.
+ *  \return The exit code for STK: 0 if all races were run successfully.
+ */
+int AITournament::run()
+{
+    if(!parseCommandLine())
+        return 1;
+
+    Log::info("AITournament", "Running %d races, %d at a time.",
+              (int)m_races.size(), m_num_jobs);
+    StkTime::TimeType start = StkTime::getTimeSinceEpoch();
+    JobSystem::create(m_num_jobs);
+    JobSystem::get()->parallelFor((unsigned int)m_races.size(),
+                                  [this](unsigned int i) { runRace(i); },
+                                  /*grain size*/1);
+    JobSystem::destroy();
+
+    // Remove the column names (stored as first result line by
+    // readResults) from all races.
+    unsigned int num_failed = 0;
+    for(unsigned int r=0; r<m_races.size(); r++)
+    {
+        std::vector<std::string> &results = m_races[r].m_results;
+        if(results.empty())
+        {
+            num_failed++;
+            continue;
+        }
+        if(m_columns.empty())
+            m_columns = StringUtils::split(results[0], ',');
+        results.erase(results.begin());
+    }
+    writeJSON();
+    writeCSV();
+    Log::info("AITournament", "%d races done in %ds, %d failed.",
+              (int)m_races.size(),
+              (int)(StkTime::getTimeSinceEpoch()-start), num_failed);
+    return num_failed==0 ? 0 : 1;
+}   // run
@@ -0,0 +1,93 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_AI_TOURNAMENT_HPP
+#define HEADER_AI_TOURNAMENT_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <string>
+#include <vector>
+
+/** Runs a batch of AI races, one for each combination of the selected
+ *  tracks, number of karts, difficulties and random seeds, and writes the
+ *  results of all races to a JSON and a CSV file. Since only one world can
+ *  exist in a process, each race is run in its own STK process (using
+ *  profile mode without graphics), and several of these processes are
+ *  started in parallel using the job system. Each race process writes its
+ *  results to a temporary file (see ProfileWorld::setResultFile()), which
+ *  is collected once all races are done.
+ *  All command line options not used by the tournament itself are passed
+ *  on to the race processes, so e.g. '--ai-racing-line' can be used to
+ *  compare AI variants.
+ * \ingroup race
+ */
+class AITournament : public NoCopy
+{
+private:
+    /** Information about one race of the tournament. */
+    struct Race
+    {
+        /** The track to use. */
+        std::string m_track;
+        /** Number of karts. */
+        int         m_num_karts;
+        /** The difficulty of the race. */
+        int         m_difficulty;
+        /** Seed for the random number generator. */
+        int         m_seed;
+        /** Real time in seconds used by the race process (including
+         *  loading). */
+        int         m_process_time;
+        /** The results of the race: one CSV line for each kart (in the
+         *  format written by ProfileWorld). Empty if the race failed. */
+        std::vector<std::string> m_results;
+    };   // Race
+
+    /** All races of the tournament. */
+    std::vector<Race>        m_races;
+
+    /** The column names of the result lines of a race. */
+    std::vector<std::string> m_columns;
+
+    /** Command line arguments passed on to each race process. */
+    std::vector<std::string> m_arguments;
+
+    /** Number of laps of each race. */
+    int                      m_num_laps;
+
+    /** Number of races to run in parallel. */
+    int                      m_num_jobs;
+
+    /** Name of the report files (without extension). */
+    std::string              m_report;
+
+    bool        parseCommandLine();
+    std::string getRaceFilename(unsigned int index,
+                                const std::string &extension) const;
+    void        runRace(unsigned int index);
+    void        readResults(unsigned int index, const std::string &filename);
+    void        writeJSON() const;
+    void        writeCSV() const;
+
+public:
+                AITournament();
+    int         run();
+};   // AITournament
+
+#endif
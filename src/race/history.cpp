@@ -18,24 +18,90 @@
 
 #include "race/history.hpp"
 
+#include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "io/file_manager.hpp"
+#include "main_loop.hpp"
 #include "modes/world.hpp"
 #include "karts/abstract_kart.hpp"
 #include "physics/physics.hpp"
+#include "physics/physics_benchmark.hpp"
 #include "race/race_manager.hpp"
 #include "tracks/track.hpp"
 #include "utils/constants.hpp"
 
 History* history = 0;
 
+namespace
+{
+    /** Identifies a binary history file. */
+    const char HISTORY_MAGIC[8] = { 'S', 'T', 'K', 'H', 'I', 'S', 'T', 0 };
+
+    /** Version of the binary history format. */
+    const uint32_t HISTORY_FORMAT_VERSION = 1;
+
+    /** Position (in m) and rotation (in radians) differences smaller than
+     *  this are not reported as divergence in verification mode. */
+    const float VERIFY_TOLERANCE = 0.001f;
+
+    // ------------------------------------------------------------------------
+    void appendU32(std::vector<char> *buffer, uint32_t value)
+    {
+        const char *p = (const char*)&value;
+        buffer->insert(buffer->end(), p, p + sizeof(value));
+    }   // appendU32
+
+    // ------------------------------------------------------------------------
+    void appendString(std::vector<char> *buffer, const std::string &s)
+    {
+        appendU32(buffer, (uint32_t)s.size());
+        buffer->insert(buffer->end(), s.begin(), s.end());
+    }   // appendString
+
+    // ------------------------------------------------------------------------
+    /** Reads a value from the header of a mapped binary history file.
+     *  \param p Current position, on return points after the value.
+     *  \param end End of the file.
+     *  \param value On return the value read.
+     *  \return False if the file ended.
+     */
+    bool readU32(const char **p, const char *end, uint32_t *value)
+    {
+        if (end - *p < (ptrdiff_t)sizeof(uint32_t)) return false;
+        memcpy(value, *p, sizeof(uint32_t));
+        *p += sizeof(uint32_t);
+        return true;
+    }   // readU32
+
+    // ------------------------------------------------------------------------
+    bool readString(const char **p, const char *end, std::string *s)
+    {
+        uint32_t size;
+        if (!readU32(p, end, &size) || end - *p < (ptrdiff_t)size)
+            return false;
+        s->assign(*p, size);
+        *p += size;
+        return true;
+    }   // readString
+}   // namespace
+
 //-----------------------------------------------------------------------------
 /** Initialises the history object and sets the mode to none.
  */
 History::History()
 {
-    m_replay_mode = HISTORY_NONE;
+    m_replay_mode           = HISTORY_NONE;
+    m_current               = -1;
+    m_wrapped               = false;
+    m_size                  = 0;
+    m_replay_deltas         = NULL;
+    m_replay_records        = NULL;
+    m_verify_file           = NULL;
+    m_max_position_error    = 0.0f;
+    m_max_rotation_error    = 0.0f;
+    m_first_divergent_frame = -1;
 }   // History
 
 //-----------------------------------------------------------------------------
@@ -61,8 +127,7 @@ void History::initRecording()
 }   // initRecording
 
 //-----------------------------------------------------------------------------
-/** Allocates memory for the history. This is used when recording as well
- *  as when replaying (since in replay the data is read into memory first).
+/** Allocates memory for recording the history.
  *  \param number_of_frames Maximum number of frames to store.
  */
 void History::allocateMemory(int number_of_frames)
@@ -127,47 +192,147 @@ void History::updateReplay(float dt)
 {
     m_current++;
     World *world = World::getWorld();
-    if(m_current>=(int)m_all_deltas.size())
+    if(m_current>=m_size)
     {
         Log::info("History", "Replay finished");
+        // When verifying, stop after one replay.
+        if(m_replay_mode==HISTORY_VERIFY)
+        {
+            finishVerification();
+            main_loop->abort();
+        }
+        // When benchmarking the physics, stop after one replay.
+        if(PhysicsBenchmark::isEnabled())
+        {
+            PhysicsBenchmark::writeResults();
+            main_loop->abort();
+        }
         m_current = 0;
         // Note that for physics replay all physics parameters
         // need to be reset, e.g. velocity, ...
         world->reset();
     }
+    else if(m_replay_mode==HISTORY_VERIFY)
+        verifyFrame();
+
     unsigned int num_karts = world->getNumKarts();
     for(unsigned k=0; k<num_karts; k++)
     {
         AbstractKart *kart = world->getKart(k);
-        unsigned int index=m_current*num_karts+k;
+        const HistoryRecord &r = m_replay_records[m_current*num_karts+k];
         if(m_replay_mode==HISTORY_POSITION)
         {
-            kart->setXYZ(m_all_xyz[index]);
-            kart->setRotation(m_all_rotations[index]);
+            kart->setXYZ(Vec3(r.m_xyz[0], r.m_xyz[1], r.m_xyz[2]));
+            kart->setRotation(btQuaternion(r.m_rotation[0], r.m_rotation[1],
+                                           r.m_rotation[2], r.m_rotation[3]));
         }
         else
         {
-            kart->setControls(m_all_controls[index]);
+            KartControl control;
+            control.m_steer = r.m_steer;
+            control.m_accel = r.m_accel;
+            control.setButtonsCompressed(char(r.m_buttons));
+            kart->setControls(control);
         }
     }
 }   // updateReplay
 
 //-----------------------------------------------------------------------------
-/** Saves the history stored in the internal data structures into a file called
- *  history.dat.
+/** Compares the simulated position and rotation of all karts with the
+ *  recorded values of the current frame (both are taken before the physics
+ *  of this frame are simulated), and writes the differences to
+ *  history_verify.csv.
  */
-void History::Save()
+void History::verifyFrame()
 {
-    FILE *fd = fopen("history.dat","w");
-    if(fd)
-        Log::info("History", "Saved in ./history.dat.");
-    else
+    if(!m_verify_file)
     {
-        std::string fn = file_manager->getUserConfigFile("history.dat");
-        fd = fopen(fn.c_str(), "w");
-        if(fd)
-            Log::info("History", "Saved in '%s'.", fn.c_str());
+        m_verify_file = fopen("history_verify.csv", "w");
+        if(!m_verify_file)
+            Log::warn("History", "Can't open history_verify.csv.");
+        else
+            fprintf(m_verify_file,
+                    "frame,kart,position_error,rotation_error\n");
     }
+
+    World *world = World::getWorld();
+    const unsigned int num_karts = world->getNumKarts();
+    for(unsigned int k=0; k<num_karts; k++)
+    {
+        const AbstractKart *kart = world->getKart(k);
+        const HistoryRecord &r   = m_replay_records[m_current*num_karts+k];
+        const Vec3 xyz(r.m_xyz[0], r.m_xyz[1], r.m_xyz[2]);
+        const btQuaternion q(r.m_rotation[0], r.m_rotation[1],
+                             r.m_rotation[2], r.m_rotation[3]);
+        const float position_error = (kart->getXYZ() - xyz).length();
+        const float dot = fabsf(kart->getVisualRotation().dot(q));
+        const float rotation_error = 2.0f*acosf(dot > 1.0f ? 1.0f : dot);
+
+        if(m_verify_file)
+            fprintf(m_verify_file, "%d,%d,%f,%f\n", m_current, k,
+                    position_error, rotation_error);
+        if(position_error > m_max_position_error)
+            m_max_position_error = position_error;
+        if(rotation_error > m_max_rotation_error)
+            m_max_rotation_error = rotation_error;
+        if(m_first_divergent_frame < 0 &&
+            (position_error > VERIFY_TOLERANCE ||
+             rotation_error > VERIFY_TOLERANCE))
+        {
+            m_first_divergent_frame = m_current;
+            Log::warn("History", "Kart %d diverges in frame %d: position "
+                      "error %f, rotation error %f.", k, m_current,
+                      position_error, rotation_error);
+        }
+    }   // for k
+}   // verifyFrame
+
+//-----------------------------------------------------------------------------
+/** Prints a summary of the verification and closes the report file. */
+void History::finishVerification()
+{
+    if(m_verify_file)
+    {
+        fclose(m_verify_file);
+        m_verify_file = NULL;
+    }
+    if(m_first_divergent_frame < 0)
+        Log::info("History", "Verification passed: %d frames reproduced.",
+                  m_size);
+    else
+        Log::info("History", "Verification failed: first divergence in "
+                  "frame %d of %d, max position error %f, max rotation "
+                  "error %f.", m_first_divergent_frame, m_size,
+                  m_max_position_error, m_max_rotation_error);
+}   // finishVerification
+
+//-----------------------------------------------------------------------------
+/** Opens history.dat in the current directory, or (if this fails) in the
+ *  config directory.
+ *  \param mode The mode for fopen.
+ *  \param name On return the name of the opened file.
+ *  \return The file, or NULL if it could not be opened.
+ */
+FILE* History::openHistoryFile(const char *mode, std::string *name) const
+{
+    *name = "history.dat";
+    FILE *fd = fopen(name->c_str(), mode);
+    if(fd) return fd;
+    *name = file_manager->getUserConfigFile("history.dat");
+    return fopen(name->c_str(), mode);
+}   // openHistoryFile
+
+//-----------------------------------------------------------------------------
+/** Saves the history stored in the internal data structures into a file called
+ *  history.dat. The file is binary: a header with the race information,
+ *  followed by the time step sizes of all frames and the HistoryRecord of
+ *  each kart in each frame, so that it can be replayed directly from a
+ *  memory mapped file (see loadBinary()).
+ */
+void History::Save()
+{
+    std::string name;
+    FILE *fd = openHistoryFile("wb", &name);
     if(!fd)
     {
         Log::info("History", "Can't open history.dat file for writing - can't save history.");
@@ -178,72 +343,180 @@ void History::Save()
 
     World *world   = World::getWorld();
     const int num_karts = world->getNumKarts();
-    fprintf(fd, "Version:  %s\n",   STK_VERSION);
-    fprintf(fd, "numkarts: %d\n",   num_karts);
-    fprintf(fd, "numplayers: %d\n", race_manager->getNumPlayers());
-    fprintf(fd, "difficulty: %d\n", race_manager->getDifficulty());
-    fprintf(fd, "reverse: %c\n", race_manager->getReverseTrack() ? 'y' : 'n');
-
-    fprintf(fd, "track: %s\n",      world->getTrack()->getIdent().c_str());
-
     assert(num_karts > 0);
 
-    int k;
-    for(k=0; k<num_karts; k++)
-    {
-        fprintf(fd, "model %d: %s\n",k, world->getKart(k)->getIdent().c_str());
-    }
-    fprintf(fd, "size:     %d\n", m_size);
-
-    int index = m_wrapped ? m_current : 0;
+    std::vector<char> header(HISTORY_MAGIC,
+                             HISTORY_MAGIC + sizeof(HISTORY_MAGIC));
+    appendU32(&header, HISTORY_FORMAT_VERSION);
+    appendString(&header, STK_VERSION);
+    appendU32(&header, num_karts);
+    appendU32(&header, race_manager->getNumPlayers());
+    appendU32(&header, race_manager->getDifficulty());
+    appendU32(&header, race_manager->getReverseTrack() ? 1 : 0);
+    appendString(&header, world->getTrack()->getIdent());
+    for(int k=0; k<num_karts; k++)
+        appendString(&header, world->getKart(k)->getIdent());
+    appendU32(&header, m_size);
+    // Align the following data, so that it can be accessed directly
+    while(header.size() % 8 != 0)
+        header.push_back(0);
+    fwrite(&header[0], 1, header.size(), fd);
+
+    // Start with the oldest frame if the buffer has wrapped around
+    const int first = m_wrapped ? (m_current+1) % m_size : 0;
+    std::vector<float> deltas(m_size);
     for(int i=0; i<m_size; i++)
-    {
-        fprintf(fd, "delta: %f\n",m_all_deltas[index]);
-        index=(index+1)%m_size;
-    }
+        deltas[i] = m_all_deltas[(first+i) % m_size];
+    if(m_size > 0)
+        fwrite(&deltas[0], sizeof(float), m_size, fd);
 
-    index = num_karts * (m_wrapped ? m_current : 0);
+    std::vector<HistoryRecord> records(num_karts);
     for(int i=0; i<m_size; i++)
     {
+        const int index = num_karts * ((first+i) % m_size);
         for(int k=0; k<num_karts; k++)
         {
-            fprintf(fd, "%f %f %d  %f %f %f  %f %f %f %f\n",
-                    m_all_controls[index+k].m_steer,
-                    m_all_controls[index+k].m_accel,
-                    m_all_controls[index+k].getButtonsCompressed(),
-                    m_all_xyz[index+k].getX(), m_all_xyz[index+k].getY(),
-                    m_all_xyz[index+k].getZ(),
-                    m_all_rotations[index+k].getX(),
-                    m_all_rotations[index+k].getY(),
-                    m_all_rotations[index+k].getZ(),
-                    m_all_rotations[index+k].getW()  );
-        }   // for i
-        index=(index+num_karts)%(num_karts*m_size);
-    }   // for k
-    fprintf(fd, "History file end.\n");
-    fclose(fd);
+            HistoryRecord &r   = records[k];
+            r.m_steer          = m_all_controls[index+k].m_steer;
+            r.m_accel          = m_all_controls[index+k].m_accel;
+            r.m_buttons        = m_all_controls[index+k].getButtonsCompressed();
+            r.m_xyz[0]         = m_all_xyz[index+k].getX();
+            r.m_xyz[1]         = m_all_xyz[index+k].getY();
+            r.m_xyz[2]         = m_all_xyz[index+k].getZ();
+            r.m_rotation[0]    = m_all_rotations[index+k].getX();
+            r.m_rotation[1]    = m_all_rotations[index+k].getY();
+            r.m_rotation[2]    = m_all_rotations[index+k].getZ();
+            r.m_rotation[3]    = m_all_rotations[index+k].getW();
+        }   // for k
+        fwrite(&records[0], sizeof(HistoryRecord), num_karts, fd);
+    }   // for i
+
+    if(fclose(fd) == 0)
+        Log::info("History", "Saved in '%s'.", name.c_str());
+    else
+        Log::error("History", "Could not write '%s'.", name.c_str());
 }   // Save
 
 //-----------------------------------------------------------------------------
-/** Loads a history from history.dat in the current directory.
+/** Loads a history from history.dat in the current directory (or the config
+ *  directory). Both the binary format and the old text format are supported.
  */
 void History::Load()
 {
-    char s[1024], s1[1024];
-    int  n;
+    std::string name;
+    FILE *fd = openHistoryFile("rb", &name);
+    if(!fd)
+        Log::fatal("History", "Could not open history.dat");
+    Log::info("History", "Reading '%s'.", name.c_str());
 
-    FILE *fd = fopen("history.dat","r");
-    if(fd)
-        Log::info("History", "Reading ./history.dat");
+    char magic[sizeof(HISTORY_MAGIC)];
+    if(fread(magic, 1, sizeof(magic), fd) == sizeof(magic) &&
+       memcmp(magic, HISTORY_MAGIC, sizeof(magic)) == 0)
+    {
+        fclose(fd);
+        if(!loadBinary(name))
+            Log::fatal("History", "Could not read '%s'.", name.c_str());
+    }
     else
     {
-        std::string fn = file_manager->getUserConfigFile("history.dat");
-        fd = fopen(fn.c_str(), "r");
-        if(fd)
-            Log::info("History", "Reading '%s'.", fn.c_str());
+        rewind(fd);
+        loadText(fd);
+        fclose(fd);
     }
-    if(!fd)
-        Log::fatal("History", "Could not open history.dat");
+    m_current = -1;
+}   // Load
+
+//-----------------------------------------------------------------------------
+/** Sets up the race manager with the information read from a history file,
+ *  and the kart identifiers in m_kart_ident.
+ */
+void History::setupRace(unsigned int num_karts, int num_players,
+                        int difficulty, bool reverse, const std::string &track)
+{
+    race_manager->setNumKarts(num_karts);
+    race_manager->setNumPlayers(num_players);
+    race_manager->setDifficulty((RaceManager::Difficulty)difficulty);
+    race_manager->setReverseTrack(reverse);
+    race_manager->setTrack(track);
+    // This value doesn't really matter, but should be defined, otherwise
+    // the racing phase can switch to 'ending'
+    race_manager->setNumLaps(10);
+    for(unsigned int i=0; i<m_kart_ident.size(); i++)
+    {
+        if(i<race_manager->getNumPlayers())
+            race_manager->setPlayerKart(i, m_kart_ident[i]);
+    }
+}   // setupRace
+
+//-----------------------------------------------------------------------------
+/** Maps a binary history file into memory. The time step sizes and records
+ *  are used directly from the mapped file, nothing is copied.
+ *  \param name Name of the history file.
+ *  \return False if the file is invalid.
+ */
+bool History::loadBinary(const std::string &name)
+{
+    if(!m_mapped_file.open(name))
+        return false;
+
+    const char *start = m_mapped_file.getData();
+    const char *end   = start + m_mapped_file.getSize();
+    const char *p     = start + sizeof(HISTORY_MAGIC);
+
+    uint32_t version, num_karts, num_players, difficulty, reverse, size;
+    std::string stk_version, track;
+    if(!readU32(&p, end, &version) || version != HISTORY_FORMAT_VERSION)
+    {
+        Log::error("History", "Unsupported history format.");
+        return false;
+    }
+    if(!readString(&p, end, &stk_version)  ||
+       !readU32(&p, end, &num_karts)        ||
+       !readU32(&p, end, &num_players)      ||
+       !readU32(&p, end, &difficulty)       ||
+       !readU32(&p, end, &reverse)          ||
+       !readString(&p, end, &track)           )
+        return false;
+    if(stk_version != STK_VERSION)
+        Log::warn("History", "History is version '%s', STK version is '%s'.",
+                  stk_version.c_str(), STK_VERSION);
+
+    m_kart_ident.clear();
+    for(unsigned int i=0; i<num_karts; i++)
+    {
+        std::string ident;
+        if(!readString(&p, end, &ident))
+            return false;
+        m_kart_ident.push_back(ident);
+    }
+    if(!readU32(&p, end, &size))
+        return false;
+    while((p - start) % 8 != 0)
+        p++;
+
+    const size_t data_size = size * sizeof(float)
+                           + size * num_karts * sizeof(HistoryRecord);
+    if(num_karts == 0 || p > end || (size_t)(end - p) < data_size)
+    {
+        Log::error("History", "History file is truncated.");
+        return false;
+    }
+
+    m_size           = size;
+    m_replay_deltas  = (const float*)p;
+    m_replay_records = (const HistoryRecord*)(p + size * sizeof(float));
+    setupRace(num_karts, num_players, difficulty, reverse != 0, track);
+    return true;
+}   // loadBinary
+
+//-----------------------------------------------------------------------------
+/** Loads a history file in the old text format.
+ *  \param fd The history file.
+ */
+void History::loadText(FILE *fd)
+{
+    char s[1024], s1[1024];
+    int  n;
 
     if (fgets(s, 1023, fd) == NULL)
         Log::fatal("History", "Could not read history.dat.");
@@ -259,54 +532,44 @@ void History::Load()
     unsigned int num_karts;
     if(sscanf(s, "numkarts: %u", &num_karts)!=1)
         Log::fatal("History", "No number of karts found in history file.");
-    race_manager->setNumKarts(num_karts);
 
+    int num_players;
     fgets(s, 1023, fd);
-    if(sscanf(s, "numplayers: %d",&n)!=1)
+    if(sscanf(s, "numplayers: %d",&num_players)!=1)
         Log::fatal("History", "No number of players found in history file.");
-    race_manager->setNumPlayers(n);
 
+    int difficulty;
     fgets(s, 1023, fd);
-    if(sscanf(s, "difficulty: %d",&n)!=1)
+    if(sscanf(s, "difficulty: %d",&difficulty)!=1)
         Log::fatal("History", "No difficulty found in history file.");
-    race_manager->setDifficulty((RaceManager::Difficulty)n);
-
 
     // Optional (not supported in older history files): include reverse
     fgets(s, 1023, fd);
-    char r;
+    char r = 'n';
     if (sscanf(s, "reverse: %c", &r) == 1)
-    {
         fgets(s, 1023, fd);
-        race_manager->setReverseTrack(r == 'y');
-    }
-
 
     if(sscanf(s, "track: %1023s",s1)!=1)
         Log::warn("History", "Track not found in history file.");
-    race_manager->setTrack(s1);
-    // This value doesn't really matter, but should be defined, otherwise
-    // the racing phase can switch to 'ending'
-    race_manager->setNumLaps(10);
+    const std::string track = s1;
 
+    m_kart_ident.clear();
     for(unsigned int i=0; i<num_karts; i++)
     {
         fgets(s, 1023, fd);
         if(sscanf(s, "model %d: %1023s",&n, s1) != 2)
             Log::fatal("History", "No model information for kart %d found.", i);
         m_kart_ident.push_back(s1);
-        if(i<race_manager->getNumPlayers())
-        {
-            race_manager->setPlayerKart(i, s1);
-        }
     }   // for i<nKarts
+    setupRace(num_karts, num_players, difficulty, r == 'y', track);
+
     // FIXME: The model information is currently ignored
     fgets(s, 1023, fd);
     if(sscanf(s,"size: %d",&m_size)!=1)
         Log::fatal("History", "Number of records not found in history file.");
 
-    allocateMemory(m_size);
-    m_current = -1;
+    m_all_deltas.resize(m_size);
+    m_loaded_records.resize(m_size*num_karts);
 
     for(int i=0; i<m_size; i++)
     {
@@ -318,23 +581,21 @@ void History::Load()
     {
         for(unsigned int k=0; k<num_karts; k++)
         {
-            unsigned int index = num_karts * i+k;
+            HistoryRecord &record = m_loaded_records[num_karts * i+k];
             fgets(s, 1023, fd);
-            int buttonsCompressed;
-            float x,y,z,rx,ry,rz,rw;
+            int buttonsCompressed = 0;
             sscanf(s, "%f %f %d  %f %f %f  %f %f %f %f\n",
-                    &m_all_controls[index].m_steer,
-                    &m_all_controls[index].m_accel,
+                    &record.m_steer,
+                    &record.m_accel,
                     &buttonsCompressed,
-                    &x, &y, &z,
-                    &rx, &ry, &rz, &rw
+                    &record.m_xyz[0], &record.m_xyz[1], &record.m_xyz[2],
+                    &record.m_rotation[0], &record.m_rotation[1],
+                    &record.m_rotation[2], &record.m_rotation[3]
                     );
-            m_all_xyz[index]       = Vec3(x,y,z);
-            m_all_rotations[index] = btQuaternion(rx,ry,rz,rw);
-            m_all_controls[index].setButtonsCompressed(char(buttonsCompressed));
+            record.m_buttons = buttonsCompressed;
         }   // for i
     }   // for k
-    fprintf(fd, "History file end.\n");
-    fclose(fd);
-}   // Load
 
+    m_replay_deltas  = m_size > 0 ? &m_all_deltas[0]     : NULL;
+    m_replay_records = m_size > 0 ? &m_loaded_records[0] : NULL;
+}   // loadText
@@ -24,10 +24,14 @@
 
 #include "LinearMath/btQuaternion.h"
 
+#include "io/mapped_file.hpp"
 #include "karts/controller/kart_control.hpp"
 #include "utils/aligned_array.hpp"
+#include "utils/types.hpp"
 #include "utils/vec3.hpp"
 
+#include <stdio.h>
+
 class Kart;
 
 /**
@@ -41,12 +45,28 @@ public:
      *  HISTORY_POSITION: replay the positions and orientations of the karts,
      *                    but don't simulate the physics.
      *  HISTORY_PHYSICS:  Simulate the phyics based on the recorded actions.
+     *  HISTORY_VERIFY:   Like HISTORY_PHYSICS, but compare the simulated
+     *                    positions and rotations with the recorded ones
+     *                    in each frame and report the differences.
      *  These values can be used together, e.g. HISTORY_POSITION|HISTORY_CONTROL
      */
     enum HistoryReplayMode { HISTORY_NONE     = 0,
                              HISTORY_POSITION = 1,
-                             HISTORY_PHYSICS  = 2 };
+                             HISTORY_PHYSICS  = 2,
+                             HISTORY_VERIFY   = 4 };
 private:
+    /** The data of one kart in one frame as stored in a binary history
+     *  file. All fields are 4 bytes, so the records can be used directly
+     *  from the memory mapped file. */
+    struct HistoryRecord
+    {
+        float   m_steer;
+        float   m_accel;
+        int32_t m_buttons;
+        float   m_xyz[3];
+        float   m_rotation[4];
+    };   // HistoryRecord
+
     /** maximum number of history events to store. */
     HistoryReplayMode          m_replay_mode;
 
@@ -76,9 +96,43 @@ private:
     /** The identities of the karts to use. */
     std::vector<std::string>  m_kart_ident;
 
+    /** The binary history file when replaying. */
+    MappedFile                 m_mapped_file;
+
+    /** The records of a text history file when replaying (a binary file
+     *  is used directly from m_mapped_file). */
+    std::vector<HistoryRecord> m_loaded_records;
+
+    /** The time step sizes when replaying, either in m_mapped_file or in
+     *  m_all_deltas. */
+    const float               *m_replay_deltas;
+
+    /** The records (num_karts for each frame) when replaying, either in
+     *  m_mapped_file or in m_loaded_records. */
+    const HistoryRecord       *m_replay_records;
+
+    /** The file the differences are written to in verification mode. */
+    FILE                      *m_verify_file;
+
+    /** Largest position and rotation difference found in verification
+     *  mode. */
+    float                      m_max_position_error;
+    float                      m_max_rotation_error;
+
+    /** First frame in which a difference was found in verification mode,
+     *  or -1. */
+    int                        m_first_divergent_frame;
+
     void  allocateMemory(int number_of_frames);
     void  updateSaving(float dt);
     void  updateReplay(float dt);
+    void  verifyFrame();
+    void  finishVerification();
+    FILE* openHistoryFile(const char *mode, std::string *name) const;
+    void  setupRace(unsigned int num_karts, int num_players, int difficulty,
+                    bool reverse, const std::string &track);
+    bool  loadBinary(const std::string &name);
+    void  loadText(FILE *fd);
 public:
           History        ();
     void  startReplay    ();
@@ -95,7 +149,7 @@ public:
     }
     // ------------------------------------------------------------------------
     /** Returns the size of the next timestep. */
-    float getNextDelta   () const { return m_all_deltas[m_current];         }
+    float getNextDelta   () const { return m_replay_deltas[m_current];      }
 
     // ------------------------------------------------------------------------
     /** Returns if a history is replayed, i.e. the history mode is not none. */
@@ -104,6 +158,14 @@ public:
     /** Enable replaying a history, enabled from the command line. */
     void  doReplayHistory(HistoryReplayMode m) {m_replay_mode = m;           }
     // ------------------------------------------------------------------------
+    /** Returns true if a history is replayed to verify that the physics
+     *  reproduce the recorded race. */
+    bool  isVerifying    () const { return m_replay_mode == HISTORY_VERIFY;  }
+    // ------------------------------------------------------------------------
+    /** Returns true if a difference to the recorded race was found in
+     *  verification mode. */
+    bool  hasDiverged    () const { return m_first_divergent_frame >= 0;     }
+    // ------------------------------------------------------------------------
     /** Returns true if the physics should not be simulated in replay mode.
      *  I.e. either no replay mode, or physics replay mode. */
     bool dontDoPhysics   () const { return m_replay_mode == HISTORY_POSITION;}
@@ -0,0 +1,308 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "replay/ghost_poses.hpp"
+
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#  include <xmmintrin.h>
+#  define GHOST_POSES_SSE
+#endif
+
+// ----------------------------------------------------------------------------
+/** Sets the number of ghosts.
+ *  \param num_ghosts Number of ghosts.
+ */
+void GhostPoses::resize(unsigned int num_ghosts)
+{
+    for (unsigned int c = 0; c < NUM_COMPONENTS; c++)
+    {
+        m_from[c].resize(num_ghosts);
+        m_to[c].resize(num_ghosts);
+        m_result[c].resize(num_ghosts);
+    }
+    m_delta.resize(num_ghosts);
+}   // resize
+
+// ----------------------------------------------------------------------------
+/** Sets the two frames between which a ghost is interpolated.
+ *  \param i Index of the ghost.
+ *  \param from_xyz, from_rotation The pose at the earlier frame.
+ *  \param to_xyz, to_rotation The pose at the later frame.
+ *  \param delta The interpolation factor, 0 for the earlier frame and 1
+ *         for the later frame.
+ */
+void GhostPoses::setFrames(unsigned int i, const Vec3 &from_xyz,
+                           const btQuaternion &from_rotation,
+                           const Vec3 &to_xyz,
+                           const btQuaternion &to_rotation, float delta)
+{
+    assert(i < m_delta.size());
+    m_from[0][i] = from_xyz.getX();
+    m_from[1][i] = from_xyz.getY();
+    m_from[2][i] = from_xyz.getZ();
+    m_from[3][i] = from_rotation.getX();
+    m_from[4][i] = from_rotation.getY();
+    m_from[5][i] = from_rotation.getZ();
+    m_from[6][i] = from_rotation.getW();
+    m_to[0][i]   = to_xyz.getX();
+    m_to[1][i]   = to_xyz.getY();
+    m_to[2][i]   = to_xyz.getZ();
+    m_to[3][i]   = to_rotation.getX();
+    m_to[4][i]   = to_rotation.getY();
+    m_to[5][i]   = to_rotation.getZ();
+    m_to[6][i]   = to_rotation.getW();
+    m_delta[i]   = delta;
+}   // setFrames
+
+// ----------------------------------------------------------------------------
+/** Interpolates the poses of the ghosts with index begin to end-1 one at a
+ *  time. This is used for the ghosts left over by the SSE version, or if
+ *  SSE is not available. The quaternion of the later frame is negated if
+ *  necessary so that the shorter way is used, as btQuaternion::slerp does.
+ *  \param begin Index of the first ghost.
+ *  \param end One more than the index of the last ghost.
+ */
+void GhostPoses::interpolateScalar(unsigned int begin, unsigned int end)
+{
+    for (unsigned int i = begin; i < end; i++)
+    {
+        const float t  = m_delta[i];
+        const float s0 = 1.0f - t;
+        for (unsigned int c = 0; c < 3; c++)
+            m_result[c][i] = s0 * m_from[c][i] + t * m_to[c][i];
+
+        float dot = 0.0f;
+        for (unsigned int c = 3; c < NUM_COMPONENTS; c++)
+            dot += m_from[c][i] * m_to[c][i];
+        const float s1 = dot < 0.0f ? -t : t;
+        float length2 = 0.0f;
+        for (unsigned int c = 3; c < NUM_COMPONENTS; c++)
+        {
+            m_result[c][i] = s0 * m_from[c][i] + s1 * m_to[c][i];
+            length2 += m_result[c][i] * m_result[c][i];
+        }
+        const float inv = 1.0f / std::sqrt(length2);
+        for (unsigned int c = 3; c < NUM_COMPONENTS; c++)
+            m_result[c][i] *= inv;
+    }
+}   // interpolateScalar
+
+// ----------------------------------------------------------------------------
+/** Interpolates the poses of all ghosts, four at a time if SSE is
+ *  available.
+ */
+void GhostPoses::interpolate()
+{
+    const unsigned int n = getNumGhosts();
+    unsigned int i = 0;
+#ifdef GHOST_POSES_SSE
+    const __m128 one       = _mm_set1_ps(1.0f);
+    const __m128 zero      = _mm_setzero_ps();
+    const __m128 sign_bit  = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 t  = _mm_loadu_ps(&m_delta[i]);
+        const __m128 s0 = _mm_sub_ps(one, t);
+        __m128 from[NUM_COMPONENTS], to[NUM_COMPONENTS];
+        for (unsigned int c = 0; c < NUM_COMPONENTS; c++)
+        {
+            from[c] = _mm_loadu_ps(&m_from[c][i]);
+            to[c]   = _mm_loadu_ps(&m_to[c][i]);
+        }
+        for (unsigned int c = 0; c < 3; c++)
+        {
+            _mm_storeu_ps(&m_result[c][i],
+                          _mm_add_ps(_mm_mul_ps(s0, from[c]),
+                                     _mm_mul_ps(t, to[c])));
+        }
+
+        __m128 dot = zero;
+        for (unsigned int c = 3; c < NUM_COMPONENTS; c++)
+            dot = _mm_add_ps(dot, _mm_mul_ps(from[c], to[c]));
+        // Negate t for the ghosts with a negative dot product
+        const __m128 s1 = _mm_xor_ps(t, _mm_and_ps(_mm_cmplt_ps(dot, zero),
+                                                   sign_bit));
+        __m128 q[NUM_COMPONENTS];
+        __m128 length2 = zero;
+        for (unsigned int c = 3; c < NUM_COMPONENTS; c++)
+        {
+            q[c] = _mm_add_ps(_mm_mul_ps(s0, from[c]),
+                              _mm_mul_ps(s1, to[c]));
+            length2 = _mm_add_ps(length2, _mm_mul_ps(q[c], q[c]));
+        }
+        const __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(length2));
+        for (unsigned int c = 3; c < NUM_COMPONENTS; c++)
+            _mm_storeu_ps(&m_result[c][i], _mm_mul_ps(q[c], inv));
+    }
+#endif
+    interpolateScalar(i, n);
+}   // interpolate
+
+// ----------------------------------------------------------------------------
+/** Compares the previous interpolation (one Vec3 interpolation and one
+ *  btQuaternion::slerp for each ghost, as GhostKart::update did) with the
+ *  batched interpolation, using 50 ghosts with synthetic recordings. It
+ *  also checks that the batched poses are close to the previous ones. The
+ *  results are printed to the log. This does not load a track or karts,
+ *  so the cost of the kart models and scene nodes is not included.
+ *  \return The exit code: 0 if all checks passed.
+ */
+int GhostPoses::runBenchmark()
+{
+    typedef std::chrono::steady_clock Clock;
+    const unsigned int NUM_GHOSTS = 50;
+    const unsigned int NUM_FRAMES = 2000;
+    const unsigned int NUM_STEPS  = 20000;
+    const float        FRAME_TIME = 0.05f;
+    const float        STEP_TIME  = 1.0f / 120.0f;
+    std::mt19937 random(12345);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    // The recordings: each ghost drives and turns randomly, by up to 10
+    // degrees between two frames.
+    std::vector<Vec3>         xyz(NUM_GHOSTS * NUM_FRAMES);
+    std::vector<btQuaternion> rotation(NUM_GHOSTS * NUM_FRAMES);
+    std::vector<float>        offset(NUM_GHOSTS);
+    for (unsigned int g = 0; g < NUM_GHOSTS; g++)
+    {
+        Vec3 position(100.0f * unit(random), 0, 100.0f * unit(random));
+        btQuaternion q(0, 0, 0, 1);
+        for (unsigned int f = 0; f < NUM_FRAMES; f++)
+        {
+            xyz[g * NUM_FRAMES + f]      = position;
+            rotation[g * NUM_FRAMES + f] = q;
+            position += Vec3(unit(random), 0.1f * unit(random), unit(random));
+            Vec3 axis(unit(random), unit(random), unit(random));
+            if (axis.length2() < 0.01f)
+                axis = Vec3(0, 1, 0);
+            q = q * btQuaternion(axis.normalized(), 0.175f * unit(random));
+            q.normalize();
+        }
+        offset[g] = 0.5f * (unit(random) + 1.0f) * FRAME_TIME * 100;
+    }
+
+    // The frame index and interpolation factor of a ghost at a time step.
+    const float max_time = (NUM_FRAMES - 1) * FRAME_TIME;
+    auto getFrame = [&](unsigned int g, unsigned int step, float *delta)
+    {
+        const float time = std::fmod(offset[g] + step * STEP_TIME, max_time);
+        const unsigned int f = std::min((unsigned int)(time / FRAME_TIME),
+                                        NUM_FRAMES - 2);
+        *delta = time / FRAME_TIME - f;
+        return g * NUM_FRAMES + f;
+    };
+
+    // The previous interpolation
+    float sum = 0.0f;
+    Clock::time_point start = Clock::now();
+    for (unsigned int s = 0; s < NUM_STEPS; s++)
+    {
+        for (unsigned int g = 0; g < NUM_GHOSTS; g++)
+        {
+            float rd;
+            const unsigned int i = getFrame(g, s, &rd);
+            const Vec3 p = (1 - rd) * xyz[i] + rd * xyz[i + 1];
+            const btQuaternion q = rotation[i].slerp(rotation[i + 1], rd);
+            sum += p.getX() + q.getW();
+        }
+    }
+    const double t_single =
+        std::chrono::duration<double, std::micro>(Clock::now() - start)
+        .count() / NUM_STEPS;
+
+    // The batched interpolation, including copying the results back.
+    GhostPoses poses;
+    poses.resize(NUM_GHOSTS);
+    start = Clock::now();
+    for (unsigned int s = 0; s < NUM_STEPS; s++)
+    {
+        for (unsigned int g = 0; g < NUM_GHOSTS; g++)
+        {
+            float rd;
+            const unsigned int i = getFrame(g, s, &rd);
+            poses.setFrames(g, xyz[i], rotation[i], xyz[i + 1],
+                            rotation[i + 1], rd);
+        }
+        poses.interpolate();
+        for (unsigned int g = 0; g < NUM_GHOSTS; g++)
+        {
+            const Vec3 p = poses.getXYZ(g);
+            const btQuaternion q = poses.getRotation(g);
+            sum -= p.getX() + q.getW();
+        }
+    }
+    const double t_batched =
+        std::chrono::duration<double, std::micro>(Clock::now() - start)
+        .count() / NUM_STEPS;
+
+    // Check the differences between the two interpolations.
+    float max_distance = 0.0f, max_angle = 0.0f;
+    for (unsigned int s = 0; s < NUM_STEPS; s += 7)
+    {
+        for (unsigned int g = 0; g < NUM_GHOSTS; g++)
+        {
+            float rd;
+            const unsigned int i = getFrame(g, s, &rd);
+            poses.setFrames(g, xyz[i], rotation[i], xyz[i + 1],
+                            rotation[i + 1], rd);
+        }
+        poses.interpolate();
+        for (unsigned int g = 0; g < NUM_GHOSTS; g++)
+        {
+            float rd;
+            const unsigned int i = getFrame(g, s, &rd);
+            const Vec3 p = (1 - rd) * xyz[i] + rd * xyz[i + 1];
+            const btQuaternion q = rotation[i].slerp(rotation[i + 1], rd);
+            max_distance = std::max(max_distance,
+                                    (p - poses.getXYZ(g)).length());
+            // Compute the angle in double, acos is very inaccurate close
+            // to 1 in float.
+            const btQuaternion r = poses.getRotation(g);
+            const double dot = std::min(1.0, std::fabs(
+                double(q.getX()) * r.getX() + double(q.getY()) * r.getY() +
+                double(q.getZ()) * r.getZ() + double(q.getW()) * r.getW()));
+            max_angle = std::max(max_angle, float(2.0 * std::acos(dot)));
+        }
+    }
+
+    Log::info("GhostPoses", "%d ghosts: per ghost %.3f us, batched %.3f us "
+              "per time step (checksum %f).", NUM_GHOSTS, t_single, t_batched,
+              sum);
+    max_angle *= 180.0f / 3.14159265f;
+    Log::info("GhostPoses", "Largest difference: %f m, %f degrees.",
+              max_distance, max_angle);
+    // The normalised linear interpolation of the rotation differs from the
+    // slerp by less than 0.1 degrees for rotations of up to 10 degrees
+    // between two frames.
+    if (max_distance > 0.001f || max_angle > 0.1f)
+    {
+        Log::error("GhostPoses", "The batched poses differ from the poses "
+                   "of the previous interpolation.");
+        return 1;
+    }
+    return 0;
+}   // runBenchmark
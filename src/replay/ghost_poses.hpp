@@ -0,0 +1,84 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_GHOST_POSES_HPP
+#define HEADER_GHOST_POSES_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/vec3.hpp"
+
+#include "LinearMath/btQuaternion.h"
+
+#include <vector>
+
+/** Interpolates the poses of all ghost karts in one pass. For each ghost
+ *  the two recorded frames around the current replay time are stored with
+ *  one array for each component (x, y, z and the four quaternion values),
+ *  so that four ghosts can be interpolated at once with SSE. The rotation
+ *  is interpolated linearly and normalised (instead of using a slerp),
+ *  which is very close for consecutive replay frames and does not need any
+ *  trigonometric functions.
+ * \ingroup replay
+ */
+class GhostPoses : public NoCopy
+{
+private:
+    /** Number of components of a pose: x, y, z, and the quaternion. */
+    enum { NUM_COMPONENTS = 7 };
+
+    /** The pose at the frame before the current time of each ghost. */
+    std::vector<float> m_from[NUM_COMPONENTS];
+
+    /** The pose at the frame after the current time of each ghost. */
+    std::vector<float> m_to[NUM_COMPONENTS];
+
+    /** The interpolated pose of each ghost. */
+    std::vector<float> m_result[NUM_COMPONENTS];
+
+    /** The interpolation factor (between 0 and 1) of each ghost. */
+    std::vector<float> m_delta;
+
+    void interpolateScalar(unsigned int begin, unsigned int end);
+
+public:
+    void         resize(unsigned int num_ghosts);
+    void         setFrames(unsigned int i, const Vec3 &from_xyz,
+                           const btQuaternion &from_rotation,
+                           const Vec3 &to_xyz,
+                           const btQuaternion &to_rotation, float delta);
+    void         interpolate();
+    static int   runBenchmark();
+    // ------------------------------------------------------------------------
+    /** Returns the interpolated position of a ghost. */
+    Vec3         getXYZ(unsigned int i) const
+    {
+        return Vec3(m_result[0][i], m_result[1][i], m_result[2][i]);
+    }   // getXYZ
+    // ------------------------------------------------------------------------
+    /** Returns the interpolated rotation of a ghost. */
+    btQuaternion getRotation(unsigned int i) const
+    {
+        return btQuaternion(m_result[3][i], m_result[4][i], m_result[5][i],
+                            m_result[6][i]);
+    }   // getRotation
+    // ------------------------------------------------------------------------
+    /** Returns the number of ghosts. */
+    unsigned int getNumGhosts() const { return (unsigned int)m_delta.size(); }
+};   // GhostPoses
+
+#endif
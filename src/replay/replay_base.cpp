@@ -18,6 +18,32 @@
 #include "replay/replay_base.hpp"
 
 #include "io/file_manager.hpp"
+#include "utils/types.hpp"
+
+#include <math.h>
+
+namespace
+{
+    /** Scaling factors used to quantise the values of a frame in the binary
+     *  replay format: time in ms, positions in 1/1024 m, quaternion
+     *  components in 1/32767, speed in 1/100 m/s, steering in 1/1024 and
+     *  suspension lengths in 1/4096 m. */
+    const float TIME_SCALE       = 1000.0f;
+    const float POSITION_SCALE   = 1024.0f;
+    const float ROTATION_SCALE   = 32767.0f;
+    const float SPEED_SCALE      = 100.0f;
+    const float STEER_SCALE      = 1024.0f;
+    const float SUSPENSION_SCALE = 4096.0f;
+
+    /** Bits used to store the boolean values of a KartReplayEvent. */
+    enum { EVENT_ZIPPER = 1, EVENT_RED_SKIDDING = 2, EVENT_JUMPING = 4 };
+
+    // ------------------------------------------------------------------------
+    int quantise(float f, float scale)
+    {
+        return (int)floorf(f*scale + 0.5f);
+    }   // quantise
+}   // namespace
 
 // -----------------------------------------------------------------------------
 ReplayBase::ReplayBase()
@@ -33,7 +59,7 @@ FILE* ReplayBase::openReplayFile(bool writeable, bool full_path)
 {
     FILE *fd = fopen(full_path ? getReplayFilename().c_str() :
         (file_manager->getReplayDir() + getReplayFilename()).c_str(),
-        writeable ? "w" : "r");
+        writeable ? "wb" : "rb");
     if (!fd)
     {
         return NULL;
@@ -41,3 +67,118 @@ FILE* ReplayBase::openReplayFile(bool writeable, bool full_path)
     return fd;
 
 }   // openReplayFile
+
+// -----------------------------------------------------------------------------
+/** Converts the data of one frame into integer values for the binary replay
+ *  format. Consecutive frames of a kart differ only slightly, so the
+ *  differences of these values to the previous frame are small numbers,
+ *  which are stored with only one or two bytes each (see writeVarInt()).
+ *  \param te The transform of the kart.
+ *  \param pi The physics information of the kart.
+ *  \param kre The kart events.
+ *  \param values On return contains the NUM_FRAME_VALUES quantised values.
+ */
+void ReplayBase::quantiseFrame(const TransformEvent &te, const PhysicInfo &pi,
+                               const KartReplayEvent &kre, int *values) const
+{
+    const btVector3 &xyz = te.m_transform.getOrigin();
+    const btQuaternion q = te.m_transform.getRotation();
+    values[ 0] = quantise(te.m_time,   TIME_SCALE    );
+    values[ 1] = quantise(xyz.getX(),  POSITION_SCALE);
+    values[ 2] = quantise(xyz.getY(),  POSITION_SCALE);
+    values[ 3] = quantise(xyz.getZ(),  POSITION_SCALE);
+    values[ 4] = quantise(q.getX(),    ROTATION_SCALE);
+    values[ 5] = quantise(q.getY(),    ROTATION_SCALE);
+    values[ 6] = quantise(q.getZ(),    ROTATION_SCALE);
+    values[ 7] = quantise(q.getW(),    ROTATION_SCALE);
+    values[ 8] = quantise(pi.m_speed,  SPEED_SCALE   );
+    values[ 9] = quantise(pi.m_steer,  STEER_SCALE   );
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        values[10+i] = quantise(pi.m_suspension_length[i],
+                                SUSPENSION_SCALE);
+    }
+    values[14] = (kre.m_zipper_usage ? EVENT_ZIPPER       : 0)
+               | (kre.m_red_skidding ? EVENT_RED_SKIDDING : 0)
+               | (kre.m_jumping      ? EVENT_JUMPING      : 0);
+    values[15] = kre.m_nitro_usage;
+    values[16] = kre.m_skidding_state;
+}   // quantiseFrame
+
+// -----------------------------------------------------------------------------
+/** Converts the quantised values of a frame back, see quantiseFrame().
+ *  \param values The NUM_FRAME_VALUES quantised values.
+ *  \param te On return the transform of the kart.
+ *  \param pi On return the physics information of the kart.
+ *  \param kre On return the kart events.
+ */
+void ReplayBase::dequantiseFrame(const int *values, TransformEvent *te,
+                                 PhysicInfo *pi, KartReplayEvent *kre) const
+{
+    te->m_time = values[0] / TIME_SCALE;
+    btQuaternion q(values[4] / ROTATION_SCALE, values[5] / ROTATION_SCALE,
+                   values[6] / ROTATION_SCALE, values[7] / ROTATION_SCALE);
+    // Quantisation can slightly change the length of the quaternion
+    if (q.length2() > 0.0f)
+        q.normalize();
+    else
+        q = btQuaternion(0.0f, 0.0f, 0.0f, 1.0f);
+    te->m_transform.setRotation(q);
+    te->m_transform.setOrigin(btVector3(values[1] / POSITION_SCALE,
+                                        values[2] / POSITION_SCALE,
+                                        values[3] / POSITION_SCALE));
+    pi->m_speed = values[8] / SPEED_SCALE;
+    pi->m_steer = values[9] / STEER_SCALE;
+    for (unsigned int i = 0; i < 4; i++)
+        pi->m_suspension_length[i] = values[10+i] / SUSPENSION_SCALE;
+    kre->m_zipper_usage   = (values[14] & EVENT_ZIPPER      ) != 0;
+    kre->m_red_skidding   = (values[14] & EVENT_RED_SKIDDING) != 0;
+    kre->m_jumping        = (values[14] & EVENT_JUMPING     ) != 0;
+    kre->m_nitro_usage    = values[15];
+    kre->m_skidding_state = values[16];
+}   // dequantiseFrame
+
+// -----------------------------------------------------------------------------
+/** Appends a signed integer to a buffer using a variable number of bytes:
+ *  the value is zigzag encoded (so that small negative values become small
+ *  positive values), and then stored 7 bits per byte, with the highest bit
+ *  of each byte indicating if more bytes follow. Values between -64 and 63
+ *  need only one byte.
+ *  \param buffer The buffer to append the value to.
+ *  \param value The value to store.
+ */
+void ReplayBase::writeVarInt(std::vector<unsigned char> *buffer, int value)
+{
+    uint32_t u = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    while (u >= 0x80)
+    {
+        buffer->push_back((unsigned char)(u | 0x80));
+        u >>= 7;
+    }
+    buffer->push_back((unsigned char)u);
+}   // writeVarInt
+
+// -----------------------------------------------------------------------------
+/** Reads a signed integer stored with writeVarInt().
+ *  \param p Pointer to the data, on return points after the value read.
+ *  \param end End of the data.
+ *  \param value On return the value read.
+ *  \return False if the data ended before the value was complete.
+ */
+bool ReplayBase::readVarInt(const unsigned char **p, const unsigned char *end,
+                            int *value)
+{
+    uint32_t u = 0;
+    for (unsigned int shift = 0; shift < 35; shift += 7)
+    {
+        if (*p >= end) return false;
+        const unsigned char c = *((*p)++);
+        u |= (uint32_t)(c & 0x7f) << shift;
+        if ((c & 0x80) == 0)
+        {
+            *value = (int)(u >> 1) ^ -(int)(u & 1);
+            return true;
+        }
+    }
+    return false;
+}   // readVarInt
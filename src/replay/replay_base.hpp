@@ -33,6 +33,8 @@ class ReplayBase : public NoCopy
 {
     // Needs access to KartReplayEvent
     friend class GhostKart;
+    // Needs access to the frame data
+    friend class ReplayStats;
 
 protected:
     /** Stores a transform event, i.e. a position and rotation of a kart
@@ -72,16 +74,33 @@ protected:
         bool        m_jumping;
     };   // KartReplayEvent
 
+    // ------------------------------------------------------------------------
+    /** Number of integer values a frame is quantised to in the binary
+     *  replay format: time, position (3), rotation (4), speed, steer,
+     *  suspension lengths (4), event flags, nitro and skidding. */
+    enum { NUM_FRAME_VALUES = 17 };
+
     // ------------------------------------------------------------------------
     FILE *openReplayFile(bool writeable, bool full_path = false);
+    void  quantiseFrame(const TransformEvent &te, const PhysicInfo &pi,
+                        const KartReplayEvent &kre, int *values) const;
+    void  dequantiseFrame(const int *values, TransformEvent *te,
+                          PhysicInfo *pi, KartReplayEvent *kre) const;
+    static void writeVarInt(std::vector<unsigned char> *buffer, int value);
+    static bool readVarInt(const unsigned char **p,
+                           const unsigned char *end, int *value);
     // ------------------------------------------------------------------------
     /** Returns the filename that was opened. */
     virtual const std::string& getReplayFilename() const = 0;
     // ------------------------------------------------------------------------
     /** Returns the version number of the replay file. This is used to check
      *  that a loaded replay file can still be understood by this
-     *  executable. */
-    unsigned int getReplayVersion() const { return 3; }
+     *  executable. Version 3 files store each frame as a line of text,
+     *  version 4 files store the frames in the binary format. */
+    unsigned int getReplayVersion() const { return 4; }
+    // ------------------------------------------------------------------------
+    /** Returns the oldest replay file version that can still be read. */
+    unsigned int getMinReplayVersion() const { return 3; }
 
 public:
              ReplayBase();
@@ -27,9 +27,13 @@
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
 
+#include <algorithm>
 #include <irrlicht.h>
+#include <sstream>
 #include <stdio.h>
 #include <string>
+#include <sys/stat.h>
+#include <vector>
 
 ReplayPlay::SortOrder ReplayPlay::m_sort_order = ReplayPlay::SO_DEFAULT;
 ReplayPlay *ReplayPlay::m_replay_play = NULL;
@@ -40,6 +44,12 @@ ReplayPlay *ReplayPlay::m_replay_play = NULL;
 ReplayPlay::ReplayPlay()
 {
     m_current_replay_file = 0;
+    m_index_loaded        = false;
+    m_index_changed       = false;
+    m_replay_time         = 0.0f;
+    m_last_world_time     = 0.0f;
+    m_replay_speed        = 1.0f;
+    m_replay_end_time     = 0.0f;
 }   // ReplayPlay
 
 //-----------------------------------------------------------------------------
@@ -53,6 +63,9 @@ ReplayPlay::~ReplayPlay()
  */
 void ReplayPlay::reset()
 {
+    m_replay_time     = 0.0f;
+    m_last_world_time = 0.0f;
+    m_replay_speed    = 1.0f;
     for(unsigned int i=0; i<(unsigned int)m_ghost_karts.size(); i++)
     {
         m_ghost_karts[i].reset();
@@ -60,9 +73,57 @@ void ReplayPlay::reset()
 }   // reset
 
 //-----------------------------------------------------------------------------
+/** Advances the replay time when watching a replay by the world time that
+ *  has passed since the last call, multiplied by the replay speed. Since it
+ *  is based on the world time, the replay time does not change before the
+ *  race starts.
+ */
+void ReplayPlay::update()
+{
+    const float world_time = World::getWorld()->getTime();
+    seek(m_replay_time + (world_time - m_last_world_time)*m_replay_speed);
+    m_last_world_time = world_time;
+}   // update
+
+//-----------------------------------------------------------------------------
+/** Updates the controllers of all ghost karts and interpolates their poses
+ *  in one pass. This must be called each time step before the karts are
+ *  updated.
+ *  \param dt Time step size.
+ */
+void ReplayPlay::updateGhostPoses(float dt)
+{
+    const unsigned int num_ghosts = (unsigned int)m_ghost_karts.size();
+    m_ghost_poses.resize(num_ghosts);
+    for (unsigned int i = 0; i < num_ghosts; i++)
+        m_ghost_karts[i].updateController(dt, &m_ghost_poses, i);
+    m_ghost_poses.interpolate();
+    for (unsigned int i = 0; i < num_ghosts; i++)
+    {
+        m_ghost_karts[i].setPose(m_ghost_poses.getXYZ(i),
+                                 m_ghost_poses.getRotation(i));
+    }
+}   // updateGhostPoses
+
+//-----------------------------------------------------------------------------
+/** Moves the replay to the given time when watching a replay. The ghost
+ *  controllers find the frames for the new time using a binary search.
+ *  \param time The new replay time, clamped to the length of the replay.
+ */
+void ReplayPlay::seek(float time)
+{
+    m_replay_time = std::max(0.0f, std::min(time, getReplayEndTime()));
+}   // seek
+
+//-----------------------------------------------------------------------------
+/** Creates the list of all replay files (stock replays and replays recorded
+ *  by the user). The header information is taken from the replay index
+ *  (see addReplayFile()), which is saved again if it was changed.
+ */
 void ReplayPlay::loadAllReplayFile()
 {
     m_replay_file_list.clear();
+    m_indexed_files.clear();
 
     // Load stock replay first
     std::set<std::string> pre_record;
@@ -93,23 +154,203 @@ void ReplayPlay::loadAllReplayFile()
         }
     }
 
+    // Remove index entries of replay files that do not exist anymore
+    std::map<std::string, IndexEntry>::iterator i = m_index.begin();
+    while (i != m_index.end())
+    {
+        if (m_indexed_files.find(i->first) == m_indexed_files.end())
+        {
+            m_index.erase(i++);
+            m_index_changed = true;
+        }
+        else
+            i++;
+    }
+
+    if (m_index_changed)
+        writeIndex();
 }   // loadAllReplayFile
 
 //-----------------------------------------------------------------------------
-bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay)
+/** Returns the full path of the replay index file. */
+std::string ReplayPlay::getIndexFilename() const
 {
+    return file_manager->getReplayDir() + "replay_index.txt";
+}   // getIndexFilename
 
-    char s[1024], s1[1024];
+//-----------------------------------------------------------------------------
+/** Reads the replay index, which contains the header information of all
+ *  replay files together with the modification time and size of each file
+ *  when it was indexed. Each line after the version line describes one
+ *  replay file:
+ *  mtime size version reverse difficulty laps min_time track num_karts
+ *  kart1 ... kartN full_path (the path is last since it can contain spaces).
+ *  Invalid lines are ignored (the file will then just be indexed again).
+ */
+void ReplayPlay::readIndex()
+{
+    m_index_loaded  = true;
+    m_index_changed = false;
+    m_index.clear();
+
+    FILE *fd = fopen(getIndexFilename().c_str(), "r");
+    if (!fd) return;
+
+    char s[2048];
+    unsigned int version = 0;
+    if (fgets(s, 2047, fd) == NULL ||
+        sscanf(s, "replay_index: %u", &version) != 1 ||
+        version != getIndexVersion())
+    {
+        Log::info("Replay", "Replay index is outdated and will be recreated.");
+        fclose(fd);
+        m_index_changed = true;
+        return;
+    }
+
+    while (fgets(s, 2047, fd) != NULL)
+    {
+        std::istringstream line(s);
+        IndexEntry entry;
+        ReplayData &rd = entry.m_data;
+        int reverse = 0;
+        unsigned int num_karts = 0;
+        line >> entry.m_mtime >> entry.m_size >> rd.m_version >> reverse
+             >> rd.m_difficulty >> rd.m_laps >> rd.m_min_time
+             >> rd.m_track_name >> num_karts;
+        for (unsigned int k = 0; k < num_karts && line; k++)
+        {
+            std::string kart;
+            line >> kart;
+            rd.m_kart_list.push_back(kart);
+        }
+        std::string full_path;
+        std::getline(line >> std::ws, full_path);
+        // Remove the trailing newline (and \r on windows)
+        while (!full_path.empty() &&
+               (full_path[full_path.size()-1] == '\n' ||
+                full_path[full_path.size()-1] == '\r'))
+            full_path.erase(full_path.size()-1);
+        if (line.fail() || full_path.empty())
+        {
+            m_index_changed = true;
+            continue;
+        }
+        rd.m_reverse = reverse != 0;
+        rd.m_custom_replay_file = false;
+        m_index[full_path] = entry;
+    }
+    fclose(fd);
+}   // readIndex
+
+//-----------------------------------------------------------------------------
+/** Writes the replay index, see readIndex() for the format. */
+void ReplayPlay::writeIndex()
+{
+    FILE *fd = fopen(getIndexFilename().c_str(), "w");
+    if (!fd)
+    {
+        Log::warn("Replay", "Can't write replay index '%s'.",
+                  getIndexFilename().c_str());
+        return;
+    }
+    fprintf(fd, "replay_index: %u\n", getIndexVersion());
+    for (std::map<std::string, IndexEntry>::const_iterator
+         i = m_index.begin(); i != m_index.end(); i++)
+    {
+        const ReplayData &rd = i->second.m_data;
+        fprintf(fd, "%lld %lld %u %d %u %u %f %s %u",
+                (long long)i->second.m_mtime, (long long)i->second.m_size,
+                rd.m_version, (int)rd.m_reverse, rd.m_difficulty, rd.m_laps,
+                rd.m_min_time, rd.m_track_name.c_str(),
+                (unsigned int)rd.m_kart_list.size());
+        for (unsigned int k = 0; k < rd.m_kart_list.size(); k++)
+            fprintf(fd, " %s", rd.m_kart_list[k].c_str());
+        fprintf(fd, " %s\n", i->first.c_str());
+    }
+    fclose(fd);
+    m_index_changed = false;
+}   // writeIndex
+
+//-----------------------------------------------------------------------------
+/** Adds a replay file to the list of replays. The header information of
+ *  the file is taken from the replay index if the file was not modified
+ *  since it was indexed, otherwise the header is read from the file and the
+ *  index is updated.
+ *  \param fn File name of the replay file (in the replay directory, or a
+ *         full path if custom_replay is true).
+ *  \param custom_replay True if fn is a full path.
+ *  \return True if the replay file can be used.
+ */
+bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay)
+{
     if (StringUtils::getExtension(fn) != "replay") return false;
-    FILE *fd = fopen(custom_replay ? fn.c_str() :
-        (file_manager->getReplayDir() + fn).c_str(), "r");
-    if (fd == NULL) return false;
+    const std::string full_path = custom_replay ? fn
+                                : file_manager->getReplayDir() + fn;
+    if (!m_index_loaded)
+        readIndex();
+    m_indexed_files.insert(full_path);
+
+    struct stat mystat;
+    if (stat(full_path.c_str(), &mystat) != 0) return false;
+
     ReplayData rd;
+    std::map<std::string, IndexEntry>::iterator i = m_index.find(full_path);
+    if (i != m_index.end() && i->second.m_mtime == (int64_t)mystat.st_mtime
+                           && i->second.m_size  == (int64_t)mystat.st_size)
+    {
+        rd = i->second.m_data;
+    }
+    else
+    {
+        if (!readReplayHeader(full_path, &rd))
+            return false;
+        IndexEntry &entry = m_index[full_path];
+        entry.m_mtime = (int64_t)mystat.st_mtime;
+        entry.m_size  = (int64_t)mystat.st_size;
+        entry.m_data  = rd;
+        m_index_changed = true;
+    }
 
     // custom_replay is true when full path of filename is given
     rd.m_custom_replay_file = custom_replay;
     rd.m_filename = fn;
 
+    // The track is checked even for indexed files, since the available
+    // tracks (e.g. addons) can change.
+    Track* t = track_manager->getTrack(rd.m_track_name);
+    if (t == NULL)
+    {
+        Log::warn("Replay", "Track '%s' used in replay not found in STK!",
+        rd.m_track_name.c_str());
+        return false;
+    }
+
+    m_replay_file_list.push_back(rd);
+
+    assert(m_replay_file_list.size() > 0);
+    // Force to use custom replay file immediately
+    if (custom_replay)
+        m_current_replay_file = m_replay_file_list.size() - 1;
+
+    return true;
+
+}   // addReplayFile
+
+//-----------------------------------------------------------------------------
+/** Reads the header of a replay file.
+ *  \param full_path Full path of the replay file.
+ *  \param rd On return contains the information from the header (the
+ *         filename and custom replay flag are not set).
+ *  \return False if the header could not be read.
+ */
+bool ReplayPlay::readReplayHeader(const std::string &full_path,
+                                  ReplayData *rd) const
+{
+    char s[1024], s1[1024];
+    FILE *fd = fopen(full_path.c_str(), "rb");
+    if (fd == NULL) return false;
+
     fgets(s, 1023, fd);
     unsigned int version;
     if (sscanf(s,"version: %u", &version) != 1)
@@ -119,14 +360,15 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay)
         fclose(fd);
         return false;
     }
-    if (version != getReplayVersion())
+    if (version < getMinReplayVersion() || version > getReplayVersion())
     {
         Log::warn("Replay", "Replay is version '%d'", version);
         Log::warn("Replay", "STK version is '%d'", getReplayVersion());
-        Log::warn("Replay", "Skipped '%s'", fn.c_str());
+        Log::warn("Replay", "Skipped '%s'", full_path.c_str());
         fclose(fd);
         return false;
     }
+    rd->m_version = version;
 
     while(true)
     {
@@ -141,7 +383,7 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay)
             Log::warn("Replay", "Could not read ghost karts info!");
             break;
         }
-        rd.m_kart_list.push_back(std::string(s1));
+        rd->m_kart_list.push_back(std::string(s1));
     }
 
     int reverse = 0;
@@ -152,10 +394,10 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay)
         fclose(fd);
         return false;
     }
-    rd.m_reverse = reverse != 0;
+    rd->m_reverse = reverse != 0;
 
     fgets(s, 1023, fd);
-    if (sscanf(s, "difficulty: %u", &rd.m_difficulty) != 1)
+    if (sscanf(s, "difficulty: %u", &rd->m_difficulty) != 1)
     {
         Log::warn("Replay", " No difficulty found in replay file.");
         fclose(fd);
@@ -169,18 +411,10 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay)
         fclose(fd);
         return false;
     }
-    rd.m_track_name = std::string(s1);
-    Track* t = track_manager->getTrack(rd.m_track_name);
-    if (t == NULL)
-    {
-        Log::warn("Replay", "Track '%s' used in replay not found in STK!",
-        rd.m_track_name.c_str());
-        fclose(fd);
-        return false;
-    }
+    rd->m_track_name = std::string(s1);
 
     fgets(s, 1023, fd);
-    if (sscanf(s, "laps: %u", &rd.m_laps) != 1)
+    if (sscanf(s, "laps: %u", &rd->m_laps) != 1)
     {
         Log::warn("Replay", "No number of laps found in replay file.");
         fclose(fd);
@@ -188,66 +422,56 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay)
     }
 
     fgets(s, 1023, fd);
-    if (sscanf(s, "min_time: %f", &rd.m_min_time) != 1)
+    if (sscanf(s, "min_time: %f", &rd->m_min_time) != 1)
     {
         Log::warn("Replay", "Finish time not found in replay file.");
         fclose(fd);
         return false;
     }
     fclose(fd);
-    m_replay_file_list.push_back(rd);
-
-    assert(m_replay_file_list.size() > 0);
-    // Force to use custom replay file immediately
-    if (custom_replay)
-        m_current_replay_file = m_replay_file_list.size() - 1;
-
     return true;
-
-}   // addReplayFile
+}   // readReplayHeader
 
 //-----------------------------------------------------------------------------
 void ReplayPlay::load()
 {
     m_ghost_karts.clearAndDeleteAll();
-    char s[1024];
+    m_replay_end_time = 0.0f;
+
+    const ReplayData &rd = m_replay_file_list.at(m_current_replay_file);
+    const std::string full_path = rd.m_custom_replay_file
+                                ? rd.m_filename
+                                : file_manager->getReplayDir()+rd.m_filename;
+    Log::info("Replay", "Reading replay file '%s'.", getReplayFilename().c_str());
 
-    FILE *fd = openReplayFile(/*writeable*/false,
-        m_replay_file_list.at(m_current_replay_file).m_custom_replay_file);
-    if(!fd)
+    const bool result = readReplayFrames(full_path, rd,
+        [this](unsigned int kart, const TransformEvent &te,
+               const PhysicInfo &pi, const KartReplayEvent &kre)
+        {
+            while (m_ghost_karts.size() <= kart)
+                createGhostKart();
+            m_ghost_karts[kart].addReplayEvent(te.m_time, te.m_transform,
+                                               pi, kre);
+            m_replay_end_time = std::max(m_replay_end_time, te.m_time);
+        });
+    if (!result && m_ghost_karts.size() == 0)
     {
         Log::error("Replay", "Can't read '%s', ghost replay disabled.",
                getReplayFilename().c_str());
         destroy();
         return;
     }
-
-    Log::info("Replay", "Reading replay file '%s'.", getReplayFilename().c_str());
-
-    const unsigned int line_skipped = getNumGhostKart() + 7;
-    for (unsigned int i = 0; i < line_skipped; i++)
-        fgets(s, 1023, fd);
-
-    // eof actually doesn't trigger here, since it requires first to try
-    // reading behind eof, but still it's clearer this way.
-    while(!feof(fd))
-    {
-        if(fgets(s, 1023, fd)==NULL)  // eof reached
-            break;
-        readKartData(fd, s);
-    }
-
-    fprintf(fd, "Replay file end.\n");
-    fclose(fd);
+    // Create the ghost karts that have no frames
+    while (m_ghost_karts.size() < getNumGhostKart())
+        createGhostKart();
 }   // load
 
 //-----------------------------------------------------------------------------
-/** Reads all data from a replay file for a specific kart.
- *  \param fd The file descriptor from which to read.
+/** Creates the next ghost kart of the current replay file and its
+ *  controller.
  */
-void ReplayPlay::readKartData(FILE *fd, char *next_line)
+GhostKart* ReplayPlay::createGhostKart()
 {
-    char s[1024];
     const unsigned int kart_num = m_ghost_karts.size();
     m_ghost_karts.push_back(new GhostKart(m_replay_file_list
         [m_current_replay_file].m_kart_list.at(kart_num),
@@ -255,54 +479,166 @@ void ReplayPlay::readKartData(FILE *fd, char *next_line)
     m_ghost_karts[kart_num].init(RaceManager::KT_GHOST);
     Controller* controller = new GhostController(getGhostKart(kart_num));
     getGhostKart(kart_num)->setController(controller);
+    return getGhostKart(kart_num);
+}   // createGhostKart
 
-    unsigned int size;
-    if(sscanf(next_line,"size: %u",&size)!=1)
-        Log::fatal("Replay", "Number of records not found in replay file "
-            "for kart %d.", kart_num);
+//-----------------------------------------------------------------------------
+/** Reads all frames of a replay file and calls a function for each frame.
+ *  This does not modify the replay object, so it can be used to process
+ *  several replay files in parallel.
+ *  \param full_path Full path of the replay file.
+ *  \param rd The header information of this file (see readReplayHeader()).
+ *  \param f The function called for each frame.
+ *  \return False if the file could not be read completely.
+ */
+bool ReplayPlay::readReplayFrames(const std::string &full_path,
+                                  const ReplayData &rd,
+                                  const FrameFunction &f) const
+{
+    FILE *fd = fopen(full_path.c_str(), "rb");
+    if (!fd)
+        return false;
 
-    for(unsigned int i=0; i<size; i++)
-    {
+    char s[1024];
+    const unsigned int line_skipped = (unsigned int)rd.m_kart_list.size() + 7;
+    for (unsigned int i = 0; i < line_skipped; i++)
         fgets(s, 1023, fd);
-        float x, y, z, rx, ry, rz, rw, time, speed, steer, w1, w2, w3, w4;
-        int nitro, zipper, skidding, red_skidding, jumping;
-
-        // Check for EV_TRANSFORM event:
-        // -----------------------------
-        if(sscanf(s, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f  %d %d %d %d %d\n",
-            &time,
-            &x, &y, &z,
-            &rx, &ry, &rz, &rw,
-            &speed, &steer, &w1, &w2, &w3, &w4,
-            &nitro, &zipper, &skidding, &red_skidding, &jumping
-            )==19)
+
+    const unsigned int num_karts = (unsigned int)rd.m_kart_list.size();
+    const bool result = rd.m_version >= 4 ? readBinaryFrames(fd, num_karts, f)
+                                          : readTextFrames(fd, num_karts, f);
+    fclose(fd);
+    return result;
+}   // readReplayFrames
+
+//-----------------------------------------------------------------------------
+/** Reads all data of a text (version 3) replay file, which contains for
+ *  each kart the number of records followed by one line for each record.
+ *  \param fd The file descriptor, positioned after the header.
+ *  \param num_karts Number of karts in the file.
+ *  \param f The function called for each frame.
+ */
+bool ReplayPlay::readTextFrames(FILE *fd, unsigned int num_karts,
+                                const FrameFunction &f) const
+{
+    char s[1024];
+    for (unsigned int kart_num = 0; kart_num < num_karts; kart_num++)
+    {
+        unsigned int size;
+        if (fgets(s, 1023, fd) == NULL || sscanf(s, "size: %u", &size) != 1)
         {
-            btQuaternion q(rx, ry, rz, rw);
-            btVector3 xyz(x, y, z);
-            PhysicInfo pi = {0};
-            KartReplayEvent kre = {0};
-            pi.m_speed = speed;
-            pi.m_steer = steer;
-            pi.m_suspension_length[0] = w1;
-            pi.m_suspension_length[1] = w2;
-            pi.m_suspension_length[2] = w3;
-            pi.m_suspension_length[3] = w4;
-            kre.m_nitro_usage = nitro;
-            kre.m_zipper_usage = zipper!=0;
-            kre.m_skidding_state = skidding;
-            kre.m_red_skidding = red_skidding!=0;
-            kre.m_jumping = jumping != 0;
-            m_ghost_karts[kart_num].addReplayEvent(time,
-                btTransform(q, xyz), pi, kre);
+            Log::warn("Replay", "Number of records not found in replay file "
+                "for kart %d.", kart_num);
+            return false;
         }
-        else
+
+        for(unsigned int i=0; i<size; i++)
         {
-            // Invalid record found
-            // ---------------------
-            Log::warn("Replay", "Can't read replay data line %d:", i);
-            Log::warn("Replay", "%s", s);
-            Log::warn("Replay", "Ignored.");
+            if (fgets(s, 1023, fd) == NULL)
+            {
+                Log::warn("Replay", "Replay data for kart %d ends after "
+                          "%d of %d records.", kart_num, i, size);
+                return false;
+            }
+            float x, y, z, rx, ry, rz, rw, time, speed, steer, w1, w2, w3, w4;
+            int nitro, zipper, skidding, red_skidding, jumping;
+
+            // Check for EV_TRANSFORM event:
+            // -----------------------------
+            if(sscanf(s, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f  %d %d %d %d %d\n",
+                &time,
+                &x, &y, &z,
+                &rx, &ry, &rz, &rw,
+                &speed, &steer, &w1, &w2, &w3, &w4,
+                &nitro, &zipper, &skidding, &red_skidding, &jumping
+                )==19)
+            {
+                TransformEvent te;
+                te.m_time = time;
+                te.m_transform = btTransform(btQuaternion(rx, ry, rz, rw),
+                                             btVector3(x, y, z));
+                PhysicInfo pi = {0};
+                KartReplayEvent kre = {0};
+                pi.m_speed = speed;
+                pi.m_steer = steer;
+                pi.m_suspension_length[0] = w1;
+                pi.m_suspension_length[1] = w2;
+                pi.m_suspension_length[2] = w3;
+                pi.m_suspension_length[3] = w4;
+                kre.m_nitro_usage = nitro;
+                kre.m_zipper_usage = zipper!=0;
+                kre.m_skidding_state = skidding;
+                kre.m_red_skidding = red_skidding!=0;
+                kre.m_jumping = jumping != 0;
+                f(kart_num, te, pi, kre);
+            }
+            else
+            {
+                // Invalid record found
+                // ---------------------
+                Log::warn("Replay", "Can't read replay data line %d:", i);
+                Log::warn("Replay", "%s", s);
+                Log::warn("Replay", "Ignored.");
+            }
+        }   // for i
+    }   // for kart_num
+    return true;
+}   // readTextFrames
+
+//-----------------------------------------------------------------------------
+/** Reads the data of all karts from a binary (version 4) replay file, see
+ *  ReplayRecorder::save(). The remaining file is read with a single fread
+ *  call and then decoded from memory.
+ *  \param fd The file descriptor, positioned after the text header.
+ *  \param num_karts Number of karts in the file.
+ *  \param f The function called for each frame.
+ */
+bool ReplayPlay::readBinaryFrames(FILE *fd, unsigned int num_karts,
+                                  const FrameFunction &f) const
+{
+    std::vector<unsigned char> buffer;
+    unsigned char block[4096];
+    size_t n;
+    while ((n = fread(block, 1, sizeof(block), fd)) > 0)
+        buffer.insert(buffer.end(), block, block + n);
+    if (buffer.empty())
+    {
+        Log::warn("Replay", "No kart data found in replay file.");
+        return false;
+    }
+
+    const unsigned char *p   = &buffer[0];
+    const unsigned char *end = p + buffer.size();
+    for (unsigned int k = 0; k < num_karts; k++)
+    {
+        int size;
+        if (!readVarInt(&p, end, &size) || size < 0)
+        {
+            Log::warn("Replay", "Number of records not found in replay file "
+                      "for kart %d.", k);
+            return false;
         }
-    }   // for i
 
-}   // readKartData
+        int values[NUM_FRAME_VALUES] = {0};
+        for (int i = 0; i < size; i++)
+        {
+            for (unsigned int j = 0; j < NUM_FRAME_VALUES; j++)
+            {
+                int delta;
+                if (!readVarInt(&p, end, &delta))
+                {
+                    Log::warn("Replay", "Replay data for kart %d ends after "
+                              "%d of %d records.", k, i, size);
+                    return false;
+                }
+                values[j] += delta;
+            }
+            TransformEvent te;
+            PhysicInfo pi = {0};
+            KartReplayEvent kre = {0};
+            dequantiseFrame(values, &te, &pi, &kre);
+            f(k, te, pi, kre);
+        }   // for i
+    }   // for k
+    return true;
+}   // readBinaryFrames
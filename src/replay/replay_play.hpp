@@ -20,10 +20,15 @@
 #define HEADER_REPLAY__PLAY_HPP
 
 #include "karts/ghost_kart.hpp"
+#include "replay/ghost_poses.hpp"
 #include "replay/replay_base.hpp"
 #include "utils/ptr_vector.hpp"
+#include "utils/types.hpp"
 
 #include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -52,6 +57,7 @@ public:
     {
     public:
         std::string              m_filename;
+        unsigned int             m_version;
         std::string              m_track_name;
         std::vector<std::string> m_kart_list;
         bool                     m_reverse;
@@ -99,14 +105,93 @@ private:
     /** All ghost karts. */
     PtrVector<GhostKart>     m_ghost_karts;
 
+    /** The interpolated poses of all ghost karts. */
+    GhostPoses               m_ghost_poses;
+
+    /** An entry of the replay index: the header information of a replay
+     *  file, and the modification time and size of the file when it was
+     *  indexed. */
+    struct IndexEntry
+    {
+        int64_t    m_mtime;
+        int64_t    m_size;
+        ReplayData m_data;
+    };   // IndexEntry
+
+    /** The replay index, the key is the full path of the replay file. */
+    std::map<std::string, IndexEntry> m_index;
+
+    /** The full paths of all replay files found by the last call to
+     *  loadAllReplayFile(), used to remove stale index entries. */
+    std::set<std::string>    m_indexed_files;
+
+    /** True once the index file was read. */
+    bool                     m_index_loaded;
+
+    /** True if the index was modified since it was read or written. */
+    bool                     m_index_changed;
+
+    /** The time in the replay which is shown when watching a replay. It
+     *  follows the world time, but can be moved (see seek()) and can run
+     *  at a different speed. */
+    float                    m_replay_time;
+
+    /** The world time when m_replay_time was last updated. */
+    float                    m_last_world_time;
+
+    /** Speed factor of the replay, negative values play it backwards. */
+    float                    m_replay_speed;
+
+    /** The time of the last frame of all ghost karts of the loaded replay. */
+    float                    m_replay_end_time;
+
           ReplayPlay();
          ~ReplayPlay();
-    void  readKartData(FILE *fd, char *next_line);
+    GhostKart* createGhostKart();
+    std::string getIndexFilename() const;
+    void  readIndex();
+    void  writeIndex();
+    // ------------------------------------------------------------------------
+    /** Version of the replay index file format. */
+    unsigned int getIndexVersion() const { return 1; }
+public:
+    /** The function called for each frame read from a replay file, with
+     *  the index of the kart in the replay and the data of the frame. */
+    typedef std::function<void(unsigned int kart, const TransformEvent &te,
+                               const PhysicInfo &pi,
+                               const KartReplayEvent &kre)> FrameFunction;
+private:
+    bool  readTextFrames(FILE *fd, unsigned int num_karts,
+                         const FrameFunction &f) const;
+    bool  readBinaryFrames(FILE *fd, unsigned int num_karts,
+                           const FrameFunction &f) const;
 public:
+    bool  readReplayHeader(const std::string &full_path,
+                           ReplayData *rd) const;
+    bool  readReplayFrames(const std::string &full_path,
+                           const ReplayData &rd,
+                           const FrameFunction &f) const;
     void  reset();
+    void  update();
+    void  updateGhostPoses(float dt);
+    void  seek(float time);
     void  load();
     void  loadAllReplayFile();
     // ------------------------------------------------------------------------
+    /** Returns the current time in the replay that is shown when watching
+     *  a replay. */
+    float              getReplayTime() const       { return m_replay_time; }
+    // ------------------------------------------------------------------------
+    /** Returns the time of the last frame of all ghost karts. */
+    float              getReplayEndTime() const { return m_replay_end_time; }
+    // ------------------------------------------------------------------------
+    /** Sets the playback speed when watching a replay.
+     *  \param speed Speed factor, negative values play backwards. */
+    void               setReplaySpeed(float speed) { m_replay_speed = speed; }
+    // ------------------------------------------------------------------------
+    /** Returns the playback speed when watching a replay. */
+    float              getReplaySpeed() const     { return m_replay_speed; }
+    // ------------------------------------------------------------------------
     static void        setSortOrder(SortOrder so)       { m_sort_order = so; }
     // ------------------------------------------------------------------------
     void               sortReplay(bool reverse)
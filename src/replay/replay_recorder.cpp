@@ -31,9 +31,21 @@
 #include <algorithm>
 #include <stdio.h>
 #include <string>
+#include <vector>
+
+#if defined(WIN32) && !defined(__CYGWIN__)
+#  include <process.h>
+#  define getpid _getpid
+#else
+#  include <unistd.h>
+#endif
 
 ReplayRecorder *ReplayRecorder::m_replay_recorder = NULL;
 
+/** Size in bytes of the encoded frames of a kart that are collected before
+ *  they are passed to the writer thread. */
+static const unsigned int CHUNK_SIZE = 16384;
+
 //-----------------------------------------------------------------------------
 /** Initialises the Replay engine
  */
@@ -41,25 +53,37 @@ ReplayRecorder::ReplayRecorder()
 {
     m_complete_replay = false;
     m_incorrect_replay = false;
+    m_writer_running = false;
+    m_stop_writer = false;
+    m_write_error = false;
+    pthread_cond_init(&m_cond_request, NULL);
 }   // ReplayRecorder
 
 //-----------------------------------------------------------------------------
 /** Frees all stored data. */
 ReplayRecorder::~ReplayRecorder()
 {
+    reset();
+    pthread_cond_destroy(&m_cond_request);
 }   // ~Replay
 
 //-----------------------------------------------------------------------------
-/** Reset the replay recorder. */
+/** Reset the replay recorder. Stops the writer thread of a previous
+ *  recording and removes its temporary files. */
 void ReplayRecorder::reset()
 {
+    if (m_writer_running)
+    {
+        stopWriter();
+        removeTempFiles();
+    }
     m_complete_replay = false;
     m_incorrect_replay = false;
-    m_transform_events.clear();
-    m_physic_info.clear();
-    m_kart_replay_event.clear();
+    m_chunks.clear();
+    m_previous_values.clear();
     m_count_transforms.clear();
     m_last_saved_time.clear();
+    m_temp_files.clear();
 
 #ifdef DEBUG
     m_count                       = 0;
@@ -69,27 +93,33 @@ void ReplayRecorder::reset()
 }   // clear
 
 //-----------------------------------------------------------------------------
-/** Initialise the replay recorder. It especially allocates memory
- *  to store the replay data.
+/** Initialise the replay recorder. It especially allocates the chunk
+ *  buffers and starts the writer thread.
  */
 void ReplayRecorder::init()
 {
     reset();
-    m_transform_events.resize(race_manager->getNumberOfKarts());
-    m_physic_info.resize(race_manager->getNumberOfKarts());
-    m_kart_replay_event.resize(race_manager->getNumberOfKarts());
-    unsigned int max_frames = (unsigned int)(  stk_config->m_replay_max_time
-                                             / stk_config->m_replay_dt);
-    for(unsigned int i=0; i<race_manager->getNumberOfKarts(); i++)
+    const unsigned int num_karts = race_manager->getNumberOfKarts();
+    m_chunks.resize(num_karts);
+    for(unsigned int i=0; i<num_karts; i++)
+        m_chunks[i].reserve(CHUNK_SIZE + 5*NUM_FRAME_VALUES);
+    m_previous_values.resize(num_karts, std::vector<int>(NUM_FRAME_VALUES, 0));
+    m_count_transforms.resize(num_karts, 0);
+    m_last_saved_time.resize(num_karts, -1.0f);
+    m_temp_files.resize(num_karts, NULL);
+
+    m_stop_writer = false;
+    m_write_error = false;
+    int error = pthread_create(&m_writer_thread, NULL,
+                               &ReplayRecorder::writerThread, this);
+    if (error)
     {
-        m_transform_events[i].resize(max_frames);
-        m_physic_info[i].resize(max_frames);
-        m_kart_replay_event[i].resize(max_frames);
+        Log::error("ReplayRecorder", "Could not create thread, error=%d.",
+                   error);
+        m_incorrect_replay = true;
+        return;
     }
-
-    m_count_transforms.resize(race_manager->getNumberOfKarts(), 0);
-    m_last_saved_time.resize(race_manager->getNumberOfKarts(), -1.0f);
-
+    m_writer_running = true;
 }   // init
 
 //-----------------------------------------------------------------------------
@@ -124,44 +154,44 @@ void ReplayRecorder::update(float dt)
         }
         m_last_saved_time[i] = time;
         m_count_transforms[i]++;
-        if (m_count_transforms[i] >= m_transform_events[i].size())
-        {
-            // Only print this message once.
-            if (m_count_transforms[i] == m_transform_events[i].size())
-            {
-                char buffer[100];
-                sprintf(buffer, "Can't store more events for kart %s.",
-                        kart->getIdent().c_str());
-                Log::warn("ReplayRecorder", buffer);
-                m_incorrect_replay = single_player;
-            }
-            continue;
-        }
-        TransformEvent *p      = &(m_transform_events[i][m_count_transforms[i]-1]);
-        PhysicInfo *q          = &(m_physic_info[i][m_count_transforms[i]-1]);
-        KartReplayEvent *r     = &(m_kart_replay_event[i][m_count_transforms[i]-1]);
 
-        p->m_time              = World::getWorld()->getTime();
-        p->m_transform.setOrigin(kart->getXYZ());
-        p->m_transform.setRotation(kart->getVisualRotation());
+        TransformEvent p;
+        PhysicInfo q;
+        KartReplayEvent r;
 
-        q->m_speed             = kart->getSpeed();
-        q->m_steer             = kart->getSteerPercent();
+        p.m_time              = time;
+        p.m_transform.setOrigin(kart->getXYZ());
+        p.m_transform.setRotation(kart->getVisualRotation());
+
+        q.m_speed             = kart->getSpeed();
+        q.m_steer             = kart->getSteerPercent();
         const int num_wheels = kart->getVehicle()->getNumWheels();
         for (int j = 0; j < 4; j++)
         {
             if (j > num_wheels || num_wheels == 0)
-                q->m_suspension_length[j] = 0.0f;
+                q.m_suspension_length[j] = 0.0f;
             else
             {
-                q->m_suspension_length[j] = kart->getVehicle()
+                q.m_suspension_length[j] = kart->getVehicle()
                     ->getWheelInfo(j).m_raycastInfo.m_suspensionLength;
             }
         }
 
-        kart->getKartGFX()->getGFXStatus(&(r->m_nitro_usage),
-            &(r->m_zipper_usage), &(r->m_skidding_state), &(r->m_red_skidding));
-        r->m_jumping = kart->isJumping();
+        kart->getKartGFX()->getGFXStatus(&(r.m_nitro_usage),
+            &(r.m_zipper_usage), &(r.m_skidding_state), &(r.m_red_skidding));
+        r.m_jumping = kart->isJumping();
+
+        // Store the frame as difference to the previous frame of this kart
+        int values[NUM_FRAME_VALUES];
+        quantiseFrame(p, q, r, values);
+        std::vector<int> &previous = m_previous_values[i];
+        for (unsigned int j = 0; j < NUM_FRAME_VALUES; j++)
+        {
+            writeVarInt(&m_chunks[i], values[j] - previous[j]);
+            previous[j] = values[j];
+        }
+        if (m_chunks[i].size() >= CHUNK_SIZE)
+            queueChunk(i);
     }   // for i
 
     if (world->getPhase() == World::RESULT_DISPLAY_PHASE && !m_complete_replay)
@@ -172,7 +202,164 @@ void ReplayRecorder::update(float dt)
 }   // update
 
 //-----------------------------------------------------------------------------
-/** Saves the replay data stored in the internal data structures.
+/** Returns the name of the temporary file which stores the frames of a
+ *  kart during recording. The name contains the process id, so that several
+ *  instances of STK (e.g. the races of an AI tournament) can record at the
+ *  same time.
+ *  \param kart_id World kart id of the kart.
+ */
+std::string ReplayRecorder::getTempFilename(unsigned int kart_id) const
+{
+    return file_manager->getReplayDir() + "recording_"
+         + StringUtils::toString(getpid()) + "_"
+         + StringUtils::toString(kart_id) + ".tmp";
+}   // getTempFilename
+
+//-----------------------------------------------------------------------------
+/** Passes the current chunk of a kart to the writer thread, and starts a
+ *  new chunk for this kart.
+ *  \param kart_id World kart id of the kart.
+ */
+void ReplayRecorder::queueChunk(unsigned int kart_id)
+{
+    Chunk *chunk = new Chunk();
+    chunk->m_kart_id = kart_id;
+    chunk->m_data.swap(m_chunks[kart_id]);
+    m_chunks[kart_id].reserve(CHUNK_SIZE + 5*NUM_FRAME_VALUES);
+
+    m_chunk_queue.lock();
+    m_chunk_queue.getData().push_back(chunk);
+    pthread_cond_signal(&m_cond_request);
+    m_chunk_queue.unlock();
+}   // queueChunk
+
+//-----------------------------------------------------------------------------
+/** The writer thread: appends all queued chunks to the temporary files of
+ *  their karts, until it is asked to stop and all chunks are written.
+ *  \param obj Pointer to the replay recorder.
+ */
+void *ReplayRecorder::writerThread(void *obj)
+{
+    ReplayRecorder *me = (ReplayRecorder*)obj;
+    me->m_chunk_queue.lock();
+    while (true)
+    {
+        // Wait in a loop, since spurious wakeups can happen
+        while (me->m_chunk_queue.getData().empty() && !me->m_stop_writer)
+        {
+            pthread_cond_wait(&me->m_cond_request,
+                              me->m_chunk_queue.getMutex());
+        }
+        if (me->m_chunk_queue.getData().empty())
+            break;
+
+        // Write the chunks without holding the lock
+        std::vector<Chunk*> chunks;
+        chunks.swap(me->m_chunk_queue.getData());
+        me->m_chunk_queue.unlock();
+
+        bool error = false;
+        for (unsigned int i = 0; i < chunks.size(); i++)
+        {
+            const Chunk *chunk = chunks[i];
+            FILE *&fd = me->m_temp_files[chunk->m_kart_id];
+            if (!fd)
+            {
+                fd = fopen(me->getTempFilename(chunk->m_kart_id).c_str(),
+                           "wb");
+            }
+            if (!fd || fwrite(&chunk->m_data[0], 1, chunk->m_data.size(), fd)
+                       != chunk->m_data.size())
+                error = true;
+            delete chunk;
+        }
+
+        me->m_chunk_queue.lock();
+        if (error)
+            me->m_write_error = true;
+    }   // while true
+    me->m_chunk_queue.unlock();
+
+    for (unsigned int i = 0; i < me->m_temp_files.size(); i++)
+    {
+        if (me->m_temp_files[i])
+        {
+            fclose(me->m_temp_files[i]);
+            me->m_temp_files[i] = NULL;
+        }
+    }
+    return NULL;
+}   // writerThread
+
+//-----------------------------------------------------------------------------
+/** Passes all remaining chunks to the writer thread, and waits till it has
+ *  written them and exited.
+ *  \return False if the writer thread was not running, or if some data
+ *          could not be written.
+ */
+bool ReplayRecorder::stopWriter()
+{
+    if (!m_writer_running) return false;
+
+    for (unsigned int k = 0; k < m_chunks.size(); k++)
+    {
+        if (!m_chunks[k].empty())
+            queueChunk(k);
+    }
+    m_chunk_queue.lock();
+    m_stop_writer = true;
+    pthread_cond_signal(&m_cond_request);
+    m_chunk_queue.unlock();
+
+    pthread_join(m_writer_thread, NULL);
+    m_writer_running = false;
+    return !m_write_error;
+}   // stopWriter
+
+//-----------------------------------------------------------------------------
+/** Removes the temporary files of all karts. */
+void ReplayRecorder::removeTempFiles()
+{
+    for (unsigned int k = 0; k < m_temp_files.size(); k++)
+        file_manager->removeFile(getTempFilename(k));
+}   // removeTempFiles
+
+//-----------------------------------------------------------------------------
+/** Appends the content of the temporary file of a kart to a file.
+ *  \param kart_id World kart id of the kart.
+ *  \param fd The file to append to.
+ *  \return False if the data could not be copied.
+ */
+bool ReplayRecorder::copyTempFile(unsigned int kart_id, FILE *fd)
+{
+    // A kart without any frames has no temporary file.
+    if (m_count_transforms[kart_id] == 0) return true;
+
+    FILE *temp = fopen(getTempFilename(kart_id).c_str(), "rb");
+    if (!temp) return false;
+
+    bool ok = true;
+    char buffer[CHUNK_SIZE];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), temp)) > 0)
+    {
+        if (fwrite(buffer, 1, n, fd) != n)
+        {
+            ok = false;
+            break;
+        }
+    }
+    if (ferror(temp))
+        ok = false;
+    fclose(temp);
+    return ok;
+}   // copyTempFile
+
+//-----------------------------------------------------------------------------
+/** Saves the replay data: the header is written to a new file, followed
+ *  (for each kart) by the number of frames and the frames from the
+ *  temporary file of this kart. Only once all data is written, the file is
+ *  renamed to its final name.
  */
 void ReplayRecorder::save()
 {
@@ -182,18 +369,28 @@ void ReplayRecorder::save()
             _("Incomplete replay file will not be saved."));
         return;
     }
+    // The replay was already saved (e.g. using the debug menu).
+    if (!m_writer_running) return;
 
 #ifdef DEBUG
     Log::debug("ReplayRecorder", "%d frames, %d removed because of"
         "frequency compression", m_count, m_count_skipped_time);
 #endif
+    if (!stopWriter())
+    {
+        Log::error("ReplayRecorder", "Can't write temporary replay data - "
+            "can't save replay data.");
+        removeTempFiles();
+        return;
+    }
+
     const World *world           = World::getWorld();
     const unsigned int num_karts = world->getNumKarts();
     float min_time = 99999.99f;
     for (unsigned int k = 0; k < num_karts; k++)
     {
         if (world->getKart(k)->isGhostKart()) continue;
-        float cur_time = m_transform_events[k][m_count_transforms[k]-1].m_time;
+        float cur_time = m_last_saved_time[k];
         if (cur_time < min_time)
             min_time = cur_time;
     }
@@ -207,18 +404,18 @@ void ReplayRecorder::save()
         << "_" << num_karts << "_" << time << ".replay";
     m_filename = oss.str();
 
-    FILE *fd = openReplayFile(/*writeable*/true);
+    const std::string full_name = file_manager->getReplayDir()
+                                + getReplayFilename();
+    const std::string part_name = full_name + ".part";
+    FILE *fd = fopen(part_name.c_str(), "wb");
     if (!fd)
     {
         Log::error("ReplayRecorder", "Can't open '%s' for writing - "
-            "can't save replay data.", getReplayFilename().c_str());
+            "can't save replay data.", part_name.c_str());
+        removeTempFiles();
         return;
     }
 
-    core::stringw msg = _("Replay saved in \"%s\".",
-        (file_manager->getReplayDir() + getReplayFilename()).c_str());
-    MessageQueue::add(MessageQueue::MT_GENERIC, msg);
-
     fprintf(fd, "version: %d\n",    getReplayVersion());
     for (unsigned int real_karts = 0; real_karts < num_karts; real_karts++)
     {
@@ -234,42 +431,35 @@ void ReplayRecorder::save()
     fprintf(fd, "laps: %d\n",       race_manager->getNumLaps());
     fprintf(fd, "min_time: %f\n",   min_time);
 
-    unsigned int max_frames = (unsigned int)(  stk_config->m_replay_max_time 
-                                             / stk_config->m_replay_dt      );
-    for (unsigned int k = 0; k < num_karts; k++)
+    // The frames are stored in binary: for each kart the number of frames,
+    // followed by the quantised values of each frame stored as difference
+    // to the values of the previous frame of this kart.
+    bool ok = true;
+    for (unsigned int k = 0; k < num_karts && ok; k++)
     {
         if (world->getKart(k)->isGhostKart()) continue;
-        fprintf(fd, "size:     %d\n", m_count_transforms[k]);
+        std::vector<unsigned char> size;
+        writeVarInt(&size, m_count_transforms[k]);
+        ok = fwrite(&size[0], 1, size.size(), fd) == size.size() &&
+             copyTempFile(k, fd);
+    }
+    if (fclose(fd) != 0)
+        ok = false;
+    removeTempFiles();
 
-        unsigned int num_transforms = std::min(max_frames,
-                                               m_count_transforms[k]);
-        for (unsigned int i = 0; i < num_transforms; i++)
-        {
-            const TransformEvent *p  = &(m_transform_events[k][i]);
-            const PhysicInfo *q      = &(m_physic_info[k][i]);
-            const KartReplayEvent *r = &(m_kart_replay_event[k][i]);
-            fprintf(fd, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f  %d %d %d %d %d\n",
-                    p->m_time,
-                    p->m_transform.getOrigin().getX(),
-                    p->m_transform.getOrigin().getY(),
-                    p->m_transform.getOrigin().getZ(),
-                    p->m_transform.getRotation().getX(),
-                    p->m_transform.getRotation().getY(),
-                    p->m_transform.getRotation().getZ(),
-                    p->m_transform.getRotation().getW(),
-                    q->m_speed,
-                    q->m_steer,
-                    q->m_suspension_length[0],
-                    q->m_suspension_length[1],
-                    q->m_suspension_length[2],
-                    q->m_suspension_length[3],
-                    r->m_nitro_usage,
-                    (int)r->m_zipper_usage,
-                    r->m_skidding_state,
-                    (int)r->m_red_skidding,
-                    (int)r->m_jumping
-                );
-        }   // for i
+    // Replace an existing file with the same name (rename fails on windows
+    // if the destination exists).
+    if (ok)
+        ok = file_manager->removeFile(full_name) &&
+             rename(part_name.c_str(), full_name.c_str()) == 0;
+    if (!ok)
+    {
+        Log::error("ReplayRecorder", "Can't write '%s' - "
+            "can't save replay data.", full_name.c_str());
+        file_manager->removeFile(part_name);
+        return;
     }
-    fclose(fd);
+
+    core::stringw msg = _("Replay saved in \"%s\".", full_name.c_str());
+    MessageQueue::add(MessageQueue::MT_GENERIC, msg);
 }   // save
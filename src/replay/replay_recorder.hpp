@@ -21,25 +21,43 @@
 
 #include "karts/controller/kart_control.hpp"
 #include "replay/replay_base.hpp"
+#include "utils/synchronised.hpp"
 
+#include <pthread.h>
 #include <vector>
 
-/**
+/** Records a race for later replay. To keep the memory usage independent
+ *  of the length of a race, the frames of each kart are encoded (see
+ *  ReplayBase::quantiseFrame()) into a small chunk in memory. Each full
+ *  chunk is handed to a writer thread, which appends it to a temporary file
+ *  for this kart. At the end of the race the writer thread is stopped, and
+ *  the header and the data of all temporary files are written to a new
+ *  file, which is then renamed to the final replay file name, so that an
+ *  incomplete replay file is never visible in the replay selection.
   * \ingroup replay
   */
 class ReplayRecorder : public ReplayBase
 {
 private:
-    std::string m_filename;
+    /** A chunk of encoded frames of one kart, to be appended to the
+     *  temporary file of this kart by the writer thread. */
+    struct Chunk
+    {
+        /** World kart id of the kart. */
+        unsigned int               m_kart_id;
+        /** The encoded frames. */
+        std::vector<unsigned char> m_data;
+    };   // Chunk
 
-    /** A separate vector of Replay Events for all transforms. */
-    std::vector< std::vector<TransformEvent> > m_transform_events;
+    std::string m_filename;
 
-    /** A separate vector of Replay Events for all physic info. */
-    std::vector< std::vector<PhysicInfo> > m_physic_info;
+    /** For each kart the encoded frames not yet passed to the writer
+     *  thread. */
+    std::vector< std::vector<unsigned char> > m_chunks;
 
-    /** A separate vector of Replay Events for all other events. */
-    std::vector< std::vector<KartReplayEvent> > m_kart_replay_event;
+    /** For each kart the quantised values of the last frame recorded,
+     *  frames are stored as difference to the previous frame. */
+    std::vector< std::vector<int> > m_previous_values;
 
     /** Time at which a transform was saved for the last time. */
     std::vector<float> m_last_saved_time;
@@ -47,6 +65,32 @@ private:
     /** Counts the number of transform events for each kart. */
     std::vector<unsigned int> m_count_transforms;
 
+    /** Chunks to be written by the writer thread. */
+    Synchronised< std::vector<Chunk*> > m_chunk_queue;
+
+    /** Signals the writer thread that new chunks are queued, or that it
+     *  should stop. */
+    pthread_cond_t m_cond_request;
+
+    /** The writer thread. */
+    pthread_t m_writer_thread;
+
+    /** True while the writer thread is running. Only accessed by the main
+     *  thread. */
+    bool m_writer_running;
+
+    /** Set (protected by the mutex of m_chunk_queue) to ask the writer
+     *  thread to exit once all queued chunks are written. */
+    bool m_stop_writer;
+
+    /** Set by the writer thread (protected by the mutex of m_chunk_queue)
+     *  if a chunk could not be written. */
+    bool m_write_error;
+
+    /** The temporary file for each kart, only accessed by the writer
+     *  thread while it is running. */
+    std::vector<FILE*> m_temp_files;
+
     /** Static pointer to the one instance of the replay object. */
     static ReplayRecorder *m_replay_recorder;
 
@@ -68,6 +112,12 @@ private:
 
           ReplayRecorder();
          ~ReplayRecorder();
+    static void *writerThread(void *obj);
+    std::string  getTempFilename(unsigned int kart_id) const;
+    void         queueChunk(unsigned int kart_id);
+    bool         stopWriter();
+    void         removeTempFiles();
+    bool         copyTempFile(unsigned int kart_id, FILE *fd);
 public:
     void  init();
     void  reset();
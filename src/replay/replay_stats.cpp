@@ -0,0 +1,440 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "replay/replay_stats.hpp"
+
+#include "io/file_manager.hpp"
+#include "karts/skidding.hpp"
+#include "tracks/quad_graph.hpp"
+#include "tracks/track.hpp"
+#include "tracks/track_manager.hpp"
+#include "utils/job_system.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+#include "utils/vec3.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+bool        ReplayStats::m_enabled = false;
+std::string ReplayStats::m_report;
+std::string ReplayStats::m_replay_dir;
+
+ReplayStats::ReplayStats()
+{
+    m_num_invalid_headers = 0;
+}   // ReplayStats
+
+// ----------------------------------------------------------------------------
+/** Reads the headers of all replay files in a directory and adds the files
+ *  with a valid header to m_files.
+ *  \param dir The directory to search.
+ */
+void ReplayStats::addFiles(const std::string &dir)
+{
+    std::set<std::string> files;
+    file_manager->listFiles(files, dir, /*make_full_path*/true);
+    for(std::set<std::string>::iterator i=files.begin(); i!=files.end(); i++)
+    {
+        if(!StringUtils::hasSuffix(*i, ".replay"))
+            continue;
+        FileResult result;
+        result.m_full_path = *i;
+        result.m_data.m_filename           = *i;
+        result.m_data.m_custom_replay_file = true;
+        if(!ReplayPlay::get()->readReplayHeader(*i, &result.m_data))
+        {
+            Log::warn("ReplayStats", "Invalid replay header in '%s'.",
+                      i->c_str());
+            m_num_invalid_headers++;
+            continue;
+        }
+        result.m_valid         = false;
+        result.m_num_frames    = 0;
+        result.m_bad_frames    = 0;
+        result.m_skid_frames   = 0;
+        result.m_nitro_frames  = 0;
+        result.m_zipper_frames = 0;
+        m_files.push_back(result);
+    }
+}   // addFiles
+
+// ----------------------------------------------------------------------------
+/** Collects all replay files to analyse and groups them by track and
+ *  direction.
+ */
+void ReplayStats::collectFiles()
+{
+    if(m_replay_dir.empty())
+    {
+        addFiles(file_manager->getAssetDirectory(FileManager::REPLAY));
+        addFiles(file_manager->getReplayDir());
+    }
+    else
+        addFiles(m_replay_dir);
+
+    for(unsigned int i=0; i<m_files.size(); i++)
+    {
+        const ReplayPlay::ReplayData &rd = m_files[i].m_data;
+        unsigned int g;
+        for(g=0; g<m_groups.size(); g++)
+        {
+            if(m_groups[g].m_track==rd.m_track_name &&
+               m_groups[g].m_reverse==rd.m_reverse)
+                break;
+        }
+        if(g==m_groups.size())
+        {
+            Group group;
+            group.m_track      = rd.m_track_name;
+            group.m_reverse    = rd.m_reverse;
+            group.m_lap_length = 0.0f;
+            m_groups.push_back(group);
+        }
+        m_groups[g].m_files.push_back(i);
+    }
+}   // collectFiles
+
+// ----------------------------------------------------------------------------
+/** Loads the quad graph of the track of a group and analyses all files of
+ *  this group in parallel. Only one quad graph can exist at a time, so the
+ *  groups themselves are handled one after the other.
+ *  \param group The group to analyse.
+ */
+void ReplayStats::analyseGroup(Group *group)
+{
+    Track *track = track_manager->getTrack(group->m_track);
+    if(!track)
+    {
+        Log::warn("ReplayStats", "Track '%s' not found, %d replays skipped.",
+                  group->m_track.c_str(), (int)group->m_files.size());
+        return;
+    }
+    const std::string quad_file = track->getTrackFile("quads.xml");
+    if(track->isArena() || track->isSoccer() ||
+       !file_manager->fileExists(quad_file))
+    {
+        Log::warn("ReplayStats", "Track '%s' has no quad graph, "
+                  "%d replays skipped.", group->m_track.c_str(),
+                  (int)group->m_files.size());
+        return;
+    }
+
+    QuadGraph::create(quad_file, track->getTrackFile("graph.xml"),
+                      group->m_reverse);
+    QuadGraph::get()->setupPaths();
+    group->m_lap_length = QuadGraph::get()->getLapLength();
+    if(QuadGraph::get()->getNumNodes()>0 && group->m_lap_length>0)
+    {
+        const float lap_length = group->m_lap_length;
+        JobSystem::get()->parallelFor((unsigned int)group->m_files.size(),
+            [this, group, lap_length](unsigned int i)
+            {
+                analyseFile(&m_files[group->m_files[i]], lap_length);
+            });
+    }
+    else
+        group->m_lap_length = 0.0f;
+    QuadGraph::destroy();
+}   // analyseGroup
+
+// ----------------------------------------------------------------------------
+/** Reads all frames of a replay file and collects lap times, the speed
+ *  profile and the usage of skidding, nitro and zippers. This is called in
+ *  parallel for different files, so it only uses read-only functions of
+ *  the quad graph and ReplayPlay, and only modifies its result.
+ *  A lap is completed each time the distance along the track wraps around
+ *  from the end of the lap to its start.
+ *  \param result The file to analyse, which also receives the results.
+ *  \param lap_length Length of a lap of the track.
+ */
+void ReplayStats::analyseFile(FileResult *result, float lap_length) const
+{
+    result->m_speed_sum.assign(NUM_SPEED_BINS, 0.0);
+    result->m_speed_count.assign(NUM_SPEED_BINS, 0);
+
+    // State of the kart whose frames are currently read: all frames of a
+    // kart are read before the frames of the next kart.
+    unsigned int current_kart = 0;
+    bool         first_frame  = true;
+    int          sector       = QuadGraph::UNKNOWN_SECTOR;
+    float        last_time    = 0.0f;
+    float        last_distance= 0.0f;
+    float        lap_start    = -1.0f;
+    unsigned int lap          = 0;
+    const QuadGraph *graph    = QuadGraph::get();
+
+    result->m_valid = ReplayPlay::get()->readReplayFrames(result->m_full_path,
+        result->m_data,
+        [&](unsigned int kart, const ReplayBase::TransformEvent &te,
+            const ReplayBase::PhysicInfo &pi,
+            const ReplayBase::KartReplayEvent &kre)
+        {
+            if(kart!=current_kart)
+            {
+                current_kart = kart;
+                first_frame  = true;
+                sector       = QuadGraph::UNKNOWN_SECTOR;
+                lap          = 0;
+            }
+            result->m_num_frames++;
+            const Vec3 xyz(te.m_transform.getOrigin());
+            if(!std::isfinite(te.m_time) || !std::isfinite(pi.m_speed) ||
+               !std::isfinite(xyz.getX()) || !std::isfinite(xyz.getY()) ||
+               !std::isfinite(xyz.getZ()) ||
+               (!first_frame && te.m_time<last_time))
+            {
+                result->m_bad_frames++;
+                return;
+            }
+
+            if(kre.m_skidding_state!=Skidding::SKID_NONE)
+                result->m_skid_frames++;
+            if(kre.m_nitro_usage>0)
+                result->m_nitro_frames++;
+            if(kre.m_zipper_usage)
+                result->m_zipper_frames++;
+
+            const int prev_sector = sector;
+            graph->findRoadSector(xyz, &sector);
+            if(sector==QuadGraph::UNKNOWN_SECTOR)
+                sector = graph->findOutOfRoadSector(xyz, prev_sector);
+            Vec3 track_coord;
+            graph->spatialToTrack(&track_coord, xyz, sector);
+            const float distance = track_coord.getZ();
+
+            if(first_frame)
+            {
+                // Karts start behind the start line, i.e. at the end of the
+                // lap, so the first lap only starts when the line is crossed.
+                lap_start   = distance < 0.5f*lap_length ? te.m_time : -1.0f;
+                first_frame = false;
+            }
+            else if(last_distance-distance > 0.5f*lap_length)
+            {
+                // Crossed the start line
+                if(lap_start>=0)
+                {
+                    LapTime lap_time;
+                    lap_time.m_kart = kart;
+                    lap_time.m_lap  = ++lap;
+                    lap_time.m_time = te.m_time - lap_start;
+                    result->m_laps.push_back(lap_time);
+                }
+                lap_start = te.m_time;
+            }
+            else if(distance-last_distance > 0.5f*lap_length)
+            {
+                // Crossed the start line backwards, ignore this lap
+                lap_start = -1.0f;
+            }
+            last_time     = te.m_time;
+            last_distance = distance;
+
+            int bin = (int)(distance/lap_length*NUM_SPEED_BINS);
+            bin = std::max(0, std::min(bin, (int)NUM_SPEED_BINS-1));
+            result->m_speed_sum[bin] += pi.m_speed;
+            result->m_speed_count[bin]++;
+        });
+
+    if(!result->m_valid)
+        Log::warn("ReplayStats", "Could not read all frames of '%s'.",
+                  result->m_full_path.c_str());
+    else if(result->m_bad_frames>0)
+        Log::warn("ReplayStats", "'%s' contains %d invalid frames.",
+                  result->m_full_path.c_str(), result->m_bad_frames);
+}   // analyseFile
+
+// ----------------------------------------------------------------------------
+/** Opens one of the report files for writing.
+ *  \param suffix Suffix appended to the report name, e.g. "-laps.csv".
+ *  \return The file, or NULL if it could not be opened.
+ */
+FILE* ReplayStats::openReport(const std::string &suffix) const
+{
+    const std::string filename = m_report+suffix;
+    FILE *fd = fopen(filename.c_str(), "w");
+    if(!fd)
+        Log::error("ReplayStats", "Can't open '%s' for writing.",
+                   filename.c_str());
+    else
+        Log::info("ReplayStats", "Writing '%s'.", filename.c_str());
+    return fd;
+}   // openReport
+
+// ----------------------------------------------------------------------------
+/** Writes one line for each track and direction with the distribution of
+ *  the lap times and the fraction of frames in which karts were skidding,
+ *  using nitro or using a zipper.
+ */
+void ReplayStats::writeSummary() const
+{
+    FILE *fd = openReport(".csv");
+    if(!fd) return;
+
+    fprintf(fd, "track,reverse,replays,invalid,karts,frames,bad_frames,laps,"
+                "lap_min,lap_mean,lap_median,lap_max,lap_stddev,"
+                "skid_fraction,nitro_fraction,zipper_fraction\n");
+    for(unsigned int g=0; g<m_groups.size(); g++)
+    {
+        const Group &group = m_groups[g];
+        unsigned int invalid = 0, karts = 0, frames = 0, bad_frames = 0;
+        unsigned int skid = 0, nitro = 0, zipper = 0;
+        std::vector<float> laps;
+        for(unsigned int i=0; i<group.m_files.size(); i++)
+        {
+            const FileResult &file = m_files[group.m_files[i]];
+            if(!file.m_valid) invalid++;
+            karts      += (unsigned int)file.m_data.m_kart_list.size();
+            frames     += file.m_num_frames;
+            bad_frames += file.m_bad_frames;
+            skid       += file.m_skid_frames;
+            nitro      += file.m_nitro_frames;
+            zipper     += file.m_zipper_frames;
+            for(unsigned int l=0; l<file.m_laps.size(); l++)
+                laps.push_back(file.m_laps[l].m_time);
+        }
+
+        float min = 0, mean = 0, median = 0, max = 0, stddev = 0;
+        if(!laps.empty())
+        {
+            std::sort(laps.begin(), laps.end());
+            const unsigned int n = (unsigned int)laps.size();
+            min    = laps[0];
+            max    = laps[n-1];
+            median = n%2 ? laps[n/2] : 0.5f*(laps[n/2-1]+laps[n/2]);
+            double sum = 0, sum2 = 0;
+            for(unsigned int l=0; l<n; l++)
+            {
+                sum  += laps[l];
+                sum2 += laps[l]*laps[l];
+            }
+            mean   = float(sum/n);
+            stddev = float(sqrt(std::max(0.0, sum2/n - (sum/n)*(sum/n))));
+        }
+        const float good = float(std::max(frames-bad_frames, 1u));
+        fprintf(fd, "%s,%d,%d,%d,%d,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,"
+                    "%.4f,%.4f,%.4f\n",
+                group.m_track.c_str(), group.m_reverse,
+                (int)group.m_files.size(), invalid, karts, frames,
+                bad_frames, (int)laps.size(), min, mean, median, max,
+                stddev, skid/good, nitro/good, zipper/good);
+    }
+    fclose(fd);
+}   // writeSummary
+
+// ----------------------------------------------------------------------------
+/** Writes one line for each completed lap of each kart in each file. */
+void ReplayStats::writeLaps() const
+{
+    FILE *fd = openReport("-laps.csv");
+    if(!fd) return;
+
+    fprintf(fd, "track,reverse,file,kart,lap,time\n");
+    for(unsigned int g=0; g<m_groups.size(); g++)
+    {
+        const Group &group = m_groups[g];
+        for(unsigned int i=0; i<group.m_files.size(); i++)
+        {
+            const FileResult &file = m_files[group.m_files[i]];
+            const std::string name =
+                StringUtils::getBasename(file.m_full_path);
+            for(unsigned int l=0; l<file.m_laps.size(); l++)
+            {
+                const LapTime &lap = file.m_laps[l];
+                fprintf(fd, "%s,%d,%s,%s,%d,%.3f\n", group.m_track.c_str(),
+                        group.m_reverse, name.c_str(),
+                        file.m_data.m_kart_list[lap.m_kart].c_str(),
+                        lap.m_lap, lap.m_time);
+            }
+        }
+    }
+    fclose(fd);
+}   // writeLaps
+
+// ----------------------------------------------------------------------------
+/** Writes the average speed of all karts in each section of each track. */
+void ReplayStats::writeSpeedProfile() const
+{
+    FILE *fd = openReport("-speed.csv");
+    if(!fd) return;
+
+    fprintf(fd, "track,reverse,bin,distance,mean_speed,samples\n");
+    for(unsigned int g=0; g<m_groups.size(); g++)
+    {
+        const Group &group = m_groups[g];
+        if(group.m_lap_length<=0) continue;
+        for(unsigned int b=0; b<NUM_SPEED_BINS; b++)
+        {
+            double sum = 0;
+            unsigned int count = 0;
+            for(unsigned int i=0; i<group.m_files.size(); i++)
+            {
+                const FileResult &file = m_files[group.m_files[i]];
+                if(file.m_speed_count.empty()) continue;
+                sum   += file.m_speed_sum[b];
+                count += file.m_speed_count[b];
+            }
+            fprintf(fd, "%s,%d,%d,%.1f,%.3f,%d\n", group.m_track.c_str(),
+                    group.m_reverse, b,
+                    (b+0.5f)*group.m_lap_length/NUM_SPEED_BINS,
+                    count>0 ? sum/count : 0.0, count);
+        }
+    }
+    fclose(fd);
+}   // writeSpeedProfile
+
+// ----------------------------------------------------------------------------
+/** Analyses all replay files and writes the reports.
+ *  \return The exit code for STK: 0 if all replay files were valid.
+ */
+int ReplayStats::run()
+{
+    StkTime::TimeType start = StkTime::getTimeSinceEpoch();
+    collectFiles();
+    Log::info("ReplayStats", "Analysing %d replays of %d tracks using %d "
+              "threads.", (int)m_files.size(), (int)m_groups.size(),
+              JobSystem::get()->getNumThreads());
+
+    for(unsigned int g=0; g<m_groups.size(); g++)
+        analyseGroup(&m_groups[g]);
+
+    writeSummary();
+    writeLaps();
+    writeSpeedProfile();
+
+    // Files of skipped tracks are not counted as invalid
+    unsigned int num_invalid = m_num_invalid_headers;
+    for(unsigned int g=0; g<m_groups.size(); g++)
+    {
+        if(m_groups[g].m_lap_length<=0) continue;
+        for(unsigned int i=0; i<m_groups[g].m_files.size(); i++)
+        {
+            const FileResult &file = m_files[m_groups[g].m_files[i]];
+            if(!file.m_valid || file.m_bad_frames>0)
+                num_invalid++;
+        }
+    }
+    Log::info("ReplayStats", "%d replays analysed in %d seconds, "
+              "%d of them invalid.",
+              (int)m_files.size()+m_num_invalid_headers,
+              (int)(StkTime::getTimeSinceEpoch()-start), num_invalid);
+    return num_invalid>0 ? 1 : 0;
+}   // run
@@ -0,0 +1,149 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_REPLAY_STATS_HPP
+#define HEADER_REPLAY_STATS_HPP
+
+#include "replay/replay_play.hpp"
+#include "utils/no_copy.hpp"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/** Validates a set of replay files and collects statistics about them,
+ *  without starting a race: the files are read with the parsing code of
+ *  ReplayPlay, but no ghost karts are created. The files are grouped by
+ *  track and direction. For each group the quad graph of the track is
+ *  loaded, and the files of the group are then analysed in parallel using
+ *  the job system. The results are written to three CSV files:
+ *  report.csv (one line per track with lap time distribution and skid,
+ *  nitro and zipper usage), report-laps.csv (every lap of every kart) and
+ *  report-speed.csv (average speed along the track).
+ *  It is enabled with --replay-stats=report, typically together with
+ *  --no-graphics.
+ * \ingroup replay
+ */
+class ReplayStats : public NoCopy
+{
+private:
+    /** Number of sections the track is split into for the speed profile. */
+    enum { NUM_SPEED_BINS = 100 };
+
+    /** The time of one lap of a kart. */
+    struct LapTime
+    {
+        /** Index of the kart in the replay file. */
+        unsigned int m_kart;
+        /** Number of the lap, starting with 1. */
+        unsigned int m_lap;
+        /** Time of the lap in seconds. */
+        float        m_time;
+    };   // LapTime
+
+    /** The result of analysing one replay file. Each file is only accessed
+     *  by one thread, so no locking is necessary. */
+    struct FileResult
+    {
+        /** Full path of the replay file. */
+        std::string               m_full_path;
+        /** The header information of the file. */
+        ReplayPlay::ReplayData    m_data;
+        /** True if all frames of the file could be read. */
+        bool                      m_valid;
+        /** Number of frames of all karts. */
+        unsigned int              m_num_frames;
+        /** Number of frames that were ignored because the time went
+         *  backwards or a value was not finite. */
+        unsigned int              m_bad_frames;
+        /** Number of frames in which a kart was skidding. */
+        unsigned int              m_skid_frames;
+        /** Number of frames in which a kart was using nitro. */
+        unsigned int              m_nitro_frames;
+        /** Number of frames in which a kart was using a zipper. */
+        unsigned int              m_zipper_frames;
+        /** All completed laps of all karts. */
+        std::vector<LapTime>      m_laps;
+        /** Sum of the speeds in each section of the track. */
+        std::vector<double>       m_speed_sum;
+        /** Number of frames in each section of the track. */
+        std::vector<unsigned int> m_speed_count;
+    };   // FileResult
+
+    /** All files for the same track and direction. */
+    struct Group
+    {
+        /** Ident of the track. */
+        std::string               m_track;
+        /** True if the track is driven in reverse. */
+        bool                      m_reverse;
+        /** Length of a lap, or 0 if the track has no quad graph. */
+        float                     m_lap_length;
+        /** Indices of the files of this group in m_files. */
+        std::vector<unsigned int> m_files;
+    };   // Group
+
+    /** True if replay statistics were requested on the command line. */
+    static bool              m_enabled;
+
+    /** Name of the report files (without extension). */
+    static std::string       m_report;
+
+    /** The directory with the replay files to use, or empty to use the
+     *  user and stock replays. */
+    static std::string       m_replay_dir;
+
+    /** All replay files with a valid header. */
+    std::vector<FileResult>  m_files;
+
+    /** The files grouped by track and direction. */
+    std::vector<Group>       m_groups;
+
+    /** Number of files whose header could not be read. */
+    unsigned int             m_num_invalid_headers;
+
+    void        collectFiles();
+    void        addFiles(const std::string &dir);
+    void        analyseGroup(Group *group);
+    void        analyseFile(FileResult *result, float lap_length) const;
+    FILE*       openReport(const std::string &suffix) const;
+    void        writeSummary() const;
+    void        writeLaps() const;
+    void        writeSpeedProfile() const;
+
+public:
+                ReplayStats();
+    int         run();
+    // ------------------------------------------------------------------------
+    /** Enables the replay statistics.
+     *  \param report Name of the report files (without extension). */
+    static void enable(const std::string &report)
+    {
+        m_enabled = true;
+        m_report  = report;
+    }   // enable
+    // ------------------------------------------------------------------------
+    /** Sets the directory from which all replay files are read. */
+    static void setReplayDirectory(const std::string &dir)
+                                                     { m_replay_dir = dir; }
+    // ------------------------------------------------------------------------
+    /** Returns true if replay statistics were requested. */
+    static bool isEnabled() { return m_enabled; }
+};   // ReplayStats
+
+#endif
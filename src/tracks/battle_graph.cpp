@@ -23,15 +23,46 @@
 #include <IMeshSceneNode.h>
 
 #include "config/user_config.hpp"
+#include "io/file_manager.hpp"
 #include "io/xml_node.hpp"
 #include "items/item_manager.hpp"
 #include "race/race_manager.hpp"
 #include "tracks/navmesh.hpp"
+#include "utils/job_system.hpp"
 #include "utils/log.hpp"
+#include "utils/time.hpp"
+
+#include <functional>
+#include <queue>
+#include <stdio.h>
 
 const int BattleGraph::UNKNOWN_POLY  = -1;
 BattleGraph * BattleGraph::m_battle_graph = NULL;
 
+/** Returns a hash value (FNV-1a) of the content of a file, or 0 if the file
+ *  can't be read.
+ *  \param filename Name of the file.
+ */
+static uint32_t getFileHash(const std::string &filename)
+{
+    FILE *fd = fopen(filename.c_str(), "rb");
+    if(!fd) return 0;
+    uint32_t hash = 2166136261u;
+    unsigned char buffer[4096];
+    size_t n;
+    while((n=fread(buffer, 1, sizeof(buffer), fd))>0)
+    {
+        for(size_t i=0; i<n; i++)
+        {
+            hash ^= buffer[i];
+            hash *= 16777619u;
+        }
+    }
+    fclose(fd);
+    return hash;
+}   // getFileHash
+
+// -----------------------------------------------------------------------------
 /** Constructor, Creates a navmesh, builds a graph from the navmesh and
 *    then runs shortest path algorithm to find and store paths to be used
 *    by the AI. */
@@ -43,7 +74,23 @@ BattleGraph::BattleGraph(const std::string &navmesh_file_name,
     NavMesh::create(navmesh_file_name);
     m_navmesh_file = navmesh_file_name;
     buildGraph(NavMesh::get());
-    computeFloydWarshall();
+
+    // The shortest paths only depend on the navmesh, so they are cached
+    // in a file named after the hash of the navmesh file.
+    const uint32_t hash = getFileHash(navmesh_file_name);
+    char hash_string[9];
+    snprintf(hash_string, 9, "%08x", hash);
+    const std::string cache_file = file_manager->getCachedDataDir()
+                                 + "battlegraph-" + hash_string + ".dat";
+    if(!loadShortestPaths(cache_file, hash))
+    {
+        const double start = StkTime::getRealTime();
+        computeShortestPaths();
+        Log::info("BattleGraph",
+                  "Computed shortest paths for %d nodes in %f seconds.",
+                  m_num_nodes, StkTime::getRealTime()-start);
+        saveShortestPaths(cache_file, hash);
+    }
     if (race_manager->getMinorMode() == RaceManager::MINOR_MODE_SOCCER)
         loadGoalNodes(node);
 
@@ -65,65 +112,159 @@ BattleGraph::~BattleGraph(void)
 *    matrix. */
 void BattleGraph::buildGraph(NavMesh* navmesh)
 {
-    unsigned int n_polys = navmesh->getNumberOfPolys();
+    m_num_nodes = navmesh->getNumberOfPolys();
+    const unsigned int n_polys = m_num_nodes;
 
-    m_distance_matrix = std::vector< std::vector<float> > (n_polys, std::vector<float>(n_polys, 9999.9f));
+    m_distance_matrix.assign(n_polys*n_polys, 9999.9f);
     for(unsigned int i=0; i<n_polys; i++)
     {
-        NavPoly currentPoly = navmesh->getNavPoly(i);
-        std::vector<int> adjacents = navmesh->getAdjacentPolys(i);
+        const NavPoly &currentPoly = navmesh->getNavPoly(i);
+        const std::vector<int> &adjacents = navmesh->getAdjacentPolys(i);
         for(unsigned int j=0; j<adjacents.size(); j++)
         {
             Vec3 diff = navmesh->getCenterOfPoly(adjacents[j]) - currentPoly.getCenter();
             float distance = diff.length();
-            m_distance_matrix[i][adjacents[j]] = distance;
-            //m_distance_matrix[adjacents[j]][i] = distance;
+            m_distance_matrix[i*n_polys+adjacents[j]] = distance;
         }
-        m_distance_matrix[i][i] = 0.0f;
+        m_distance_matrix[i*n_polys+i] = 0.0f;
     }
 
 }    // buildGraph
 
 // -----------------------------------------------------------------------------
-/** computeFloydWarshall() computes the shortest distance between any two nodes.
- *  At the end of the computation, m_distance_matrix[i][j] stores the shortest path
- *  distance from i to j and m_parent_poly[i][j] stores the last vertex visited on the
- *  shortest path from i to j before visiting j. Suppose the shortest path from i to j is
- *  i->......->k->j  then m_parent_poly[i][j] = k
+/** computeShortestPaths() computes the shortest distance between any two
+ *  nodes. At the end of the computation, m_distance_matrix[i][j] stores the
+ *  shortest path distance from i to j and m_parent_poly[i][j] stores the
+ *  last vertex visited on the shortest path from i to j before visiting j.
+ *  Suppose the shortest path from i to j is i->......->k->j then
+ *  m_parent_poly[i][j] = k. If there is no path (or i==j),
+ *  m_parent_poly[i][j] is UNKNOWN_POLY, which the AI must check.
+ *  Since the graph is sparse (each polygon has only a few neighbours), this
+ *  runs Dijkstra's algorithm for each node instead of Floyd-Warshall, which
+ *  is O(n^3). Each source only writes its own rows of the matrices, so all
+ *  sources are done in parallel.
  */
-void BattleGraph::computeFloydWarshall()
+void BattleGraph::computeShortestPaths()
 {
-    unsigned int n = getNumNodes();
+    const unsigned int n = m_num_nodes;
 
-    // initialize m_parent_poly with unknown_poly so that if no path is found b/w i and j
-    // then m_parent_poly[i][j] = -1 (UNKNOWN_POLY)
-    // AI must check this
-    m_parent_poly = std::vector< std::vector<int> > (n, std::vector<int>(n,BattleGraph::UNKNOWN_POLY));
+    // Copy the edges into a compact list first, since the rows of the
+    // distance matrix are overwritten while the paths are computed.
+    std::vector<unsigned int> first_edge(n+1);
+    std::vector<int>          edge_to;
+    std::vector<float>        edge_length;
     for(unsigned int i=0; i<n; i++)
     {
+        first_edge[i] = (unsigned int)edge_to.size();
         for(unsigned int j=0; j<n; j++)
         {
-            if(i == j || m_distance_matrix[i][j]>=9899.9f) m_parent_poly[i][j]=-1;
-            else    m_parent_poly[i][j] = i;
+            if(i!=j && m_distance_matrix[i*n+j]<9899.9f)
+            {
+                edge_to.push_back(j);
+                edge_length.push_back(m_distance_matrix[i*n+j]);
+            }
         }
     }
+    first_edge[n] = (unsigned int)edge_to.size();
+
+    m_parent_poly.assign(n*n, BattleGraph::UNKNOWN_POLY);
 
-    for(unsigned int k=0; k<n; k++)
+    typedef std::pair<float, int> QueueEntry;
+    JobSystem::get()->parallelFor(n, [&](unsigned int source)
     {
+        float *distance = &m_distance_matrix[source*n];
+        int   *parent   = &m_parent_poly[source*n];
         for(unsigned int i=0; i<n; i++)
+            distance[i] = 9999.9f;
+        distance[source] = 0.0f;
+
+        std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                            std::greater<QueueEntry> > queue;
+        queue.push(QueueEntry(0.0f, source));
+        while(!queue.empty())
         {
-            for(unsigned int j=0; j<n; j++)
+            const QueueEntry top = queue.top();
+            queue.pop();
+            const int node = top.second;
+            // Skip outdated entries of nodes that were already reached
+            // on a shorter path.
+            if(top.first>distance[node]) continue;
+            for(unsigned int e=first_edge[node]; e<first_edge[node+1]; e++)
             {
-                if( (m_distance_matrix[i][k] + m_distance_matrix[k][j]) < m_distance_matrix[i][j])
+                const int   next = edge_to[e];
+                const float d    = distance[node] + edge_length[e];
+                if(d<distance[next])
                 {
-                    m_distance_matrix[i][j] = m_distance_matrix[i][k] + m_distance_matrix[k][j];
-                    m_parent_poly[i][j] = m_parent_poly[k][j];
+                    distance[next] = d;
+                    parent[next]   = node;
+                    queue.push(QueueEntry(d, next));
                 }
-            }
-        }
+            }   // for e
+        }   // while !queue.empty()
+    });
+}    // computeShortestPaths
+
+// -----------------------------------------------------------------------------
+/** Loads the shortest paths from a cache file written by
+ *  saveShortestPaths().
+ *  \param filename Name of the cache file.
+ *  \param hash Hash of the navmesh file, which must match the hash stored
+ *         in the cache file.
+ *  \return True if the cache file was valid.
+ */
+bool BattleGraph::loadShortestPaths(const std::string &filename,
+                                    uint32_t hash)
+{
+    FILE *fd = fopen(filename.c_str(), "rb");
+    if(!fd) return false;
+
+    const unsigned int n = m_num_nodes;
+    std::vector<float> distance(n*n);
+    std::vector<int>   parent(n*n);
+    uint32_t header[2];
+    bool ok = fread(header, sizeof(uint32_t), 2, fd)==2 &&
+              header[0]==hash && header[1]==n                      &&
+              fread(distance.data(), sizeof(float), n*n, fd)==n*n &&
+              fread(parent.data(),   sizeof(int),   n*n, fd)==n*n;
+    fclose(fd);
+    if(!ok)
+    {
+        Log::info("BattleGraph", "Cached paths in '%s' are outdated.",
+                  filename.c_str());
+        return false;
     }
+    m_distance_matrix.swap(distance);
+    m_parent_poly.swap(parent);
+    return true;
+}   // loadShortestPaths
 
-}    // computeFloydWarshall
+// -----------------------------------------------------------------------------
+/** Saves the shortest paths to a cache file.
+ *  \param filename Name of the cache file.
+ *  \param hash Hash of the navmesh file.
+ */
+void BattleGraph::saveShortestPaths(const std::string &filename,
+                                    uint32_t hash) const
+{
+    FILE *fd = fopen(filename.c_str(), "wb");
+    if(!fd)
+    {
+        Log::warn("BattleGraph", "Can't open '%s' for writing.",
+                  filename.c_str());
+        return;
+    }
+    const unsigned int n = m_num_nodes;
+    uint32_t header[2] = { hash, n };
+    bool ok = fwrite(header, sizeof(uint32_t), 2, fd)==2 &&
+              fwrite(m_distance_matrix.data(), sizeof(float), n*n, fd)==n*n &&
+              fwrite(m_parent_poly.data(),     sizeof(int),   n*n, fd)==n*n;
+    fclose(fd);
+    if(!ok)
+    {
+        Log::warn("BattleGraph", "Error writing '%s'.", filename.c_str());
+        remove(filename.c_str());
+    }
+}   // saveShortestPaths
 
 // -----------------------------------------------------------------------------
 /** Maps items on battle graph */
@@ -136,13 +277,9 @@ void BattleGraph::findItemsOnGraphNodes()
     {
         const Item* item = item_manager->getItem(i);
         Vec3 xyz = item->getXYZ();
-        int polygon = BattleGraph::UNKNOWN_POLY;
-
-        for (unsigned int j = 0; j < this->getNumNodes(); ++j)
-        {
-            if (NavMesh::get()->getNavPoly(j).pointInPoly(xyz, false))
-                polygon = j;
-        }
+        // An item on overlapping polygons belongs to the last of them.
+        int polygon = NavMesh::get()->findPoly(xyz, /*ignore_vertical*/false,
+                                               /*last_match*/true);
 
         if (polygon != BattleGraph::UNKNOWN_POLY)
         {
@@ -163,19 +300,8 @@ int BattleGraph::pointToNode(const int cur_node,
 
     if (cur_node == BattleGraph::UNKNOWN_POLY)
     {
-        // Try all nodes in the battle graph
-        bool found = false;
-        unsigned int node = 0;
-        while (!found && node < this->getNumNodes())
-        {
-            const NavPoly& p_all = this->getPolyOfNode(node);
-            if (p_all.pointInPoly(cur_point, ignore_vertical))
-            {
-                final_node = node;
-                found = true;
-            }
-            node++;
-        }
+        // Only test the nodes close to the point
+        final_node = NavMesh::get()->findPoly(cur_point, ignore_vertical);
     }
     else
     {
@@ -200,6 +326,40 @@ int BattleGraph::pointToNode(const int cur_node,
             num++;
         }
 
+        // If the point moved further, walk towards it, always moving to
+        // the neighbour whose center is closest to the point
+        int node = cur_node;
+        float node_dist = (getPolyOfNode(node).getCenter() - cur_point)
+                          .length2_2d();
+        for (int step = 0; step < 8 && !found; step++)
+        {
+            const std::vector<int>& next = NavMesh::get()
+                ->getAdjacentPolys(node);
+            int closest = BattleGraph::UNKNOWN_POLY;
+            for (unsigned int i = 0; i < next.size(); i++)
+            {
+                const float dist = (getPolyOfNode(next[i]).getCenter()
+                                    - cur_point).length2_2d();
+                if (dist < node_dist)
+                {
+                    node_dist = dist;
+                    closest   = next[i];
+                }
+            }
+            // No neighbour is closer, e.g. the point is behind an obstacle
+            if (closest == BattleGraph::UNKNOWN_POLY) break;
+            node = closest;
+            if (getPolyOfNode(node).pointInPoly(cur_point, ignore_vertical))
+            {
+                final_node = node;
+                found = true;
+            }
+        }
+
+        // Otherwise test all nodes close to the point
+        if (!found)
+            final_node = NavMesh::get()->findPoly(cur_point, ignore_vertical);
+
         // Current node is still unkown
         if (final_node == BattleGraph::UNKNOWN_POLY)
         {
@@ -221,7 +381,7 @@ const int BattleGraph::getNextShortestPathPoly(int i, int j) const
 {
     if (i == BattleGraph::UNKNOWN_POLY || j == BattleGraph::UNKNOWN_POLY)
         return BattleGraph::UNKNOWN_POLY;
-    return m_parent_poly[j][i];
+    return m_parent_poly[j*m_num_nodes+i];
 }    // getNextShortestPathPoly
 
 // -----------------------------------------------------------------------------
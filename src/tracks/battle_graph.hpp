@@ -25,6 +25,7 @@
 
 #include "tracks/graph_structure.hpp"
 #include "tracks/navmesh.hpp"
+#include "utils/types.hpp"
 
 class GraphStructure;
 class Item;
@@ -48,10 +49,16 @@ class BattleGraph : public GraphStructure
 private:
     static BattleGraph        *m_battle_graph;
 
-    /** The actual graph data structure, it is an adjacency matrix */
-    std::vector< std::vector< float > > m_distance_matrix;
-    /** The matrix that is used to store computed shortest paths */
-    std::vector< std::vector< int > > m_parent_poly;
+    /** Number of nodes, i.e. the number of polygons of the NavMesh. */
+    unsigned int             m_num_nodes;
+
+    /** The actual graph data structure, it is an adjacency matrix. After
+     *  computing the shortest paths it contains the distance between any
+     *  two nodes. Stored row-major: [i*m_num_nodes+j] is from i to j. */
+    std::vector<float>       m_distance_matrix;
+    /** The matrix that is used to store computed shortest paths, same
+     *  layout as m_distance_matrix. */
+    std::vector<int>         m_parent_poly;
 
     /** Stores the name of the file containing the NavMesh data */
     std::string              m_navmesh_file;
@@ -62,7 +69,9 @@ private:
     std::set<int> m_blue_node;
 
     void buildGraph(NavMesh*);
-    void computeFloydWarshall();
+    void computeShortestPaths();
+    bool loadShortestPaths(const std::string &filename, uint32_t hash);
+    void saveShortestPaths(const std::string &filename, uint32_t hash) const;
     void loadGoalNodes(const XMLNode& node);
 
     BattleGraph(const std::string &navmesh_file_name, const XMLNode& node);
@@ -116,8 +125,7 @@ public:
     // ----------------------------------------------------------------------
     /** Returns the number of nodes in the BattleGraph (equal to the number of
     *    polygons in the NavMesh */
-    virtual const unsigned int getNumNodes() const
-                                         { return m_distance_matrix.size(); }
+    virtual const unsigned int getNumNodes() const { return m_num_nodes; }
 
     // ----------------------------------------------------------------------
     /** Returns the distance between any two nodes */
@@ -126,7 +134,7 @@ public:
         if (from == BattleGraph::UNKNOWN_POLY ||
             to == BattleGraph::UNKNOWN_POLY)
             return 0.0f;
-        return m_distance_matrix[from][to];
+        return m_distance_matrix[from*m_num_nodes+to];
     }
     // ------------------------------------------------------------------------
     /** Returns the NavPoly corresponding to the i-th node of the BattleGraph */
@@ -38,12 +38,16 @@ CheckLap::CheckLap(const XMLNode &node, unsigned int index)
     // Note that when this is called the karts have not been allocated
     // in world, so we can't call world->getNumKarts()
     m_previous_distance.resize(race_manager->getNumberOfKarts());
+    m_linear_world = NULL;
+    m_track_length = 0;
 }   // CheckLap
 
 // ----------------------------------------------------------------------------
 void CheckLap::reset(const Track &track)
 {
     CheckStructure::reset(track);
+    m_linear_world = dynamic_cast<LinearWorld*>(World::getWorld());
+    m_track_length = m_linear_world ? track.getTrackLength() : 0.0f;
     for(unsigned int i=0; i<m_previous_distance.size(); i++)
     {
         m_previous_distance[i] = 0;
@@ -61,16 +65,14 @@ void CheckLap::reset(const Track &track)
 bool CheckLap::isTriggered(const Vec3 &old_pos, const Vec3 &new_pos,
     unsigned int kart_index)
 {
-    World* w = World::getWorld();
-    LinearWorld* lin_world = dynamic_cast<LinearWorld*>(w);
+    LinearWorld* lin_world = m_linear_world;
 
-    float track_length = w->getTrack()->getTrackLength();
     // Can happen if a non-lap based race mode is used with a scene file that
     // has check defined.
     if(!lin_world)
         return false;
     float current_distance = lin_world->getDistanceDownTrackForKart(kart_index);
-    bool result = (m_previous_distance[kart_index]>0.95f*track_length &&
+    bool result = (m_previous_distance[kart_index]>0.95f*m_track_length &&
                   current_distance<7.0f);
 
     if (UserConfigParams::m_check_debug && result)
@@ -21,8 +21,9 @@
 
 #include "tracks/check_structure.hpp"
 
-class XMLNode;
 class CheckManager;
+class LinearWorld;
+class XMLNode;
 
 /**
  *  \brief Implements a simple lap test. A new lap is detected
@@ -36,6 +37,13 @@ private:
     /** Store the previous distance along track. */
     std::vector<float> m_previous_distance;
 
+    /** The world if it is a linear world, NULL otherwise. Set in reset()
+     *  so that it is not looked up for each kart in each frame. */
+    LinearWorld       *m_linear_world;
+
+    /** The length of the track. */
+    float              m_track_length;
+
 public:
                  CheckLap(const XMLNode &node, unsigned int index);
     virtual     ~CheckLap() {};
@@ -133,6 +133,42 @@ void CheckLine::reset(const Track &track)
     }
 }   // reset
 
+// ----------------------------------------------------------------------------
+/** Tests all karts for crossing this check line. This is the same as
+ *  CheckStructure::update(), except that isTriggered() is only called for
+ *  karts that are now on the other side of the (infinite) line than at the
+ *  last test: for all other karts isTriggered() would return false without
+ *  changing any state. Since most karts are far away from most lines, this
+ *  avoids nearly all virtual calls and line intersection tests.
+ *  \param dt Time since last call.
+ */
+void CheckLine::update(float dt)
+{
+    World *world = World::getWorld();
+    for(unsigned int i=0; i<world->getNumKarts(); i++)
+    {
+        const AbstractKart *kart = world->getKart(i);
+        if(kart->getKartAnimation()) continue;
+        const Vec3 &xyz = kart->getFrontXYZ();
+        // Only check active checklines.
+        if(m_is_active[i])
+        {
+            const bool sign =
+                m_line.getPointOrientation(xyz.toIrrVector2d())>=0;
+            if(sign!=m_previous_sign[i] &&
+               isTriggered(m_previous_position[i], xyz, i))
+            {
+                if(UserConfigParams::m_check_debug)
+                    Log::info("CheckStructure",
+                              "Check structure %d triggered for kart %s.",
+                              m_index, kart->getIdent().c_str());
+                trigger(i);
+            }
+        }
+        m_previous_position[i] = xyz;
+    }   // for i<getNumKarts
+}   // update
+
 // ----------------------------------------------------------------------------
 void CheckLine::changeDebugColor(bool is_active)
 {
@@ -76,6 +76,7 @@ public:
     virtual     ~CheckLine();
     virtual bool isTriggered(const Vec3 &old_pos, const Vec3 &new_pos,
                              unsigned int indx);
+    virtual void update(float dt);
     virtual void reset(const Track &track);
     virtual void changeDebugColor(bool is_active);
     /** Returns the actual line data for this checkpoint. */
@@ -102,14 +102,15 @@ void CheckStructure::update(float dt)
     World *world = World::getWorld();
     for(unsigned int i=0; i<world->getNumKarts(); i++)
     {
-        const Vec3 &xyz = world->getKart(i)->getFrontXYZ();
-        if(world->getKart(i)->getKartAnimation()) continue;
+        const AbstractKart *kart = world->getKart(i);
+        if(kart->getKartAnimation()) continue;
+        const Vec3 &xyz = kart->getFrontXYZ();
         // Only check active checklines.
         if(m_is_active[i] && isTriggered(m_previous_position[i], xyz, i))
         {
             if(UserConfigParams::m_check_debug)
                 Log::info("CheckStructure", "Check structure %d triggered for kart %s.",
-                          m_index, world->getKart(i)->getIdent().c_str());
+                          m_index, kart->getIdent().c_str());
             trigger(i);
         }
         m_previous_position[i] = xyz;
@@ -0,0 +1,140 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "tracks/height_map.hpp"
+
+#include "physics/triangle_mesh.hpp"
+#include "utils/job_system.hpp"
+#include "utils/log.hpp"
+
+#include <stdio.h>
+
+/** Identifies a height map file, and the version of the file format. */
+static const uint32_t HEIGHT_MAP_MAGIC   = 0x484b5453;   // "STKH"
+static const uint32_t HEIGHT_MAP_VERSION = 2;
+
+// ----------------------------------------------------------------------------
+/** Creates an empty height map covering the given bounding box. build() or
+ *  load() must be called before it can be used.
+ *  \param aabb_min, aabb_max The bounding box of the track.
+ *  \param resolution Number of samples in each direction.
+ */
+HeightMap::HeightMap(const Vec3 &aabb_min, const Vec3 &aabb_max,
+                     unsigned int resolution)
+{
+    assert(resolution>0);
+    m_resolution    = resolution;
+    m_min_x         = aabb_min.getX();
+    m_min_z         = aabb_min.getZ();
+    m_x_step        = (aabb_max.getX() - aabb_min.getX())/resolution;
+    m_z_step        = (aabb_max.getZ() - aabb_min.getZ())/resolution;
+    m_no_hit_height = aabb_min.getY();
+    m_mesh_hash     = 0;
+    m_samples.resize(resolution*resolution, m_no_hit_height);
+}   // HeightMap
+
+// ----------------------------------------------------------------------------
+/** Builds the height map by raycasting against the triangle mesh, the rows
+ *  are done in parallel.
+ *  \param tm The triangle mesh of the track.
+ *  \param from_height The height from which the rays are cast downwards.
+ */
+void HeightMap::build(const TriangleMesh &tm, float from_height)
+{
+    m_mesh_hash = tm.getHash();
+    JobSystem::get()->parallelFor(m_resolution,
+        [&](unsigned int i)
+        {
+            const float x = m_min_x + i*m_x_step;
+            btVector3 hit_point;
+            const Material *material;
+            for (unsigned int j=0; j<m_resolution; j++)
+            {
+                btVector3 from(x, from_height, m_min_z + j*m_z_step);
+                btVector3 to = from;
+                to.setY(-100000.f);
+                if(tm.castRay(from, to, &hit_point, &material))
+                    m_samples[i*m_resolution+j] = hit_point.getY();
+                else
+                    m_samples[i*m_resolution+j] = m_no_hit_height;
+            }   // j<m_resolution
+        });
+}   // build
+
+// ----------------------------------------------------------------------------
+/** Loads the samples from a file written by save().
+ *  \param filename Name of the file.
+ *  \param tm The triangle mesh of the track, used to test if the file is
+ *         still up to date.
+ *  \return True if the file was valid for this track.
+ */
+bool HeightMap::load(const std::string &filename, const TriangleMesh &tm)
+{
+    FILE *fd = fopen(filename.c_str(), "rb");
+    if(!fd) return false;
+
+    uint32_t header[4];
+    float    area[4];
+    bool ok = fread(header, sizeof(uint32_t), 4, fd)==4 &&
+              fread(area,   sizeof(float),    4, fd)==4 &&
+              header[0]==HEIGHT_MAP_MAGIC            &&
+              header[1]==HEIGHT_MAP_VERSION          &&
+              header[2]==m_resolution                &&
+              area[0]==m_min_x && area[1]==m_min_z   &&
+              area[2]==m_x_step && area[3]==m_z_step &&
+              header[3]==tm.getHash()                &&
+              fread(m_samples.data(), sizeof(float), m_samples.size(), fd)
+                                                          ==m_samples.size();
+    fclose(fd);
+    if(!ok)
+    {
+        Log::info("HeightMap", "Cached height map '%s' is outdated.",
+                  filename.c_str());
+        return false;
+    }
+    m_mesh_hash = header[3];
+    return true;
+}   // load
+
+// ----------------------------------------------------------------------------
+/** Saves this height map to a file.
+ *  \param filename Name of the file.
+ */
+void HeightMap::save(const std::string &filename) const
+{
+    FILE *fd = fopen(filename.c_str(), "wb");
+    if(!fd)
+    {
+        Log::warn("HeightMap", "Can't open '%s' for writing.",
+                  filename.c_str());
+        return;
+    }
+    uint32_t header[4] = { HEIGHT_MAP_MAGIC, HEIGHT_MAP_VERSION,
+                           m_resolution, m_mesh_hash };
+    float area[4] = { m_min_x, m_min_z, m_x_step, m_z_step };
+    bool ok = fwrite(header, sizeof(uint32_t), 4, fd)==4 &&
+              fwrite(area,   sizeof(float),    4, fd)==4 &&
+              fwrite(m_samples.data(), sizeof(float), m_samples.size(), fd)
+                                                          ==m_samples.size();
+    fclose(fd);
+    if(!ok)
+    {
+        Log::warn("HeightMap", "Error writing '%s'.", filename.c_str());
+        remove(filename.c_str());
+    }
+}   // save
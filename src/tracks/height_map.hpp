@@ -0,0 +1,89 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_HEIGHT_MAP_HPP
+#define HEADER_HEIGHT_MAP_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+#include "utils/vec3.hpp"
+
+#include <assert.h>
+#include <string>
+#include <vector>
+
+class TriangleMesh;
+
+/** A height field of a track, used for the collision of particles with
+ *  the ground. It stores the height of the track sampled on a regular grid
+ *  with resolution x resolution points covering the track's bounding box.
+ *  Each sample is the highest ground at that position, so the height map
+ *  can not be used for ground queries on tracks with several levels (e.g.
+ *  below a bridge), which is why karts, the AI and items still use
+ *  raycasts.
+ *  Building the height map needs one raycast per sample, so this is done
+ *  in parallel, and the result is cached on disk (keyed by a hash of the
+ *  track's triangle mesh).
+ * \ingroup tracks
+ */
+class HeightMap : public NoCopy
+{
+private:
+    /** Minimum x and z coordinate covered by this height map. */
+    float m_min_x, m_min_z;
+
+    /** Distance between two samples in x and z direction. */
+    float m_x_step, m_z_step;
+
+    /** The height used if no terrain was found at a sample point. */
+    float m_no_hit_height;
+
+    /** Number of samples in each direction. */
+    unsigned int m_resolution;
+
+    /** Hash of the triangle mesh from which this height map was built. */
+    uint32_t m_mesh_hash;
+
+    /** The samples, stored row-major (x index major, z index minor), i.e.
+     *  sample (i,j) is at index i*resolution+j. */
+    std::vector<float> m_samples;
+
+public:
+         HeightMap(const Vec3 &aabb_min, const Vec3 &aabb_max,
+                   unsigned int resolution);
+    void build(const TriangleMesh &tm, float from_height);
+    bool load(const std::string &filename, const TriangleMesh &tm);
+    void save(const std::string &filename) const;
+
+    // ------------------------------------------------------------------------
+    /** Returns the number of samples in each direction. */
+    unsigned int getResolution() const { return m_resolution; }
+    // ------------------------------------------------------------------------
+    /** Returns the raw samples, i.e. the height at
+     *  (min_x + i*x_step, min_z + j*z_step) is at index i*resolution+j. */
+    const std::vector<float> &getSamples() const { return m_samples; }
+    // ------------------------------------------------------------------------
+    /** Returns the height of sample (i, j). */
+    float getSample(unsigned int i, unsigned int j) const
+    {
+        assert(i<m_resolution && j<m_resolution);
+        return m_samples[i*m_resolution+j];
+    }   // getSample
+};   // HeightMap
+
+#endif
@@ -54,19 +54,21 @@ const std::vector<Vec3>  NavPoly::getVertices()
 
 bool NavPoly::pointInPoly(const Vec3& p, bool ignore_vertical) const
 {
-    std::vector<Vec3> points;
-    for(unsigned int i=0; i<m_vertices.size(); i++)
-        points.push_back(NavMesh::get()->getVertex(m_vertices[i]));
+    // Access the vertices directly instead of copying them into a vector,
+    // this function is called very often.
+    const NavMesh *nm = NavMesh::get();
+    const unsigned int n = (unsigned int)m_vertices.size();
 
     // The point is on which side of the first edge
-    float side = p.sideOfLine2D(points[0],points[1]);
+    float side = p.sideOfLine2D(nm->getVertex(m_vertices[0]),
+                                nm->getVertex(m_vertices[1]));
 
     // The point is inside the polygon if it is on the same side for all edges
-    for(unsigned int i=1; i<points.size(); i++)
+    for(unsigned int i=1; i<n; i++)
     {
         // If it is on different side then product is < 0 , return false
-        if(p.sideOfLine2D(points[i % points.size()],
-                            points[(i+1)% points.size()]) * side < 0)
+        if(p.sideOfLine2D(nm->getVertex(m_vertices[i % n]),
+                          nm->getVertex(m_vertices[(i+1) % n])) * side < 0)
             return false;
     }
 
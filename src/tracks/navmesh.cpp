@@ -20,6 +20,7 @@
 #include "tracks/nav_poly.hpp"
 
 #include <algorithm>
+#include <math.h>
 #include <S3DVertex.h>
 #include <triangle3d.h>
 
@@ -41,6 +42,9 @@ NavMesh::NavMesh(const std::string &filename)
     m_max = Vec3(-99999, -99999, -99999);
     m_n_verts=0;
     m_n_polys=0;
+    m_grid_min_x = m_grid_min_z = 0;
+    m_grid_cell_size = 1.0f;
+    m_grid_num_x = m_grid_num_z = 0;
 
     XMLNode *xml = file_manager->createXMLTree(filename);
     if(xml->getName()!="navmesh")
@@ -112,6 +116,7 @@ NavMesh::NavMesh(const std::string &filename)
 
     delete xml;
 
+    buildGrid();
 } // NavMesh
 
 // ----------------------------------------------------------------------------
@@ -120,6 +125,93 @@ NavMesh::~NavMesh()
 {
 }  // ~NavMesh
 
+// ----------------------------------------------------------------------------
+/** Builds the 2d grid used by findPoly. The cell size is chosen so that
+ *  there are about as many cells as polygons.
+ */
+void NavMesh::buildGrid()
+{
+    if(m_n_polys==0) return;
+
+    const float x_len = m_max.getX() - m_min.getX();
+    const float z_len = m_max.getZ() - m_min.getZ();
+    const int MAX_CELLS = 512;
+    m_grid_cell_size = std::max(sqrtf(x_len*z_len/m_n_polys), 1.0f);
+    m_grid_cell_size = std::max(m_grid_cell_size,
+                                std::max(x_len, z_len)/(MAX_CELLS-1));
+    m_grid_min_x = m_min.getX();
+    m_grid_min_z = m_min.getZ();
+    m_grid_num_x = (int)(x_len/m_grid_cell_size)+1;
+    m_grid_num_z = (int)(z_len/m_grid_cell_size)+1;
+    m_grid_cells.resize(m_grid_num_x*m_grid_num_z);
+
+    for(unsigned int n=0; n<m_n_polys; n++)
+    {
+        const std::vector<int> indices = m_polys[n].getVerticesIndex();
+        if(indices.empty()) continue;
+        Vec3 min = m_verts[indices[0]];
+        Vec3 max = min;
+        for(unsigned int k=1; k<indices.size(); k++)
+        {
+            min.min(m_verts[indices[k]]);
+            max.max(m_verts[indices[k]]);
+        }
+        int i0, j0, i1, j1;
+        getGridCell(min, &i0, &j0);
+        getGridCell(max, &i1, &j1);
+        for(int i=i0; i<=i1; i++)
+            for(int j=j0; j<=j1; j++)
+                m_grid_cells[i*m_grid_num_z+j].push_back(n);
+    }   // for n<m_n_polys
+}   // buildGrid
+
+// ----------------------------------------------------------------------------
+/** Determines the grid cell that contains a point. If the point is outside
+ *  of the grid, the closest cell is returned.
+ *  \param xyz The point.
+ *  \param i, j On return the indices of the cell in x and z direction.
+ *  \return True if the point is inside of the grid.
+ */
+bool NavMesh::getGridCell(const Vec3 &xyz, int *i, int *j) const
+{
+    const float fi = (xyz.getX()-m_grid_min_x)/m_grid_cell_size;
+    const float fj = (xyz.getZ()-m_grid_min_z)/m_grid_cell_size;
+    const bool inside = fi>=0 && fi<m_grid_num_x && fj>=0 && fj<m_grid_num_z;
+    *i = fi<0 ? 0 : std::min((int)fi, m_grid_num_x-1);
+    *j = fj<0 ? 0 : std::min((int)fj, m_grid_num_z-1);
+    return inside;
+}   // getGridCell
+
+// ----------------------------------------------------------------------------
+/** Returns the polygon that contains the given point, or -1 if the point
+ *  is not on the navmesh. If more than one polygon contains the point (e.g.
+ *  on bridges), the one with the smallest index is returned (same as testing
+ *  all polygons in order), or the one with the largest index if last_match
+ *  is true.
+ *  \param xyz The point.
+ *  \param ignore_vertical If true, the height of the point is ignored.
+ *  \param last_match If true, return the last instead of the first match.
+ */
+int NavMesh::findPoly(const Vec3 &xyz, bool ignore_vertical,
+                      bool last_match) const
+{
+    int i, j;
+    if(!getGridCell(xyz, &i, &j))
+        return -1;
+    const std::vector<int> &cell = m_grid_cells[i*m_grid_num_z+j];
+    int result = -1;
+    for(unsigned int k=0; k<cell.size(); k++)
+    {
+        if(m_polys[cell[k]].pointInPoly(xyz, ignore_vertical))
+        {
+            if(!last_match)
+                return cell[k];
+            result = cell[k];
+        }
+    }
+    return result;
+}   // findPoly
+
 // ----------------------------------------------------------------------------
 /** Sets the vertices in a irrlicht vertex array to the 4 points of this quad.
  */
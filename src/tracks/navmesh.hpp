@@ -72,6 +72,23 @@ private:
     /** Maximum vertices per polygon */
     unsigned int                    m_nvp;
 
+    /** A 2d uniform grid over the x/z bounding box of the navmesh. Each
+     *  cell contains the indices (in increasing order) of all polygons
+     *  whose bounding box overlaps the cell. Used to find the polygon
+     *  that contains a point without testing all polygons. */
+    std::vector<std::vector<int> >  m_grid_cells;
+
+    /** Minimum x and z coordinate of the grid. */
+    float                           m_grid_min_x, m_grid_min_z;
+
+    /** Size of a grid cell in x and z direction. */
+    float                           m_grid_cell_size;
+
+    /** Number of grid cells in x and z direction. */
+    int                             m_grid_num_x, m_grid_num_z;
+
+    void buildGrid();
+    bool getGridCell(const Vec3 &xyz, int *i, int *j) const;
     void readVertex(const XMLNode *xml, Vec3* result) const;
     //void readFace(const XMLNode *xml, Vec3* result) const;
     NavMesh(const std::string &filename);
@@ -157,6 +174,9 @@ public:
      *    of a given polygon. */
     const std::vector<Vec3> getVertsOfPoly(int n)
                                 {return m_polys[n].getVertices();}
+    // ------------------------------------------------------------------------
+    int                     findPoly(const Vec3 &xyz, bool ignore_vertical,
+                                     bool last_match=false) const;
 
 };
 #endif
@@ -22,6 +22,8 @@
 
 #include <IMesh.h>
 #include <ICameraSceneNode.h>
+#include <algorithm>
+#include <math.h>
 #include "graphics/central_settings.hpp"
 #include "config/user_config.hpp"
 #include "graphics/callbacks.hpp"
@@ -36,11 +38,13 @@
 #include "tracks/check_line.hpp"
 #include "tracks/check_manager.hpp"
 #include "tracks/quad_set.hpp"
+#include "tracks/racing_line.hpp"
 #include "tracks/track.hpp"
 #include "graphics/glwrap.hpp"
 
 const int QuadGraph::UNKNOWN_SECTOR  = -1;
 QuadGraph *QuadGraph::m_quad_graph = NULL;
+bool       QuadGraph::m_racing_line_enabled = false;
 
 /** Constructor, loads the graph information for a given set of quads
  *  from a graph file.
@@ -57,12 +61,18 @@ QuadGraph::QuadGraph(const std::string &quad_file_name,
     m_quad_filename        = quad_file_name;
     m_quad_graph           = this;
     load(graph_file_name);
+    buildGrid();
+    // Computing the racing line is expensive the first time a track is
+    // used, so it is only done if the AI uses it.
+    m_racing_line          = m_racing_line_enabled ? new RacingLine(*this)
+                                                   : NULL;
 }   // QuadGraph
 
 // -----------------------------------------------------------------------------
 /** Destructor, removes all nodes of the graph. */
 QuadGraph::~QuadGraph()
 {
+    delete m_racing_line;
     QuadSet::destroy();
     for(unsigned int i=0; i<m_all_nodes.size(); i++) {
         delete m_all_nodes[i];
@@ -202,6 +212,80 @@ void QuadGraph::load(const std::string &filename)
     }
 }   // load
 
+// -----------------------------------------------------------------------------
+/** Builds the 2d grid used to quickly find the graph nodes close to a
+ *  point. The cell size is chosen so that there are about as many cells
+ *  as graph nodes.
+ */
+void QuadGraph::buildGrid()
+{
+    m_grid_cells.clear();
+    m_grid_min_x     = m_grid_min_z = 0;
+    m_grid_cell_size = 1.0f;
+    m_grid_num_x     = m_grid_num_z = 0;
+    if(m_all_nodes.empty()) return;
+
+    Vec3 min = getQuadOfNode(0)[0];
+    Vec3 max = min;
+    for(unsigned int n=0; n<m_all_nodes.size(); n++)
+    {
+        const Quad &q = getQuadOfNode(n);
+        for(unsigned int k=0; k<4; k++)
+        {
+            min.min(q[k]);
+            max.max(q[k]);
+        }
+    }   // for n<m_all_nodes.size()
+    m_grid_min_x = min.getX();
+    m_grid_min_z = min.getZ();
+    const float max_x = max.getX();
+    const float max_z = max.getZ();
+
+    const float area = (max_x-m_grid_min_x) * (max_z-m_grid_min_z);
+    m_grid_cell_size = std::max(sqrtf(area/m_all_nodes.size()), 1.0f);
+    const int MAX_CELLS = 512;
+    m_grid_cell_size = std::max(m_grid_cell_size,
+                            std::max(max_x-m_grid_min_x,
+                                     max_z-m_grid_min_z)/(MAX_CELLS-1));
+    m_grid_num_x = (int)((max_x-m_grid_min_x)/m_grid_cell_size)+1;
+    m_grid_num_z = (int)((max_z-m_grid_min_z)/m_grid_cell_size)+1;
+    m_grid_cells.resize(m_grid_num_x*m_grid_num_z);
+
+    for(unsigned int n=0; n<m_all_nodes.size(); n++)
+    {
+        const Quad &q = getQuadOfNode(n);
+        min = max = q[0];
+        for(unsigned int k=1; k<4; k++)
+        {
+            min.min(q[k]);
+            max.max(q[k]);
+        }
+        int i0, j0, i1, j1;
+        getGridCell(min, &i0, &j0);
+        getGridCell(max, &i1, &j1);
+        for(int i=i0; i<=i1; i++)
+            for(int j=j0; j<=j1; j++)
+                m_grid_cells[i*m_grid_num_z+j].push_back(n);
+    }   // for n<m_all_nodes.size()
+}   // buildGrid
+
+// -----------------------------------------------------------------------------
+/** Determines the grid cell that contains a point. If the point is outside
+ *  of the grid, the closest cell is returned.
+ *  \param xyz The point.
+ *  \param i, j On return the indices of the cell in x and z direction.
+ *  \return True if the point is inside of the grid.
+ */
+bool QuadGraph::getGridCell(const Vec3 &xyz, int *i, int *j) const
+{
+    const float fi = (xyz.getX()-m_grid_min_x)/m_grid_cell_size;
+    const float fj = (xyz.getZ()-m_grid_min_z)/m_grid_cell_size;
+    const bool inside = fi>=0 && fi<m_grid_num_x && fj>=0 && fj<m_grid_num_z;
+    *i = fi<0 ? 0 : std::min((int)fi, m_grid_num_x-1);
+    *j = fj<0 ? 0 : std::min((int)fj, m_grid_num_z-1);
+    return inside;
+}   // getGridCell
+
 // ----------------------------------------------------------------------------
 /** Returns the index of the first graph node (i.e. the graph node which
  *  will trigger a new lap when a kart first enters it). This is always
@@ -664,6 +748,28 @@ void QuadGraph::findRoadSector(const Vec3& xyz, int *sector,
                             ? (unsigned int)all_sectors->size()
                             : (unsigned int)m_all_nodes.size();
     *sector = UNKNOWN_SECTOR;
+
+    // If all sectors need to be tested, only the graph nodes whose quad
+    // overlaps the grid cell containing xyz can contain xyz.
+    if(!all_sectors)
+    {
+        int i, j;
+        if(!getGridCell(xyz, &i, &j))
+            return;
+        const std::vector<int> &cell = m_grid_cells[i*m_grid_num_z+j];
+        for(unsigned int k=0; k<cell.size(); k++)
+        {
+            const Quad &q = getQuadOfNode(cell[k]);
+            float dist    = xyz.getY() - q.getMinHeight();
+            if(q.pointInQuad(xyz) && dist < min_dist && dist>-1.0f)
+            {
+                min_dist = dist;
+                *sector  = cell[k];
+            }
+        }   // for k<cell.size()
+        return;
+    }   // if !all_sectors
+
     for(unsigned int i=0; i<max_count; i++)
     {
         if(all_sectors)
@@ -740,6 +846,22 @@ int QuadGraph::findOutOfRoadSector(const Vec3& xyz,
         if(current_sector<0) current_sector += getNumNodes();
     }
 
+    // Without a list of sectors use the grid to only test the graph nodes
+    // close to xyz. As in the loop below, the height condition is dropped
+    // if no node fulfills it.
+    if(!all_sectors)
+    {
+        const int first_node = (current_sector+1) % getNumNodes();
+        int min_sector = findClosestNode(xyz, first_node,
+                                         /*height_test*/true);
+        if(min_sector==UNKNOWN_SECTOR)
+            min_sector = findClosestNode(xyz, first_node,
+                                         /*height_test*/false);
+        if(min_sector==UNKNOWN_SECTOR)
+            Log::info("Quad Grap", "unknown sector found.");
+        return min_sector;
+    }   // if !all_sectors
+
     int   min_sector = UNKNOWN_SECTOR;
     float min_dist_2 = 999999.0f*999999.0f;
 
@@ -789,3 +911,91 @@ int QuadGraph::findOutOfRoadSector(const Vec3& xyz,
     }
     return min_sector;
 }   // findOutOfRoadSector
+
+//-----------------------------------------------------------------------------
+/** Finds the graph node whose driveline segment is closest (in 2d) to
+ *  xyz, using the grid. The cells are tested in rings of increasing
+ *  distance around the cell containing xyz, till no unvisited cell can
+ *  contain a closer node.
+ *  \param xyz The point.
+ *  \param first_node If two nodes have the same distance, the one that
+ *         follows first_node first (in index order) is returned. This
+ *         gives the same result as the linear search starting at
+ *         first_node.
+ *  \param height_test If true, only nodes whose quad is not too far
+ *         above or below xyz are considered.
+ */
+int QuadGraph::findClosestNode(const Vec3 &xyz, int first_node,
+                               bool height_test) const
+{
+    const int num_nodes = getNumNodes();
+    int   min_sector    = UNKNOWN_SECTOR;
+    float min_dist_2    = 999999.0f*999999.0f;
+
+    int ci, cj;
+    getGridCell(xyz, &ci, &cj);
+    const int max_ring = std::max(m_grid_num_x, m_grid_num_z);
+    for(int r=0; r<=max_ring; r++)
+    {
+        for(int i=ci-r; i<=ci+r; i++)
+        {
+            if(i<0 || i>=m_grid_num_x) continue;
+            // Inner rows of the ring only have a cell at either end.
+            const int step = (r==0 || i==ci-r || i==ci+r) ? 1 : 2*r;
+            for(int j=cj-r; j<=cj+r; j+=step)
+            {
+                if(j<0 || j>=m_grid_num_z) continue;
+                const std::vector<int> &cell = m_grid_cells[i*m_grid_num_z+j];
+                for(unsigned int k=0; k<cell.size(); k++)
+                {
+                    const int n = cell[k];
+                    float dist_2 = m_all_nodes[n]->getDistance2FromPoint(xyz);
+                    if(dist_2>min_dist_2) continue;
+                    if(dist_2==min_dist_2 &&
+                        (n         -first_node+num_nodes) % num_nodes >=
+                        (min_sector-first_node+num_nodes) % num_nodes    )
+                        continue;
+                    float dist = xyz.getY() - getQuadOfNode(n).getMinHeight();
+                    if(!height_test || (dist < 5.0f && dist>-1.0f) )
+                    {
+                        min_dist_2 = dist_2;
+                        min_sector = n;
+                    }
+                }   // for k<cell.size()
+            }   // for j
+        }   // for i
+
+        // Compute the minimum distance of xyz to all cells outside of
+        // the rings tested so far. Sides without further cells are ignored.
+        bool  more_cells = false;
+        float bound      = 0;
+        if(ci-r>0)
+        {
+            float d = xyz.getX() - (m_grid_min_x + (ci-r)*m_grid_cell_size);
+            bound = more_cells ? std::min(bound, d) : d;
+            more_cells = true;
+        }
+        if(ci+r<m_grid_num_x-1)
+        {
+            float d = m_grid_min_x + (ci+r+1)*m_grid_cell_size - xyz.getX();
+            bound = more_cells ? std::min(bound, d) : d;
+            more_cells = true;
+        }
+        if(cj-r>0)
+        {
+            float d = xyz.getZ() - (m_grid_min_z + (cj-r)*m_grid_cell_size);
+            bound = more_cells ? std::min(bound, d) : d;
+            more_cells = true;
+        }
+        if(cj+r<m_grid_num_z-1)
+        {
+            float d = m_grid_min_z + (cj+r+1)*m_grid_cell_size - xyz.getZ();
+            bound = more_cells ? std::min(bound, d) : d;
+            more_cells = true;
+        }
+        // Stop if all cells were visited, or no closer node can be found.
+        if(!more_cells || (bound>0 && bound*bound>min_dist_2))
+            break;
+    }   // for r<=max_ring
+    return min_sector;
+}   // findClosestNode
@@ -30,6 +30,7 @@
 
 class CheckLine;
 class GraphStructure;
+class RacingLine;
 
 /**
  *  \brief This class stores a graph of quads. It uses a 'simplified singleton'
@@ -47,6 +48,10 @@ class QuadGraph : public GraphStructure
 private:
     static QuadGraph        *m_quad_graph;
 
+    /** True if the racing line should be computed (it is only used by the
+     *  AI if requested on the command line). */
+    static bool              m_racing_line_enabled;
+
     /** The actual graph data structure. */
     std::vector<GraphNode*>  m_all_nodes;
 
@@ -59,6 +64,26 @@ private:
     /** Wether the graph should be reverted or not */
     bool                     m_reverse;
 
+    /** A 2d uniform grid over the x/z bounding box of all quads, used to
+     *  avoid testing all graph nodes in findRoadSector and
+     *  findOutOfRoadSector. Each cell contains the indices of all graph
+     *  nodes whose quad overlaps the cell (overlapping sections of a track
+     *  are in the same cell, they are distinguished by the height tests). */
+    std::vector<std::vector<int> > m_grid_cells;
+
+    /** Minimum x and z coordinate of the grid. */
+    float                    m_grid_min_x, m_grid_min_z;
+
+    /** Size of a grid cell in x and z direction. */
+    float                    m_grid_cell_size;
+
+    /** Number of grid cells in x and z direction. */
+    int                      m_grid_num_x, m_grid_num_z;
+
+    /** The precomputed racing line used by the AI, or NULL if the racing
+     *  line is not enabled. */
+    RacingLine              *m_racing_line;
+
     void setDefaultSuccessors();
     void computeChecklineRequirements(GraphNode* node, int latest_checkline);
     void computeDirectionData();
@@ -67,6 +92,10 @@ private:
 
     void addSuccessor(unsigned int from, unsigned int to);
     void load         (const std::string &filename);
+    void buildGrid();
+    bool getGridCell(const Vec3 &xyz, int *i, int *j) const;
+    int  findClosestNode(const Vec3 &xyz, int first_node,
+                         bool height_test) const;
     void computeDistanceFromStart(unsigned int start_node, float distance);
     unsigned int getStartNode() const;
          QuadGraph     (const std::string &quad_file_name,
@@ -137,6 +166,9 @@ public:
         new QuadGraph(quad_file_name, graph_file_name, reverse);
     }   // create
     // ------------------------------------------------------------------------
+    /** Enables the computation of the racing line when a graph is loaded. */
+    static void enableRacingLine() { m_racing_line_enabled = true; }
+    // ------------------------------------------------------------------------
     /** Cleans up the quad graph. It is possible that this function is called
      *  even if no instance exists (e.g. in battle mode). So it is not an
      *  error if there is no instance. */
@@ -181,6 +213,10 @@ public:
     float        getLapLength() const {return m_lap_length; }
     // ------------------------------------------------------------------------
     bool         isReverse() const {return m_reverse; }
+    // ------------------------------------------------------------------------
+    /** Returns the precomputed racing line of this graph, or NULL if the
+     *  racing line is not enabled. */
+    const RacingLine* getRacingLine() const { return m_racing_line; }
 };   // QuadGraph
 
 #endif
@@ -0,0 +1,458 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "tracks/racing_line.hpp"
+
+#include "io/file_manager.hpp"
+#include "tracks/quad_graph.hpp"
+#include "utils/constants.hpp"
+#include "utils/job_system.hpp"
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+/** Identifies a racing line file, and the version of the file format and
+ *  of the algorithm (the cache must be invalidated if either changes). */
+static const uint32_t RACING_LINE_MAGIC   = 0x524b5453;   // "STKR"
+static const uint32_t RACING_LINE_VERSION = 1;
+
+/** The largest distance (in nodes) between neighbours used when smoothing
+ *  the racing line. */
+static const unsigned int MAX_STRIDE = 16;
+
+/** Number of smoothing iterations for each stride. */
+static const unsigned int NUM_ITERATIONS = 200;
+
+/** Minimum distance between the racing line and the edge of the road. */
+static const float EDGE_MARGIN = 1.0f;
+
+/** Distance between two points tested when checking if a straight line
+ *  stays on the road. */
+static const float SAMPLE_STEP = 1.0f;
+
+/** Maximum number of nodes the aim node can be ahead of a node. */
+static const unsigned int MAX_AIM_NODES = 30;
+
+/** Distance ahead of a node in which the smallest curve radius is
+ *  searched for getCurveRadiusAhead(). */
+static const float RADIUS_LOOK_AHEAD = 20.0f;
+
+/** The curve radius used for (nearly) straight parts of the line. */
+static const float MAX_RADIUS = 1000.0f;
+
+// ----------------------------------------------------------------------------
+/** Normalises an angle to be in [-pi, pi]. */
+static float normalizeAngle(float f)
+{
+    if     (f> M_PI) f -= 2*M_PI;
+    else if(f<-M_PI) f += 2*M_PI;
+    return f;
+}   // normalizeAngle
+
+// ----------------------------------------------------------------------------
+/** Creates the racing line for the given quad graph. It is either loaded
+ *  from the cache, or computed (and then saved in the cache).
+ *  \param qg The quad graph, which must be fully loaded.
+ */
+RacingLine::RacingLine(const QuadGraph &qg)
+{
+    m_num_nodes = qg.getNumNodes();
+    if(m_num_nodes==0) return;
+
+    // The racing line follows the first successor the AI can use.
+    m_next.resize(m_num_nodes);
+    m_prev.resize(m_num_nodes, m_num_nodes);
+    std::vector<unsigned int> succ;
+    for(unsigned int i=0; i<m_num_nodes; i++)
+    {
+        succ.clear();
+        qg.getSuccessors(i, succ, /*for_ai*/true);
+        if(succ.size()==0)
+            qg.getSuccessors(i, succ, /*for_ai*/false);
+        m_next[i] = succ.size()>0 ? succ[0] : i;
+        if(m_prev[m_next[i]]==m_num_nodes)
+            m_prev[m_next[i]] = i;
+    }
+    // Nodes not reached by the racing line (e.g. the beginning of a
+    // shortcut) use their first predecessor.
+    for(unsigned int i=0; i<m_num_nodes; i++)
+    {
+        if(m_prev[i]!=m_num_nodes) continue;
+        const GraphNode &node = qg.getNode(i);
+        m_prev[i] = node.getNumberOfPredecessors()>0 &&
+                    node.getPredecessor(0)>=0 ? node.getPredecessor(0) : i;
+    }
+
+    const uint32_t hash = computeHash(qg);
+    char hash_string[9];
+    snprintf(hash_string, 9, "%08x", hash);
+    const std::string cache_file = file_manager->getCachedDataDir()
+                                 + "racingline-" + hash_string + ".dat";
+    if(load(cache_file, hash))
+    {
+        computePoints(qg);
+        return;
+    }
+
+    const double start = StkTime::getRealTime();
+    computeOffsets(qg);
+    computeRadius();
+    computeAimNodes(qg);
+    Log::info("RacingLine", "Computed racing line for %d nodes in %f seconds.",
+              m_num_nodes, StkTime::getRealTime()-start);
+    save(cache_file, hash);
+}   // RacingLine
+
+// ----------------------------------------------------------------------------
+/** Returns the signed curvature (in 2d) of the circle through three points,
+ *  positive for left turns.
+ */
+static float getCurvature(const Vec3 &a, const Vec3 &b, const Vec3 &c)
+{
+    const Vec3 ab = b-a, ac = c-a;
+    const float length = ab.length_2d() * (c-b).length_2d() * ac.length_2d();
+    if(length<=0) return 0;
+    return 2.0f*(ab.getZ()*ac.getX() - ab.getX()*ac.getZ()) / length;
+}   // getCurvature
+
+// ----------------------------------------------------------------------------
+/** Computes the offsets of the racing line. Starting with the center line,
+ *  each point is repeatedly moved sideways so that the curvature of the
+ *  line at this point becomes the (distance weighted) average of the
+ *  curvature at its two neighbours, and then clamped to stay on the road.
+ *  This spreads each curve over the largest possible distance, giving the
+ *  usual outside-inside-outside line. Since this converges very slowly for
+ *  long curves, it is first done using neighbours that are several nodes
+ *  apart, and the stride is then halved till direct neighbours are used.
+ *  Each iteration is done for all nodes in parallel.
+ *  \param qg The quad graph.
+ */
+void RacingLine::computeOffsets(const QuadGraph &qg)
+{
+    m_offset.clear();
+    m_offset.resize(m_num_nodes, 0.0f);
+    computePoints(qg);
+
+    std::vector<float> new_offset(m_num_nodes);
+    std::vector<unsigned int> prev(m_num_nodes), next(m_num_nodes);
+    for(unsigned int stride=MAX_STRIDE; stride>=1; stride/=2)
+    {
+        // Determine the nodes 'stride' nodes before and after each node.
+        for(unsigned int i=0; i<m_num_nodes; i++)
+        {
+            prev[i] = next[i] = i;
+            for(unsigned int j=0; j<stride; j++)
+            {
+                prev[i] = m_prev[prev[i]];
+                next[i] = m_next[next[i]];
+            }
+        }
+
+        for(unsigned int iteration=0; iteration<NUM_ITERATIONS; iteration++)
+        {
+            JobSystem::get()->parallelFor(m_num_nodes,
+                [&](unsigned int i)
+                {
+                    const GraphNode &node = qg.getNode(i);
+                    const Vec3 &point = m_points[i];
+                    const Vec3 &p     = m_points[prev[i]];
+                    const Vec3 &n     = m_points[next[i]];
+                    const float length_prev = (point-p).length_2d();
+                    const float length_next = (n-point).length_2d();
+                    new_offset[i] = m_offset[i];
+                    if(length_prev+length_next<=0) return;
+
+                    const float curvature_prev =
+                        getCurvature(m_points[prev[prev[i]]], p, point);
+                    const float curvature_next =
+                        getCurvature(point, n, m_points[next[next[i]]]);
+                    const float target = ( length_next*curvature_prev
+                                          +length_prev*curvature_next)
+                                       / (length_prev+length_next);
+
+                    // Determine how the curvature changes when moving
+                    // the point sideways, and move it accordingly.
+                    const float DELTA = 0.01f;
+                    const float curvature = getCurvature(p, point, n);
+                    const float derivative =
+                        ( getCurvature(p, point+node.getRightUnitVector()*DELTA,
+                                       n)
+                         -curvature) / DELTA;
+                    if(fabsf(derivative)<1e-6f) return;
+                    // Damping avoids oscillations between neighbouring nodes.
+                    const float offset = m_offset[i]
+                                       + 0.5f*(target-curvature)/derivative;
+                    const float max_offset =
+                        std::max(0.0f, 0.5f*node.getPathWidth()-EDGE_MARGIN);
+                    new_offset[i] = std::max(-max_offset,
+                                             std::min(offset, max_offset));
+                }, 64);
+            m_offset.swap(new_offset);
+            computePoints(qg);
+        }   // for iteration<NUM_ITERATIONS
+    }   // for stride>=1
+}   // computeOffsets
+
+// ----------------------------------------------------------------------------
+/** Computes the point of the racing line at each node from the offsets.
+ *  \param qg The quad graph.
+ */
+void RacingLine::computePoints(const QuadGraph &qg)
+{
+    m_points.resize(m_num_nodes);
+    for(unsigned int i=0; i<m_num_nodes; i++)
+    {
+        const GraphNode &node = qg.getNode(i);
+        m_points[i] = node.getCenter() + node.getRightUnitVector()*m_offset[i];
+    }
+}   // computePoints
+
+// ----------------------------------------------------------------------------
+/** Computes the curve radius at each node as the radius of the circle
+ *  through the points two nodes before and after the node (in 2d), and
+ *  then the smallest radius a short distance ahead of each node.
+ */
+void RacingLine::computeRadius()
+{
+    m_radius.resize(m_num_nodes);
+    m_radius_ahead.resize(m_num_nodes);
+    JobSystem::get()->parallelFor(m_num_nodes,
+        [&](unsigned int i)
+        {
+            const Vec3 &p0 = m_points[m_prev[m_prev[i]]];
+            const Vec3 &p1 = m_points[i];
+            const Vec3 &p2 = m_points[m_next[m_next[i]]];
+            const Vec3 a = p1-p0, b = p2-p1, c = p2-p0;
+            const float cross = a.getX()*c.getZ() - a.getZ()*c.getX();
+            const float abc   = a.length_2d()*b.length_2d()*c.length_2d();
+            if(fabsf(cross)*2.0f*MAX_RADIUS <= abc)
+                m_radius[i] = MAX_RADIUS;
+            else
+                m_radius[i] = abc / (2.0f*fabsf(cross));
+        }, 64);
+
+    JobSystem::get()->parallelFor(m_num_nodes,
+        [&](unsigned int i)
+        {
+            float radius   = m_radius[i];
+            float distance = 0;
+            unsigned int n = i;
+            for(unsigned int j=0; j<m_num_nodes && distance<RADIUS_LOOK_AHEAD;
+                j++)
+            {
+                const unsigned int next = m_next[n];
+                if(next==i) break;
+                distance += (m_points[next]-m_points[n]).length_2d();
+                radius    = std::min(radius, m_radius[next]);
+                n         = next;
+            }
+            m_radius_ahead[i] = radius;
+        }, 64);
+}   // computeRadius
+
+// ----------------------------------------------------------------------------
+/** Computes the aim node for all nodes in parallel.
+ *  \param qg The quad graph.
+ */
+void RacingLine::computeAimNodes(const QuadGraph &qg)
+{
+    m_aim_node.resize(m_num_nodes);
+    JobSystem::get()->parallelFor(m_num_nodes,
+        [&](unsigned int i) { m_aim_node[i] = computeAimNode(qg, i); }, 16);
+}   // computeAimNodes
+
+// ----------------------------------------------------------------------------
+/** Returns the direction (in the x/z plane) of the racing line at a node.
+ *  \param node The graph node.
+ */
+float RacingLine::getDirection(unsigned int node) const
+{
+    const Vec3 diff = m_points[m_next[node]] - m_points[node];
+    return atan2f(diff.getX(), diff.getZ());
+}   // getDirection
+
+// ----------------------------------------------------------------------------
+/** Finds the node furthest ahead on the racing line whose point can be
+ *  reached in a straight line from the point of the given node without
+ *  leaving the road. Similar to SkiddingAI::findNonCrashingPoint() the
+ *  search stops before a very sharp turn, since aiming too far ahead would
+ *  make the kart hit the inner corner.
+ *  \param qg The quad graph.
+ *  \param node The node for which to compute the aim node.
+ */
+int RacingLine::computeAimNode(const QuadGraph &qg, unsigned int node) const
+{
+    unsigned int last = m_next[node];
+    const float angle = getDirection(node);
+    for(unsigned int j=0; j<MAX_AIM_NODES; j++)
+    {
+        const unsigned int target = m_next[last];
+        if(target==node || target==last)
+            break;
+        if(fabsf(normalizeAngle(getDirection(target)-angle))>1.5f)
+            break;
+        if(!isStraightOnRoad(qg, node, target))
+            break;
+        last = target;
+    }
+    return last;
+}   // computeAimNode
+
+// ----------------------------------------------------------------------------
+/** Tests if the straight line from the point of one node to the point of
+ *  a node further ahead stays on the road, by testing points along the
+ *  line against the node they are closest to.
+ *  \param qg The quad graph.
+ *  \param node The start node.
+ *  \param target The node to drive to.
+ */
+bool RacingLine::isStraightOnRoad(const QuadGraph &qg, unsigned int node,
+                                  unsigned int target) const
+{
+    const Vec3 &start = m_points[node];
+    const Vec3  diff  = m_points[target] - start;
+    unsigned int steps = (unsigned int)(diff.length_2d()/SAMPLE_STEP) + 1;
+    // Just in case of incorrect data, e.g. huge quads
+    if(steps>1000) steps = 1000;
+
+    unsigned int current = node;
+    for(unsigned int s=1; s<=steps; s++)
+    {
+        const Vec3 p = start + diff*(float(s)/steps);
+        // Move on to the next node while it is closer to the point
+        while(current!=target)
+        {
+            const unsigned int next = m_next[current];
+            if(qg.getNode(next   ).getDistance2FromPoint(p) >=
+               qg.getNode(current).getDistance2FromPoint(p)    )
+                break;
+            current = next;
+        }
+        Vec3 track_coord;
+        qg.getNode(current).getDistances(p, &track_coord);
+        if(fabsf(track_coord.getX()) + EDGE_MARGIN
+            > 0.5f*qg.getNode(current).getPathWidth())
+            return false;
+    }   // for s<=steps
+    return true;
+}   // isStraightOnRoad
+
+// ----------------------------------------------------------------------------
+/** Returns a hash value (FNV-1a) of all data the racing line depends on:
+ *  the quads of all nodes, the successors used, and the direction.
+ *  \param qg The quad graph.
+ */
+uint32_t RacingLine::computeHash(const QuadGraph &qg) const
+{
+    uint32_t hash = 2166136261u;
+    const auto add = [&hash](const void *data, size_t size)
+    {
+        const unsigned char *p = (const unsigned char*)data;
+        for(size_t i=0; i<size; i++)
+        {
+            hash ^= p[i];
+            hash *= 16777619u;
+        }
+    };
+    const uint32_t reverse = qg.isReverse() ? 1 : 0;
+    add(&reverse, sizeof(reverse));
+    for(unsigned int i=0; i<m_num_nodes; i++)
+    {
+        const Quad &quad = qg.getQuadOfNode(i);
+        for(unsigned int j=0; j<4; j++)
+        {
+            const float xyz[3] = { quad[j].getX(), quad[j].getY(),
+                                   quad[j].getZ() };
+            add(xyz, sizeof(xyz));
+        }
+        add(&m_next[i], sizeof(m_next[i]));
+    }
+    return hash;
+}   // computeHash
+
+// ----------------------------------------------------------------------------
+/** Loads the racing line from a cache file written by save().
+ *  \param filename Name of the cache file.
+ *  \param hash Hash of the quad graph, which must match the hash stored
+ *         in the cache file.
+ *  \return True if the cache file was valid.
+ */
+bool RacingLine::load(const std::string &filename, uint32_t hash)
+{
+    FILE *fd = fopen(filename.c_str(), "rb");
+    if(!fd) return false;
+
+    const unsigned int n = m_num_nodes;
+    std::vector<float> offset(n), radius(n), radius_ahead(n);
+    std::vector<int>   aim_node(n);
+    uint32_t header[4];
+    bool ok = fread(header, sizeof(uint32_t), 4, fd)==4 &&
+              header[0]==RACING_LINE_MAGIC             &&
+              header[1]==RACING_LINE_VERSION           &&
+              header[2]==hash && header[3]==n          &&
+              fread(offset.data(),       sizeof(float), n, fd)==n &&
+              fread(radius.data(),       sizeof(float), n, fd)==n &&
+              fread(radius_ahead.data(), sizeof(float), n, fd)==n &&
+              fread(aim_node.data(),     sizeof(int),   n, fd)==n;
+    fclose(fd);
+    for(unsigned int i=0; ok && i<n; i++)
+        ok = aim_node[i]>=0 && aim_node[i]<(int)n;
+    if(!ok)
+    {
+        Log::info("RacingLine", "Cached racing line in '%s' is outdated.",
+                  filename.c_str());
+        return false;
+    }
+    m_offset.swap(offset);
+    m_radius.swap(radius);
+    m_radius_ahead.swap(radius_ahead);
+    m_aim_node.swap(aim_node);
+    return true;
+}   // load
+
+// ----------------------------------------------------------------------------
+/** Saves the racing line to a cache file.
+ *  \param filename Name of the cache file.
+ *  \param hash Hash of the quad graph.
+ */
+void RacingLine::save(const std::string &filename, uint32_t hash) const
+{
+    FILE *fd = fopen(filename.c_str(), "wb");
+    if(!fd)
+    {
+        Log::warn("RacingLine", "Can't open '%s' for writing.",
+                  filename.c_str());
+        return;
+    }
+    const unsigned int n = m_num_nodes;
+    uint32_t header[4] = { RACING_LINE_MAGIC, RACING_LINE_VERSION, hash, n };
+    bool ok = fwrite(header, sizeof(uint32_t), 4, fd)==4 &&
+              fwrite(m_offset.data(),       sizeof(float), n, fd)==n &&
+              fwrite(m_radius.data(),       sizeof(float), n, fd)==n &&
+              fwrite(m_radius_ahead.data(), sizeof(float), n, fd)==n &&
+              fwrite(m_aim_node.data(),     sizeof(int),   n, fd)==n;
+    fclose(fd);
+    if(!ok)
+    {
+        Log::warn("RacingLine", "Error writing '%s'.", filename.c_str());
+        remove(filename.c_str());
+    }
+}   // save
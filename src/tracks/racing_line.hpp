@@ -0,0 +1,114 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_RACING_LINE_HPP
+#define HEADER_RACING_LINE_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+#include "utils/vec3.hpp"
+
+#include <string>
+#include <vector>
+
+class QuadGraph;
+
+/** A precomputed racing line for the AI. For each graph node of the quad
+ *  graph it stores a lateral offset from the center of the node (which
+ *  gives a smooth line cutting the corners), the curve radius of this line
+ *  at the node, the smallest curve radius on the line a short distance
+ *  ahead, and the node furthest ahead that can be reached in a straight
+ *  line from this node's point without leaving the road. The line follows
+ *  the first successor the AI is allowed to use at each node.
+ *  Since the quad graph is created for a specific direction (reverse or
+ *  not), the racing line is as well. Computing it is done in parallel, and
+ *  the result is cached on disk (keyed by a hash of the quad graph).
+ * \ingroup tracks
+ */
+class RacingLine : public NoCopy
+{
+private:
+    /** Number of graph nodes. */
+    unsigned int m_num_nodes;
+
+    /** The successor of each node that the racing line follows. */
+    std::vector<unsigned int> m_next;
+
+    /** The predecessor of each node on the racing line. */
+    std::vector<unsigned int> m_prev;
+
+    /** Offset of the racing line from the center of each node along the
+     *  right unit vector of the node. */
+    std::vector<float> m_offset;
+
+    /** Curve radius of the racing line at each node. */
+    std::vector<float> m_radius;
+
+    /** Smallest curve radius of the racing line in a short distance
+     *  ahead of each node. */
+    std::vector<float> m_radius_ahead;
+
+    /** The node furthest ahead that can be reached in a straight line
+     *  from the point of each node. */
+    std::vector<int> m_aim_node;
+
+    /** The point of the racing line at each node, computed from the
+     *  offsets. */
+    std::vector<Vec3> m_points;
+
+    void     computeOffsets(const QuadGraph &qg);
+    void     computeRadius();
+    void     computeAimNodes(const QuadGraph &qg);
+    void     computePoints(const QuadGraph &qg);
+    int      computeAimNode(const QuadGraph &qg, unsigned int node) const;
+    bool     isStraightOnRoad(const QuadGraph &qg, unsigned int node,
+                              unsigned int target) const;
+    float    getDirection(unsigned int node) const;
+    uint32_t computeHash(const QuadGraph &qg) const;
+    bool     load(const std::string &filename, uint32_t hash);
+    void     save(const std::string &filename, uint32_t hash) const;
+
+public:
+         RacingLine(const QuadGraph &qg);
+
+    // ------------------------------------------------------------------------
+    /** Returns the successor of a node the racing line follows. */
+    unsigned int getNext(unsigned int node) const { return m_next[node]; }
+    // ------------------------------------------------------------------------
+    /** Returns the offset of the racing line from the center of a node
+     *  along the node's right unit vector. */
+    float getOffset(unsigned int node) const { return m_offset[node]; }
+    // ------------------------------------------------------------------------
+    /** Returns the point of the racing line at a node. */
+    const Vec3& getPoint(unsigned int node) const { return m_points[node]; }
+    // ------------------------------------------------------------------------
+    /** Returns the curve radius of the racing line at a node. */
+    float getCurveRadius(unsigned int node) const { return m_radius[node]; }
+    // ------------------------------------------------------------------------
+    /** Returns the smallest curve radius of the racing line a short
+     *  distance ahead of a node, which can be used to determine the speed
+     *  a kart should have at that node. */
+    float getCurveRadiusAhead(unsigned int node) const
+                                           { return m_radius_ahead[node]; }
+    // ------------------------------------------------------------------------
+    /** Returns the node furthest ahead whose point can be reached in a
+     *  straight line from the point of the given node. */
+    int getAimNode(unsigned int node) const { return m_aim_node[node]; }
+};   // RacingLine
+
+#endif
@@ -34,6 +34,7 @@ TerrainInfo::TerrainInfo()
 {
     m_last_material = NULL;
     m_material      = NULL;
+    m_precomputed   = false;
 }   // TerrainInfo
 
 //-----------------------------------------------------------------------------
@@ -45,6 +46,7 @@ TerrainInfo::TerrainInfo(const Vec3 &pos)
     // initialise HoT
     m_last_material = NULL;
     m_material = NULL;
+    m_precomputed = false;
     update(pos);
 }   // TerrainInfo
 
@@ -68,30 +70,78 @@ void TerrainInfo::update(const Vec3 &from)
 }   // update
 
 //-----------------------------------------------------------------------------
-/** Update the terrain information based on the latest position.
- *  \param tran The transform ov the kart
+/** Does the actual raycast against the track and all driveable track
+ *  objects. This function does not modify this object, so it can be called
+ *  from different threads for different objects.
+ *  \param rotation The rotation of the object.
  *  \param from World coordinates from which to start the raycast.
+ *  \param hit_point On input the previous hit point, on return the new one.
+ *  \param material On input the previous material, on return the material
+ *         that was hit (or NULL).
+ *  \param normal On return the normal of the hit triangle.
  */
-void TerrainInfo::update(const btMatrix3x3 &rotation, const Vec3 &from)
+void TerrainInfo::castRay(const btMatrix3x3 &rotation, const Vec3 &from,
+                          Vec3 *hit_point, const Material **material,
+                          Vec3 *normal) const
 {
-    m_last_material = m_material;
-    // Save the origin for debug drawing
-    m_origin_ray    = from;
-
     // Compute the 'to' vector by rotating a long 'down' vectory by the
     // kart rotation, and adding the start point to it.
     btVector3 to(0, -10000.0f, 0);
     to = from + rotation*to;
 
     const TriangleMesh &tm = World::getWorld()->getTrack()->getTriangleMesh();
-    tm.castRay(from, to, &m_hit_point, &m_material, &m_normal,
-               /*interpolate*/true);
+    tm.castRay(from, to, hit_point, material, normal, /*interpolate*/true);
     // Now also raycast against all track objects (that are driveable). If
     // there should be a closer result (than the one against the main track 
     // mesh), its data will be returned.
     World::getWorld()->getTrack()->getTrackObjectManager()
-                     ->castRay(from, to, &m_hit_point, &m_material,
-                               &m_normal, /*interpolate*/true);
+                     ->castRay(from, to, hit_point, material, normal,
+                               /*interpolate*/true);
+}   // castRay
+
+//-----------------------------------------------------------------------------
+/** Does the raycast for the next call to update(rotation, from) in advance.
+ *  This only modifies this object, so it can be called in parallel for
+ *  different objects. If update() is then called with the same rotation and
+ *  origin, the stored result is used instead of doing the raycast again.
+ *  \param rotation The rotation of the object.
+ *  \param from World coordinates from which to start the raycast.
+ */
+void TerrainInfo::precompute(const btMatrix3x3 &rotation, const Vec3 &from)
+{
+    // Start with the current values, since castRay keeps the old hit
+    // point if nothing is hit.
+    m_precomputed_hit_point = m_hit_point;
+    m_precomputed_material  = m_material;
+    m_precomputed_normal    = m_normal;
+    castRay(rotation, from, &m_precomputed_hit_point,
+            &m_precomputed_material, &m_precomputed_normal);
+    m_precomputed_rotation  = rotation;
+    m_precomputed_from      = from;
+    m_precomputed           = true;
+}   // precompute
+
+//-----------------------------------------------------------------------------
+/** Update the terrain information based on the latest position.
+ *  \param tran The transform ov the kart
+ *  \param from World coordinates from which to start the raycast.
+ */
+void TerrainInfo::update(const btMatrix3x3 &rotation, const Vec3 &from)
+{
+    m_last_material = m_material;
+    // Save the origin for debug drawing
+    m_origin_ray    = from;
+
+    if(m_precomputed && from==m_precomputed_from &&
+       rotation==m_precomputed_rotation)
+    {
+        m_hit_point = m_precomputed_hit_point;
+        m_material  = m_precomputed_material;
+        m_normal    = m_precomputed_normal;
+    }
+    else
+        castRay(rotation, from, &m_hit_point, &m_material, &m_normal);
+    m_precomputed = false;
 }   // update
 
 // -----------------------------------------------------------------------------
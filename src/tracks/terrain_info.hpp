@@ -43,6 +43,20 @@ private:
     /** DEBUG only: origin of raycast. */
     Vec3 m_origin_ray;
 
+    /** True if the raycast for the next update was done in advance by
+     *  precompute(). */
+    bool              m_precomputed;
+    /** The rotation and origin used in precompute(). */
+    btMatrix3x3       m_precomputed_rotation;
+    Vec3              m_precomputed_from;
+    /** The results of the raycast done in precompute(). */
+    Vec3              m_precomputed_normal;
+    const Material   *m_precomputed_material;
+    Vec3              m_precomputed_hit_point;
+
+    void castRay(const btMatrix3x3 &rotation, const Vec3 &from,
+                 Vec3 *hit_point, const Material **material,
+                 Vec3 *normal) const;
 public:
              TerrainInfo();
              TerrainInfo(const Vec3 &pos);
@@ -52,6 +66,7 @@ public:
                             const Material **m);
     virtual void update(const btMatrix3x3 &rotation, const Vec3 &from);
     virtual void update(const Vec3 &from);
+    void     precompute(const btMatrix3x3 &rotation, const Vec3 &from);
 
     // ------------------------------------------------------------------------
     /** Simple wrapper with no offset. */
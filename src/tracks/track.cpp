@@ -38,6 +38,7 @@
 #include "graphics/particle_emitter.hpp"
 #include "graphics/particle_kind.hpp"
 #include "graphics/particle_kind_manager.hpp"
+#include "graphics/static_scene_bvh.hpp"
 #include "graphics/stk_text_billboard.hpp"
 #include "guiengine/scalable_font.hpp"
 #include "io/file_manager.hpp"
@@ -56,10 +57,12 @@
 #include "tracks/bezier_curve.hpp"
 #include "tracks/battle_graph.hpp"
 #include "tracks/check_manager.hpp"
+#include "tracks/height_map.hpp"
 #include "tracks/model_definition_loader.hpp"
 #include "tracks/track_manager.hpp"
 #include "tracks/quad_graph.hpp"
 #include "tracks/quad_set.hpp"
+#include "tracks/track_object.hpp"
 #include "tracks/track_object_manager.hpp"
 #include "utils/constants.hpp"
 #include "utils/log.hpp"
@@ -110,6 +113,7 @@ Track::Track(const std::string &filename)
     m_screenshot            = "";
     m_version               = 0;
     m_track_mesh            = NULL;
+    m_height_map            = NULL;
     m_gfx_effect_mesh       = NULL;
     m_internal              = false;
     m_enable_auto_rescue    = true;  // Below set to false in arenas
@@ -147,6 +151,7 @@ Track::Track(const std::string &filename)
     m_startup_run = false;
     m_default_number_of_laps= 3;
     m_all_nodes.clear();
+    m_static_scene_bvh      = NULL;
     m_static_physics_only_nodes.clear();
     m_all_cached_meshes.clear();
     loadTrackInfo();
@@ -294,6 +299,9 @@ void Track::cleanup()
     }
     m_animated_textures.clear();
 
+    delete m_static_scene_bvh;
+    m_static_scene_bvh = NULL;
+
     for (unsigned int i = 0; i < m_all_nodes.size(); i++)
     {
         irr_driver->removeNode(m_all_nodes[i]);
@@ -325,6 +333,9 @@ void Track::cleanup()
     delete m_track_mesh;
     m_track_mesh = NULL;
 
+    delete m_height_map;
+    m_height_map = NULL;
+
     delete m_gfx_effect_mesh;
     m_gfx_effect_mesh = NULL;
 
@@ -1746,6 +1757,21 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
     // Init all track objects
     m_track_object_manager->init();
 
+    // Collect the mesh nodes of the track and of all track objects for
+    // culling. The hierarchy is built when the first frame is drawn.
+    if (CVS->isGLSL())
+    {
+        m_static_scene_bvh = new StaticSceneBVH();
+        for (unsigned int i = 0; i < m_all_nodes.size(); i++)
+            m_static_scene_bvh->addNodes(m_all_nodes[i]);
+        for (TrackObject* object : m_track_object_manager->getObjects())
+        {
+            TrackObjectPresentationSceneNode *presentation =
+                object->getPresentation<TrackObjectPresentationSceneNode>();
+            if (presentation && presentation->getNode())
+                m_static_scene_bvh->addNodes(presentation->getNode());
+        }
+    }
 
     // ---- Fog
     // It's important to execute this BEFORE the code that creates the skycube,
@@ -2314,43 +2340,28 @@ bool Track::setTerrainHeight(Vec3 *pos) const
 }   // setTerrainHeight
 
 // ----------------------------------------------------------------------------
-
-std::vector< std::vector<float> > Track::buildHeightMap()
+/** Returns the height map of this track. On first use it is loaded from
+ *  the cache directory, or, if no up to date height map is cached there,
+ *  built from the track mesh and then saved.
+ */
+const HeightMap* Track::getHeightMap()
 {
-    std::vector< std::vector<float> > out(HEIGHT_MAP_RESOLUTION);
-
-    float x = m_aabb_min.getX();
-    const float x_len = m_aabb_max.getX() - m_aabb_min.getX();
-    const float z_len = m_aabb_max.getZ() - m_aabb_min.getZ();
-
-    const float x_step = x_len/HEIGHT_MAP_RESOLUTION;
-    const float z_step = z_len/HEIGHT_MAP_RESOLUTION;
-
-    btVector3 hitpoint;
-    const Material* material;
-    btVector3 normal;
-
-    for (int i=0; i<HEIGHT_MAP_RESOLUTION; i++)
-    {
-        out[i].resize(HEIGHT_MAP_RESOLUTION);
-        float z = m_aabb_min.getZ();
-
-        for (int j=0; j<HEIGHT_MAP_RESOLUTION; j++)
-        {
-            btVector3 pos(x, 100.0f, z);
-            btVector3 to = pos;
-            to.setY(-100000.f);
-
-            m_track_mesh->castRay(pos, to, &hitpoint, &material, &normal);
-            z += z_step;
-
-            out[i][j] = hitpoint.getY();
-        }   // j<HEIGHT_MAP_RESOLUTION
-        x += x_step;
-    }
-
-    return out;
-}   // buildHeightMap
+    if(m_height_map)
+        return m_height_map;
+
+    m_height_map = new HeightMap(m_aabb_min, m_aabb_max,
+                                 HEIGHT_MAP_RESOLUTION);
+    const std::string filename = file_manager->getCachedDataDir()
+                               + "heightmap-" + m_ident + ".dat";
+    if(!m_height_map->load(filename, *m_track_mesh))
+    {
+        // Start the rays above the track: bullet does not report a hit
+        // for a triangle whose plane contains the start of the ray.
+        m_height_map->build(*m_track_mesh, m_aabb_max.getY() + 1.0f);
+        m_height_map->save(filename);
+    }
+    return m_height_map;
+}   // getHeightMap
 
 // ----------------------------------------------------------------------------
 /** Returns the rotation of the sun. */
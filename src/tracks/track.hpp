@@ -52,11 +52,13 @@ class ModelDefinitionLoader;
 class AnimationManager;
 class BezierCurve;
 class CheckManager;
+class HeightMap;
 class MovingTexture;
 class MusicInformation;
 class ParticleEmitter;
 class ParticleKind;
 class PhysicalObject;
+class StaticSceneBVH;
 class TrackObject;
 class TrackObjectManager;
 class TriangleMesh;
@@ -142,6 +144,10 @@ private:
     /** The list of all nodes. */
     std::vector<scene::ISceneNode*> m_all_nodes;
 
+    /** A bounding volume hierarchy over the mesh nodes of the track and
+     *  the track objects, used for culling. NULL if not using shaders. */
+    StaticSceneBVH                 *m_static_scene_bvh;
+
     /** The list of all nodes that are to be converted into physics,
      *  but not to be drawn (e.g. invisible walls). */
     std::vector<scene::ISceneNode*> m_static_physics_only_nodes;
@@ -192,6 +198,8 @@ private:
     scene::ISceneNode  *m_sun;
     /** Used to collect the triangles for the bullet mesh. */
     TriangleMesh*            m_track_mesh;
+    /** The height map of this track, created on first use. */
+    HeightMap*               m_height_map;
     /** Used to collect the triangles which do not have a physical
      *  representation, but are needed for some raycast effects. An
      *  example is a water surface: the karts ignore this (i.e.
@@ -431,7 +439,7 @@ public:
                                         unsigned int mode_id=0);
     bool findGround(AbstractKart *kart);
 
-    std::vector< std::vector<float> > buildHeightMap();
+    const HeightMap*   getHeightMap();
     // ------------------------------------------------------------------------
     /** Returns the texture with the mini map for this track. */
     const video::ITexture*    getOldRttMiniMap() const { return m_old_rtt_mini_map; }
@@ -643,6 +651,10 @@ public:
     // ------------------------------------------------------------------------
     void addNode(scene::ISceneNode* node) { m_all_nodes.push_back(node); }
     // ------------------------------------------------------------------------
+    /** Returns the bounding volume hierarchy over the static mesh nodes, or
+     *  NULL if there is none. */
+    StaticSceneBVH* getStaticSceneBVH() { return m_static_scene_bvh; }
+    // ------------------------------------------------------------------------
     void addPhysicsOnlyNode(scene::ISceneNode* node)
     {
         m_object_physics_only_nodes.push_back(node);
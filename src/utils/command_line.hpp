@@ -117,5 +117,8 @@ public:
     // ------------------------------------------------------------------------
     /** Returns the name of the executable. */
     static const std::string& getExecName() { return m_exec_name; }
+    // ------------------------------------------------------------------------
+    /** Returns all parameters that have not been handled yet. */
+    static const std::vector<std::string>& getArgv() { return m_argv; }
 };   // CommandLine
 #endif
@@ -0,0 +1,284 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/job_system.hpp"
+
+#include "config/hardware_stats.hpp"
+#include "utils/log.hpp"
+
+JobSystem *JobSystem::m_job_system = NULL;
+
+// ----------------------------------------------------------------------------
+/** Creates the job system.
+ *  \param num_threads Total number of threads to use (including the main
+ *         thread). If this is negative, one thread per processor is used.
+ */
+void JobSystem::create(int num_threads)
+{
+    assert(!m_job_system);
+    if(num_threads<0)
+        num_threads = HardwareStats::getNumProcessors();
+    if(num_threads<1)
+        num_threads = 1;
+    m_job_system = new JobSystem(num_threads);
+}   // create
+
+// ----------------------------------------------------------------------------
+/** Destroys the job system and stops all worker threads.
+ */
+void JobSystem::destroy()
+{
+    assert(m_job_system);
+    delete m_job_system;
+    m_job_system = NULL;
+}   // destroy
+
+// ----------------------------------------------------------------------------
+/** Creates the queues and starts num_threads-1 worker threads.
+ *  \param num_threads Total number of threads including the main thread.
+ */
+JobSystem::JobSystem(unsigned int num_threads)
+{
+    m_remaining   = 0;
+    m_generation  = 0;
+    m_quit        = false;
+    m_loop_active = false;
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_cond_work, NULL);
+    pthread_cond_init(&m_cond_done, NULL);
+
+    for(unsigned int i=0; i<num_threads; i++)
+    {
+        Queue *q = new Queue();
+        pthread_mutex_init(&q->m_mutex, NULL);
+        m_queues.push_back(q);
+    }
+
+    // Reserve the space, so that the pointers passed to the threads
+    // stay valid.
+    m_thread_data.resize(num_threads);
+    m_threads.reserve(num_threads);
+    for(unsigned int i=1; i<num_threads; i++)
+    {
+        m_thread_data[i].m_job_system = this;
+        m_thread_data[i].m_index      = i;
+        pthread_t thread;
+        int error = pthread_create(&thread, NULL, &JobSystem::threadMain,
+                                   &m_thread_data[i]);
+        if(error)
+        {
+            Log::error("JobSystem", "Could not create thread, error=%d.",
+                       error);
+            break;
+        }
+        m_threads.push_back(thread);
+    }
+
+    // If not all threads could be created, remove the unused queues.
+    while(m_queues.size() > m_threads.size()+1)
+    {
+        pthread_mutex_destroy(&m_queues.back()->m_mutex);
+        delete m_queues.back();
+        m_queues.pop_back();
+    }
+    Log::info("JobSystem", "Using %d threads.", (int)m_queues.size());
+}   // JobSystem
+
+// ----------------------------------------------------------------------------
+JobSystem::~JobSystem()
+{
+    pthread_mutex_lock(&m_mutex);
+    m_quit = true;
+    pthread_cond_broadcast(&m_cond_work);
+    pthread_mutex_unlock(&m_mutex);
+
+    for(unsigned int i=0; i<m_threads.size(); i++)
+        pthread_join(m_threads[i], NULL);
+
+    for(unsigned int i=0; i<m_queues.size(); i++)
+    {
+        pthread_mutex_destroy(&m_queues[i]->m_mutex);
+        delete m_queues[i];
+    }
+    pthread_cond_destroy(&m_cond_done);
+    pthread_cond_destroy(&m_cond_work);
+    pthread_mutex_destroy(&m_mutex);
+}   // ~JobSystem
+
+// ----------------------------------------------------------------------------
+/** The main function of a worker thread: it waits till a new loop is
+ *  started, and then helps executing it.
+ *  \param data Pointer to the ThreadData of this thread.
+ */
+void *JobSystem::threadMain(void *data)
+{
+    ThreadData *td = (ThreadData*)data;
+    JobSystem  *me = td->m_job_system;
+
+    unsigned int last_generation = 0;
+    pthread_mutex_lock(&me->m_mutex);
+    while(true)
+    {
+        while(!me->m_quit && me->m_generation==last_generation)
+            pthread_cond_wait(&me->m_cond_work, &me->m_mutex);
+        if(me->m_quit)
+            break;
+        last_generation = me->m_generation;
+        pthread_mutex_unlock(&me->m_mutex);
+        me->work(td->m_index);
+        pthread_mutex_lock(&me->m_mutex);
+    }
+    pthread_mutex_unlock(&me->m_mutex);
+    return NULL;
+}   // threadMain
+
+// ----------------------------------------------------------------------------
+/** Adds a range to the back of the specified queue.
+ */
+void JobSystem::pushRange(unsigned int queue_index, const Range &range)
+{
+    Queue *q = m_queues[queue_index];
+    pthread_mutex_lock(&q->m_mutex);
+    q->m_ranges.push_back(range);
+    pthread_mutex_unlock(&q->m_mutex);
+}   // pushRange
+
+// ----------------------------------------------------------------------------
+/** Gets the next range to execute: first from the back of the own queue,
+ *  then from the front of the queues of all other threads.
+ *  \param queue_index Index of the queue of the calling thread.
+ *  \param range On return the range to execute.
+ *  \return False if no work was found.
+ */
+bool JobSystem::getRange(unsigned int queue_index, Range *range)
+{
+    Queue *own = m_queues[queue_index];
+    pthread_mutex_lock(&own->m_mutex);
+    if(!own->m_ranges.empty())
+    {
+        *range = own->m_ranges.back();
+        own->m_ranges.pop_back();
+        pthread_mutex_unlock(&own->m_mutex);
+        return true;
+    }
+    pthread_mutex_unlock(&own->m_mutex);
+
+    const unsigned int n = (unsigned int)m_queues.size();
+    for(unsigned int i=1; i<n; i++)
+    {
+        Queue *victim = m_queues[(queue_index+i) % n];
+        pthread_mutex_lock(&victim->m_mutex);
+        if(!victim->m_ranges.empty())
+        {
+            *range = victim->m_ranges.front();
+            victim->m_ranges.pop_front();
+            pthread_mutex_unlock(&victim->m_mutex);
+            return true;
+        }
+        pthread_mutex_unlock(&victim->m_mutex);
+    }
+    return false;
+}   // getRange
+
+// ----------------------------------------------------------------------------
+/** Executes ranges till no more work can be found.
+ *  \param queue_index Index of the queue of the calling thread.
+ */
+void JobSystem::work(unsigned int queue_index)
+{
+    Range range;
+    while(getRange(queue_index, &range))
+    {
+        // Split large ranges, and make the second half available
+        // for other threads to steal.
+        while(range.m_end - range.m_begin > range.m_loop->m_grain_size)
+        {
+            Range second = range;
+            second.m_begin = range.m_begin + (range.m_end-range.m_begin)/2;
+            range.m_end    = second.m_begin;
+            pushRange(queue_index, second);
+        }
+
+        const IndexFunction &f = *range.m_loop->m_function;
+        for(unsigned int i=range.m_begin; i<range.m_end; i++)
+            f(i);
+
+        pthread_mutex_lock(&m_mutex);
+        m_remaining -= range.m_end - range.m_begin;
+        if(m_remaining==0)
+            pthread_cond_signal(&m_cond_done);
+        pthread_mutex_unlock(&m_mutex);
+    }   // while getRange
+}   // work
+
+// ----------------------------------------------------------------------------
+/** Executes f(i) for all 0 <= i < n, using all threads of the job system.
+ *  The calling thread takes part in the work, and this function only
+ *  returns once all indices are done.
+ *  \param n Number of indices.
+ *  \param f The function to execute.
+ *  \param grain_size Ranges with more than this number of indices are
+ *         split before being executed.
+ */
+void JobSystem::parallelFor(unsigned int n, const IndexFunction &f,
+                            unsigned int grain_size)
+{
+    if(n==0) return;
+    if(m_queues.size()==1 || m_loop_active || n==1)
+    {
+        for(unsigned int i=0; i<n; i++)
+            f(i);
+        return;
+    }
+    m_loop_active = true;
+
+    Loop loop;
+    loop.m_function   = &f;
+    loop.m_grain_size = grain_size>0 ? grain_size : 1;
+
+    pthread_mutex_lock(&m_mutex);
+    m_remaining = n;
+    pthread_mutex_unlock(&m_mutex);
+
+    // Distribute the indices evenly to all queues, load imbalances are
+    // then handled by stealing.
+    const unsigned int num_queues = (unsigned int)m_queues.size();
+    for(unsigned int i=0; i<num_queues; i++)
+    {
+        Range r;
+        r.m_loop  = &loop;
+        r.m_begin = (unsigned int)((unsigned long long)n* i   /num_queues);
+        r.m_end   = (unsigned int)((unsigned long long)n*(i+1)/num_queues);
+        if(r.m_begin<r.m_end)
+            pushRange(i, r);
+    }
+
+    pthread_mutex_lock(&m_mutex);
+    m_generation++;
+    pthread_cond_broadcast(&m_cond_work);
+    pthread_mutex_unlock(&m_mutex);
+
+    work(0);
+
+    pthread_mutex_lock(&m_mutex);
+    while(m_remaining>0)
+        pthread_cond_wait(&m_cond_done, &m_mutex);
+    pthread_mutex_unlock(&m_mutex);
+
+    m_loop_active = false;
+}   // parallelFor
@@ -0,0 +1,143 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_JOB_SYSTEM_HPP
+#define HEADER_JOB_SYSTEM_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <assert.h>
+#include <deque>
+#include <functional>
+#include <pthread.h>
+#include <vector>
+
+/** A small work stealing job system which executes parallel loops. Each
+ *  thread (the main thread, which calls parallelFor, has index 0) owns a
+ *  queue of index ranges. A thread takes ranges from the back of its own
+ *  queue, splitting large ranges and putting the second half back (so that
+ *  it can be stolen). If its own queue is empty, it steals ranges from the
+ *  front of the queues of the other threads.
+ *  The loop body must only modify data that is not accessed by any other
+ *  index of the same loop. Only one loop can be active at a time, a nested
+ *  call of parallelFor (or a call when no worker threads exist) is executed
+ *  sequentially in the calling thread.
+ * \ingroup utils
+ */
+class JobSystem : public NoCopy
+{
+public:
+    /** The function executed for each index of a parallel loop. */
+    typedef std::function<void(unsigned int)> IndexFunction;
+
+private:
+    /** Information about the currently executed loop. */
+    struct Loop
+    {
+        /** The function to execute for each index. */
+        const IndexFunction *m_function;
+        /** Ranges larger than this are split before being executed. */
+        unsigned int         m_grain_size;
+    };   // Loop
+
+    // ------------------------------------------------------------------------
+    /** A range of indices [m_begin, m_end) of a loop. */
+    struct Range
+    {
+        const Loop  *m_loop;
+        unsigned int m_begin;
+        unsigned int m_end;
+    };   // Range
+
+    // ------------------------------------------------------------------------
+    /** The queue of ranges owned by one thread. */
+    struct Queue
+    {
+        pthread_mutex_t   m_mutex;
+        std::deque<Range> m_ranges;
+    };   // Queue
+
+    // ------------------------------------------------------------------------
+    /** Data passed to each worker thread. */
+    struct ThreadData
+    {
+        JobSystem   *m_job_system;
+        unsigned int m_index;
+    };   // ThreadData
+
+    /** Singleton pointer. */
+    static JobSystem *m_job_system;
+
+    /** One queue for each thread, index 0 is used by the main thread. */
+    std::vector<Queue*>      m_queues;
+
+    /** The worker threads. */
+    std::vector<pthread_t>   m_threads;
+
+    /** The data passed to the worker threads. */
+    std::vector<ThreadData>  m_thread_data;
+
+    /** Protects m_remaining, m_generation and m_quit. */
+    pthread_mutex_t          m_mutex;
+
+    /** Signals the worker threads that a new loop was started (or that
+     *  they should quit). */
+    pthread_cond_t           m_cond_work;
+
+    /** Signals the main thread that all indices of the loop are done. */
+    pthread_cond_t           m_cond_done;
+
+    /** Number of indices of the current loop that are not yet done. */
+    unsigned int             m_remaining;
+
+    /** Incremented for each loop, so that worker threads can detect a
+     *  new loop. */
+    unsigned int             m_generation;
+
+    /** Set to ask the worker threads to exit. */
+    bool                     m_quit;
+
+    /** True while a loop is executed, used to detect nested loops. */
+    bool                     m_loop_active;
+
+    static void *threadMain(void *data);
+    bool getRange(unsigned int queue_index, Range *range);
+    void pushRange(unsigned int queue_index, const Range &range);
+    void work(unsigned int queue_index);
+
+         JobSystem(unsigned int num_threads);
+        ~JobSystem();
+public:
+    static void create(int num_threads=-1);
+    static void destroy();
+    // ------------------------------------------------------------------------
+    /** Returns the job system. */
+    static JobSystem *get()
+    {
+        assert(m_job_system);
+        return m_job_system;
+    }   // get
+    // ------------------------------------------------------------------------
+    void parallelFor(unsigned int n, const IndexFunction &f,
+                     unsigned int grain_size=1);
+    // ------------------------------------------------------------------------
+    /** Returns the number of threads used, including the main thread. */
+    unsigned int getNumThreads() const { return (unsigned int)m_queues.size(); }
+};   // JobSystem
+
+#endif